@@ -37,6 +37,11 @@ void archSetCurrentDirectory(const char* pathname);
 int archFileExists(const char* fileName);
 int archFileDelete(const char *fileName);
 
+// Maps a file read-only into memory. Returns NULL if the file can't be
+// mapped on this platform, callers should fall back to reading the file.
+void* archFileMap(const char* fileName, int* size);
+void archFileUnmap(void* data, int size);
+
 // File dialogs:
 char* archFilenameGetOpenRom(Properties* properties, int cartSlot, RomType* romType);
 
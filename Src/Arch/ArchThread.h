@@ -33,6 +33,7 @@
 
 void* archThreadCreate(void (*entryPoint)(), int priority);
 void* archThreadCreateEx(void (*entryPoint)(), int priority, int stacksize);
+void* archThreadCreateArg(void (*entryPoint)(void*), void* arg, int priority);
 void  archThreadJoin(void* thread, int timeout);
 void  archThreadDestroy(void* thread);
 
@@ -347,6 +347,7 @@ static UInt32 getTimeTrace(int offset) {
 static void saveState()
 {    
     r800SaveState(r800);
+    mixerSaveState(boardGetMixer());
     sn76489SaveState(sn76489);
     deviceManagerSaveState();
     slotSaveState();
@@ -356,6 +357,7 @@ static void loadState()
 {
     r800LoadState(r800);
     boardInit(&r800->systemTime);
+    mixerLoadState(boardGetMixer());
     deviceManagerLoadState();
     slotLoadState();
     sn76489LoadState(sn76489);
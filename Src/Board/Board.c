@@ -46,7 +46,11 @@
 #include "Casette.h"
 #include "MediaDb.h"
 #include "RomLoader.h"
+#include "RewindBuffer.h"
 #include "JoystickPort.h"
+#include "SlotManager.h"
+#include "R800.h"
+#include "R800Dasm.h"
 #include <string.h>
 #include <stdlib.h>
 #include <time.h>
@@ -71,6 +75,9 @@ static BoardTimer* stateTimer;
 static BoardTimer* breakpointTimer;
 static BoardDeviceInfo* boardDeviceInfo;
 static Machine* boardMachine;
+static UInt32 cpuTraceEntries;
+static int    cpuTraceRegisters;
+static char   cpuTraceFile[512];
 #ifdef __LIBRETRO__
 BoardInfo boardInfo;
 #else
@@ -82,9 +89,15 @@ static int boardRunning = 0;
 
 static HdType hdType[MAX_HD_COUNT];
   
+// Rewind snapshots are saved to a memory zip file that is flattened and
+// stored in a delta compressed ring
+#define REWIND_BUFFER_SIZE (8 * 1024 * 1024)
+#define REWIND_ZIP_NAME    "mem0"
+
 static int     ramMaxStates;
-static int     ramStateCur;
-static int     ramStateCount;
+static RewindBuffer* rewindBuffer;
+static UInt8*  rewindState;
+static int     rewindStateSize;
 static int     stateFrequency;
 static int     enableSnapshots;
 static int     useRom;
@@ -104,6 +117,7 @@ static UInt32       periodicInterval;
 static BoardTimer*  periodicTimer;
 
 void boardTimerCleanup();
+static UInt32 boardTimerGetTimeout(BoardTimer* timer);
 
 #define HIRES_CYCLES_PER_LORES_CYCLE (UInt64)100000
 #define boardFrequency64() (HIRES_CYCLES_PER_LORES_CYCLE * boardFrequency())
@@ -136,7 +150,21 @@ void boardSetPeriodicCallback(BoardTimerCb cb, void* ref, UInt32 freq)
 // Capture stuff
 //------------------------------------------------------
 
-#define CAPTURE_VERSION     3
+// A capture file starts with a header followed by chunks. The inputs are
+// streamed to the file in RLE encoded blocks and a keyframe with a full
+// save state is written at the start and at regular intervals, so playback
+// can start from any keyframe. An end chunk holds the length of the capture.
+
+#define CAPTURE_VERSION     4
+
+#define CAPTURE_CHUNK_INPUTS    1
+#define CAPTURE_CHUNK_KEYFRAME  2
+#define CAPTURE_CHUNK_END       3
+
+#define CAPTURE_INPUT_COUNT     0x4000
+#define CAPTURE_KEYFRAME_PERIOD 10
+
+static const char captureMagic[8] = "bMSXCAP";
 
 typedef struct {
     UInt8  index;
@@ -147,22 +175,19 @@ typedef struct {
 static RleData* rleData;
 static int      rleDataSize;
 static int      rleIdx;
+static int      rleRemaining;
 static UInt8    rleCache[256];
 
-static void rleEncStartEncode(void* buffer, int length, int startOffset)
+static void rleEncStartEncode(void* buffer, int count, int length)
 {
-    rleIdx = startOffset - 1;
-    rleDataSize = length / sizeof(RleData) - 1;
+    rleIdx = length - 1;
+    rleDataSize = count;
     rleData = (RleData*)buffer;
-
-    if (startOffset == 0) {
-        memset(rleCache, 0, sizeof(rleCache));
-    }
 }
 
 static void rleEncAdd(UInt8 index, UInt8 value)
 {
-    if (rleIdx < 0 || rleCache[index] != value || rleData[rleIdx].count == 0) {
+    if (rleIdx < 0 || rleCache[index] != value || rleData[rleIdx].count == 0xffff) {
         rleIdx++;
         rleData[rleIdx].value = value;
         rleData[rleIdx].count = 1;
@@ -179,54 +204,83 @@ static int rleEncGetLength()
     return rleIdx + 1;
 }
 
-static void rleEncStartDecode(void* encodedData, int encodedSize)
+static int rleEncFull()
 {
-    rleIdx = 0;
+    return rleIdx == rleDataSize - 1;
+}
+
+static void rleEncStartDecode(void* encodedData, int encodedSize, int offset, int remaining)
+{
+    rleIdx = offset;
     rleDataSize = encodedSize;
     rleData = (RleData*)encodedData;
-    
-    memset(rleCache, 0, sizeof(rleCache));
-
-    rleCache[rleData[rleIdx].index] = rleData[rleIdx].value;
+    rleRemaining = remaining;
 }
 
 static UInt8 rleEncGet(UInt8 index)
 {
-    UInt8 value = rleCache[index];
+    UInt8 value;
 
-    rleData[rleIdx].count--;
-    if (rleData[rleIdx].count == 0) {
-        rleIdx++;
+    // The value is set when the first input of a run is read, so the cache
+    // matches the encoder if recording resumes in the middle of a block
+    if (rleRemaining == rleData[rleIdx].count) {
         rleCache[rleData[rleIdx].index] = rleData[rleIdx].value;
     }
 
+    value = rleCache[index];
+
+    if (--rleRemaining == 0) {
+        rleIdx++;
+        if (rleIdx < rleDataSize) {
+            rleRemaining = rleData[rleIdx].count;
+        }
+    }
+
     return value;
 }
 
 static int rleEncEof()
 {
-    return rleIdx > rleDataSize;
+    return rleIdx >= rleDataSize;
 }
 
 
-typedef enum 
+typedef enum
 {
     CAPTURE_IDLE = 0,
     CAPTURE_REC  = 1,
     CAPTURE_PLAY = 2,
 } CaptureState;
 
+typedef struct {
+    UInt32 type;
+    UInt32 length;
+} CaptureChunk;
+
+typedef struct {
+    UInt64 time;
+    long   offset;
+} CaptureKeyframe;
+
 typedef struct Capture {
     BoardTimer* timer;
+    BoardTimer* keyframeTimer;
 
-    UInt8  initState[0x100000];
-    int    initStateSize;
     UInt32 endTime;
     UInt64 endTime64;
     UInt64 startTime64;
     CaptureState state;
-    UInt8  inputs[0x100000];
+    int    saving;
+    int    startPending;
+
+    // The file and buffers are only allocated while recording or playing
+    FILE*  file;
+    long   chunkOffset;
+    RleData* inputs;
     int    inputCnt;
+    CaptureKeyframe* keyframes;
+    int    keyframeCount;
+    UInt64 length;
     char   filename[512];
 } Capture;
 
@@ -237,7 +291,7 @@ int boardCaptureHasData() {
 }
 
 int boardCaptureIsRecording() {
-    return cap.state == CAPTURE_REC;
+    return cap.state == CAPTURE_REC || cap.startPending;
 }
 
 int  boardCaptureIsPlaying() {
@@ -257,6 +311,304 @@ int boardCaptureCompleteAmount() {
     return (int)(1000 * current / length);
 }
 
+UInt64 boardCaptureGetTime() {
+    return boardSystemTime64() - cap.startTime64;
+}
+
+static void boardCaptureClose()
+{
+    if (cap.file != NULL) {
+        fclose(cap.file);
+        cap.file = NULL;
+    }
+    free(cap.inputs);
+    free(cap.keyframes);
+    cap.inputs = NULL;
+    cap.keyframes = NULL;
+    cap.keyframeCount = 0;
+    cap.inputCnt = 0;
+
+    rleEncStartDecode(NULL, 0, 0, 0);
+}
+
+static void boardCaptureWriteChunk(UInt32 type, UInt32 length)
+{
+    CaptureChunk chunk;
+
+    chunk.type   = type;
+    chunk.length = length;
+
+    fwrite(&chunk, sizeof(chunk), 1, cap.file);
+}
+
+static void boardCaptureWriteInputs()
+{
+    int count = rleEncGetLength();
+
+    if (count > 0) {
+        boardCaptureWriteChunk(CAPTURE_CHUNK_INPUTS, count * sizeof(RleData));
+        fwrite(cap.inputs, sizeof(RleData), count, cap.file);
+    }
+    cap.chunkOffset = ftell(cap.file);
+
+    // The next input always starts a new run
+    rleEncStartEncode(cap.inputs, CAPTURE_INPUT_COUNT, 0);
+}
+
+// Reads the next block of inputs. Keyframes are skipped and playback
+// stops feeding inputs at the end chunk.
+static void boardCaptureReadInputs()
+{
+    CaptureChunk chunk;
+
+    cap.inputCnt = 0;
+
+    for (;;) {
+        cap.chunkOffset = ftell(cap.file);
+        if (fread(&chunk, sizeof(chunk), 1, cap.file) != 1 || chunk.type == CAPTURE_CHUNK_END) {
+            break;
+        }
+        if (chunk.type == CAPTURE_CHUNK_INPUTS && chunk.length <= CAPTURE_INPUT_COUNT * sizeof(RleData)) {
+            cap.inputCnt = fread(cap.inputs, sizeof(RleData), chunk.length / sizeof(RleData), cap.file);
+            break;
+        }
+        fseek(cap.file, chunk.length, SEEK_CUR);
+    }
+
+    if (cap.inputCnt > 0) {
+        rleEncStartDecode(cap.inputs, cap.inputCnt, 0, cap.inputs[0].count);
+    }
+    else {
+        rleEncStartDecode(cap.inputs, 0, 0, 0);
+    }
+}
+
+static void boardCaptureWriteKeyframe()
+{
+    char tmpName[520];
+    UInt32 header[2];
+    UInt8* buffer = NULL;
+    long size = 0;
+    FILE* f;
+    UInt64 time = boardSystemTime64() - cap.startTime64;
+
+    boardCaptureWriteInputs();
+
+    sprintf(tmpName, "%s.tmp", cap.filename);
+
+    cap.saving = 1;
+    boardSaveState(tmpName, 0);
+    cap.saving = 0;
+
+    f = fopen(tmpName, "rb");
+    if (f != NULL) {
+        fseek(f, 0, SEEK_END);
+        size = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        buffer = malloc(size > 0 ? size : 1);
+        size = fread(buffer, 1, size, f);
+        fclose(f);
+    }
+    remove(tmpName);
+
+    if (size > 0) {
+        header[0] = (UInt32)(time >> 32);
+        header[1] = (UInt32)time;
+        boardCaptureWriteChunk(CAPTURE_CHUNK_KEYFRAME, sizeof(header) + sizeof(rleCache) + size);
+        fwrite(header, sizeof(header), 1, cap.file);
+        fwrite(rleCache, 1, sizeof(rleCache), cap.file);
+        fwrite(buffer, 1, size, cap.file);
+        cap.chunkOffset = ftell(cap.file);
+    }
+    free(buffer);
+}
+
+static void boardCaptureKeyframeCb(void* dummy, UInt32 time)
+{
+    if (cap.state == CAPTURE_REC) {
+        boardCaptureWriteKeyframe();
+        boardTimerAdd(cap.keyframeTimer, time + boardFrequency() * CAPTURE_KEYFRAME_PERIOD);
+    }
+}
+
+// Opens a capture file for playback and indexes its keyframes
+static int boardCaptureOpen(const char* filename)
+{
+    char magic[sizeof(captureMagic)];
+    UInt32 version = 0;
+    CaptureChunk chunk;
+    long offset;
+
+    boardCaptureClose();
+
+    cap.file = fopen(filename, "r+b");
+    if (cap.file == NULL) {
+        cap.file = fopen(filename, "rb");
+    }
+    if (cap.file == NULL) {
+        return 0;
+    }
+
+    if (fread(magic, 1, sizeof(magic), cap.file) != sizeof(magic) ||
+        memcmp(magic, captureMagic, sizeof(magic)) != 0 ||
+        fread(&version, sizeof(version), 1, cap.file) != 1 ||
+        version != CAPTURE_VERSION)
+    {
+        boardCaptureClose();
+        return 0;
+    }
+
+    if (filename != cap.filename) {
+        strcpy(cap.filename, filename);
+    }
+    cap.inputs = (RleData*)malloc(CAPTURE_INPUT_COUNT * sizeof(RleData));
+    cap.length = 0;
+
+    offset = ftell(cap.file);
+    while (fread(&chunk, sizeof(chunk), 1, cap.file) == 1) {
+        UInt32 time[2];
+
+        if (chunk.type == CAPTURE_CHUNK_KEYFRAME || chunk.type == CAPTURE_CHUNK_END) {
+            if (fread(time, sizeof(time), 1, cap.file) != 1) {
+                break;
+            }
+        }
+        if (chunk.type == CAPTURE_CHUNK_KEYFRAME) {
+            if ((cap.keyframeCount & 63) == 0) {
+                cap.keyframes = realloc(cap.keyframes, (cap.keyframeCount + 64) * sizeof(CaptureKeyframe));
+            }
+            cap.keyframes[cap.keyframeCount].time   = (UInt64)time[0] << 32 | time[1];
+            cap.keyframes[cap.keyframeCount].offset = offset;
+            cap.keyframeCount++;
+        }
+        if (chunk.type == CAPTURE_CHUNK_END) {
+            cap.length = (UInt64)time[0] << 32 | time[1];
+            break;
+        }
+        offset += sizeof(chunk) + chunk.length;
+        fseek(cap.file, offset, SEEK_SET);
+    }
+
+    if (cap.keyframeCount == 0) {
+        boardCaptureClose();
+        return 0;
+    }
+    return 1;
+}
+
+static void boardCaptureStartEndTimer()
+{
+    UInt64 remaining;
+
+    if (cap.length == 0) {
+        cap.endTime64 = 0;
+        return;
+    }
+
+    cap.endTime64 = cap.startTime64 + cap.length;
+    remaining = cap.endTime64 - boardSystemTime64();
+    if (remaining > cap.length) {
+        remaining = 0;
+    }
+    cap.endTime = boardSystemTime() + (UInt32)(remaining / HIRES_CYCLES_PER_LORES_CYCLE);
+
+    while (cap.endTime - boardSystemTime() > 0x40000000 || cap.endTime == boardSystemTime()) {
+        cap.endTime -= 0x40000000;
+    }
+    boardTimerAdd(cap.timer, cap.endTime);
+}
+
+// Restores the state of a keyframe and continues playback after it
+static int boardCaptureLoadKeyframe(int index)
+{
+    char tmpName[520];
+    CaptureChunk chunk;
+    UInt32 header[2];
+    UInt8* buffer;
+    int size;
+    FILE* f;
+
+    fseek(cap.file, cap.keyframes[index].offset, SEEK_SET);
+    if (fread(&chunk, sizeof(chunk), 1, cap.file) != 1 ||
+        chunk.length < sizeof(header) + sizeof(rleCache))
+    {
+        return 0;
+    }
+
+    size = chunk.length - sizeof(header) - sizeof(rleCache);
+    buffer = malloc(size > 0 ? size : 1);
+    if (fread(header, sizeof(header), 1, cap.file) != 1 ||
+        fread(rleCache, sizeof(rleCache), 1, cap.file) != 1 ||
+        fread(buffer, 1, size, cap.file) != (size_t)size)
+    {
+        free(buffer);
+        return 0;
+    }
+
+    sprintf(tmpName, "%s.tmp", cap.filename);
+    f = fopen(tmpName, "wb");
+    if (f == NULL) {
+        free(buffer);
+        return 0;
+    }
+    fwrite(buffer, 1, size, f);
+    fclose(f);
+    free(buffer);
+
+    boardTimerCleanup();
+
+    saveStateCreateForRead(tmpName);
+    boardInfo.loadState();
+    boardRestartTimers();
+    saveStateDestroy();
+    remove(tmpName);
+
+    cap.state = CAPTURE_PLAY;
+    cap.startTime64 = boardSystemTime64() - cap.keyframes[index].time;
+
+    boardCaptureReadInputs();
+    boardCaptureStartEndTimer();
+
+    return 1;
+}
+
+int boardCaptureSeek(UInt64 time)
+{
+    int index = 0;
+
+    if (!boardRunning) {
+        return 0;
+    }
+
+    if (cap.state == CAPTURE_REC) {
+        boardCaptureStop();
+    }
+    if (cap.file == NULL && !boardCaptureOpen(cap.filename)) {
+        return 0;
+    }
+
+    while (index + 1 < cap.keyframeCount && cap.keyframes[index + 1].time <= time) {
+        index++;
+    }
+
+    if (!boardCaptureLoadKeyframe(index)) {
+        boardCaptureClose();
+        cap.state = CAPTURE_IDLE;
+        return 0;
+    }
+    return 1;
+}
+
+int boardCapturePlay(const char* filename)
+{
+    boardCaptureStop();
+
+    if (!boardCaptureOpen(filename)) {
+        return 0;
+    }
+    return boardCaptureSeek(0);
+}
+
 extern void actionEmuTogglePause();
 
 static void boardTimerCb(void* dummy, UInt32 time)
@@ -275,12 +627,13 @@ static void boardTimerCb(void* dummy, UInt32 time)
         }
         else {
             actionEmuTogglePause();
+            boardCaptureClose();
             cap.state = CAPTURE_IDLE;
         }
     }
-    
-    if (cap.state == CAPTURE_REC) {
-        cap.state = CAPTURE_IDLE;
+
+    if (cap.startPending) {
+        cap.startPending = 0;
         boardCaptureStart(cap.filename);
     }
 }
@@ -288,7 +641,8 @@ static void boardTimerCb(void* dummy, UInt32 time)
 void boardCaptureInit()
 {
     cap.timer = boardTimerCreate(boardTimerCb, NULL);
-    if (cap.state == CAPTURE_REC) {
+    cap.keyframeTimer = boardTimerCreate(boardCaptureKeyframeCb, NULL);
+    if (cap.startPending) {
         boardTimerAdd(cap.timer, boardSystemTime() + 1);
     }
 }
@@ -301,86 +655,96 @@ void boardCaptureDestroy()
         boardTimerDestroy(cap.timer);
         cap.timer = NULL;
     }
+    if (cap.keyframeTimer != NULL) {
+        boardTimerDestroy(cap.keyframeTimer);
+        cap.keyframeTimer = NULL;
+    }
     cap.state = CAPTURE_IDLE;
 }
 
 void boardCaptureStart(const char* filename) {
-    FILE* f;
+    UInt32 version = CAPTURE_VERSION;
 
     if (cap.state == CAPTURE_REC) {
         return;
     }
 
     // If we're playing back a capture, we just start recording from where we're at
-    // and new recording will be appended to old recording
+    // and the rest of the old recording is replaced by the new one
     if (cap.state == CAPTURE_PLAY) {
+        int count = rleEncEof() ? rleDataSize : rleIdx;
+
+        if (!rleEncEof() && rleRemaining < cap.inputs[rleIdx].count) {
+            cap.inputs[rleIdx].count -= rleRemaining;
+            count++;
+        }
+        fseek(cap.file, cap.chunkOffset, SEEK_SET);
+        rleEncStartEncode(cap.inputs, CAPTURE_INPUT_COUNT, count);
+
+        boardTimerRemove(cap.timer);
+        boardTimerAdd(cap.keyframeTimer, boardSystemTime() + boardFrequency() * CAPTURE_KEYFRAME_PERIOD);
         cap.state = CAPTURE_REC;
         return;
     }
 
-    strcpy(cap.filename, filename);
+    if (filename != cap.filename) {
+        strcpy(cap.filename, filename);
+    }
 
-    // If emulation is not running we want to start recording once 
-    // the emulation is started
+    // If emulation is not running we want to start recording once
+    // the emulation is started. Until then there is no file or input
+    // buffer, so the capture stays idle.
     if (cap.timer == NULL) {
-        cap.state = CAPTURE_REC;
+        cap.startPending = 1;
         return;
     }
+    cap.startPending = 0;
 
-    cap.initStateSize = 0;
-    boardSaveState("cap.tmp", 1);
-    f = fopen("cap.tmp", "rb");
-    if (f != NULL) {
-        cap.initStateSize = fread(cap.initState, 1, sizeof(cap.initState), f);
-        fclose(f);
-    }
+    boardCaptureClose();
 
-    if (cap.initStateSize > 0) {
-        rleEncStartEncode(cap.inputs, sizeof(cap.inputs), 0);
-        cap.state = CAPTURE_REC;
+    cap.file = fopen(cap.filename, "w+b");
+    if (cap.file == NULL) {
+        return;
     }
+    fwrite(captureMagic, 1, sizeof(captureMagic), cap.file);
+    fwrite(&version, sizeof(version), 1, cap.file);
 
+    cap.inputs = (RleData*)malloc(CAPTURE_INPUT_COUNT * sizeof(RleData));
+    memset(rleCache, 0, sizeof(rleCache));
+    rleEncStartEncode(cap.inputs, CAPTURE_INPUT_COUNT, 0);
+
+    cap.endTime = 0;
+    cap.endTime64 = 0;
     cap.startTime64 = boardSystemTime64();
+    cap.state = CAPTURE_REC;
+
+    boardCaptureWriteKeyframe();
+    boardTimerAdd(cap.keyframeTimer, boardSystemTime() + boardFrequency() * CAPTURE_KEYFRAME_PERIOD);
 }
 
 void boardCaptureStop() {
+    cap.startPending = 0;
     boardTimerRemove(cap.timer);
+    boardTimerRemove(cap.keyframeTimer);
 
-    if (cap.state == CAPTURE_REC) {
-        SaveState* state;
-        FILE* f;
+    if (cap.state == CAPTURE_REC && cap.file != NULL) {
+        UInt32 length[2];
+        UInt64 time;
 
         cap.endTime = boardSystemTime();
         cap.endTime64 = boardSystemTime64();
-        cap.state = CAPTURE_PLAY;
-        cap.inputCnt = rleEncGetLength();
-
-        f = fopen(cap.filename, "wb");
-        if (f != NULL) {
-            fwrite(cap.initState, 1, cap.initStateSize, f);
-            fclose(f);
-        }
-
-        saveStateCreateForWrite(cap.filename);
-
-        state = saveStateOpenForWrite("capture");
-
-        saveStateSet(state, "version", CAPTURE_VERSION);
+        time = cap.endTime64 - cap.startTime64;
 
-        saveStateSet(state, "state", cap.state);
-        saveStateSet(state, "endTime", cap.endTime);
-        saveStateSet(state, "endTime64Hi", (UInt32)(cap.endTime64 >> 32));
-        saveStateSet(state, "endTime64Lo", (UInt32)cap.endTime64);
-        saveStateSet(state, "inputCnt", cap.inputCnt);
-        
-        if (cap.inputCnt > 0) {
-            saveStateSetBuffer(state, "inputs", cap.inputs, cap.inputCnt * sizeof(RleData));
-        }
+        boardCaptureWriteInputs();
 
-        saveStateClose(state);
-        saveStateDestroy();
+        length[0] = (UInt32)(time >> 32);
+        length[1] = (UInt32)time;
+        boardCaptureWriteChunk(CAPTURE_CHUNK_END, sizeof(length));
+        fwrite(length, sizeof(length), 1, cap.file);
     }
 
+    boardCaptureClose();
+
     // go back to idle state
     cap.state = CAPTURE_IDLE;
 }
@@ -388,40 +752,49 @@ void boardCaptureStop() {
 UInt8 boardCaptureUInt8(UInt8 logId, UInt8 value) {
     if (cap.state == CAPTURE_REC) {
         rleEncAdd(logId, value);
-        if (rleEncEof()) {
-            boardCaptureStop();
+        if (rleEncFull()) {
+            boardCaptureWriteInputs();
         }
     }
     if (cap.state == CAPTURE_PLAY) {
         if (!rleEncEof()) {
-            value= rleEncGet(logId);
+            value = rleEncGet(logId);
+            if (rleEncEof()) {
+                boardCaptureReadInputs();
+            }
         }
     }
     return value;
 }
 
+// Save states only refer to the capture file. The inputs that haven't
+// been written to or read from the file yet are stored in the state.
 static void boardCaptureSaveState()
 {
-    if (cap.state == CAPTURE_REC) {
+    if ((cap.state == CAPTURE_REC || cap.state == CAPTURE_PLAY) && !cap.saving) {
         SaveState* state = saveStateOpenForWrite("capture");
+        UInt64 time = boardSystemTime64() - cap.startTime64;
+        int inputCnt = cap.state == CAPTURE_REC ? rleEncGetLength() : cap.inputCnt;
 
-        cap.inputCnt = rleEncGetLength();
+        if (cap.state == CAPTURE_REC) {
+            fflush(cap.file);
+        }
 
         saveStateSet(state, "version", CAPTURE_VERSION);
 
         saveStateSet(state, "state", cap.state);
-        saveStateSet(state, "endTime", cap.endTime);
-        saveStateSet(state, "endTime64Hi", (UInt32)(cap.endTime64 >> 32));
-        saveStateSet(state, "endTime64Lo", (UInt32)cap.endTime64);
-        saveStateSet(state, "inputCnt", cap.inputCnt);
-        if (cap.inputCnt > 0) {
-            saveStateSetBuffer(state, "inputs", cap.inputs, cap.inputCnt * sizeof(RleData));
-        }
-        saveStateSet(state, "initStateSize", cap.initStateSize);
-        if (cap.initStateSize > 0) {
-            saveStateSetBuffer(state, "initState", cap.initState, cap.initStateSize);
+        saveStateSetBuffer(state, "filename", cap.filename, strlen(cap.filename) + 1);
+        saveStateSet(state, "timeHi", (UInt32)(time >> 32));
+        saveStateSet(state, "timeLo", (UInt32)time);
+        saveStateSet(state, "chunkOffset", (UInt32)cap.chunkOffset);
+        saveStateSet(state, "fileOffset", (UInt32)ftell(cap.file));
+        saveStateSet(state, "inputCnt", inputCnt);
+        if (inputCnt > 0) {
+            saveStateSetBuffer(state, "inputs", cap.inputs, inputCnt * sizeof(RleData));
         }
-        
+        saveStateSet(state, "rleIdx", rleIdx);
+        saveStateSet(state, "rleRemaining", rleRemaining);
+
         saveStateSetBuffer(state, "rleCache", rleCache, sizeof(rleCache));
 
         saveStateClose(state);
@@ -430,45 +803,62 @@ static void boardCaptureSaveState()
 
 static void boardCaptureLoadState()
 {
+    CaptureState captureState;
+    UInt64 time;
     int version;
 
     SaveState* state = saveStateOpenForRead("capture");
 
     version = saveStateGet(state, "version", 0);
+    captureState = saveStateGet(state, "state", CAPTURE_IDLE);
 
-    cap.state = saveStateGet(state, "state", CAPTURE_IDLE);
-    cap.endTime = saveStateGet(state, "endTime", 0);
-    cap.endTime64 = (UInt64)saveStateGet(state, "endTime64Hi", 0) << 32 |
-                    (UInt64)saveStateGet(state, "endTime64Lo", 0);
+    boardTimerRemove(cap.timer);
+    boardTimerRemove(cap.keyframeTimer);
+    boardCaptureClose();
+    cap.state = CAPTURE_IDLE;
+
+    if (version != CAPTURE_VERSION || captureState == CAPTURE_IDLE) {
+        saveStateClose(state);
+        return;
+    }
+
+    saveStateGetBuffer(state, "filename", cap.filename, sizeof(cap.filename));
+    cap.filename[sizeof(cap.filename) - 1] = 0;
+
+    if (!boardCaptureOpen(cap.filename)) {
+        saveStateClose(state);
+        return;
+    }
+
+    time = (UInt64)saveStateGet(state, "timeHi", 0) << 32 |
+           (UInt64)saveStateGet(state, "timeLo", 0);
+    cap.startTime64 = boardSystemTime64() - time;
+    cap.chunkOffset = saveStateGet(state, "chunkOffset", 0);
+    fseek(cap.file, saveStateGet(state, "fileOffset", 0), SEEK_SET);
     cap.inputCnt = saveStateGet(state, "inputCnt", 0);
+    if (cap.inputCnt > CAPTURE_INPUT_COUNT) {
+        cap.inputCnt = 0;
+    }
     if (cap.inputCnt > 0) {
         saveStateGetBuffer(state, "inputs", cap.inputs, cap.inputCnt * sizeof(RleData));
     }
-    cap.initStateSize = saveStateGet(state, "initStateSize", 0);
-    if (cap.initStateSize > 0) {
-        saveStateGetBuffer(state, "initState", cap.initState, cap.initStateSize);
-    }
-        
+    rleIdx = saveStateGet(state, "rleIdx", 0);
+    rleRemaining = saveStateGet(state, "rleRemaining", 0);
+
     saveStateGetBuffer(state, "rleCache", rleCache, sizeof(rleCache));
 
     saveStateClose(state);
 
-    if (version != CAPTURE_VERSION) {
-        cap.state = CAPTURE_IDLE;
-        return;
-    }
+    cap.state = captureState;
 
     if (cap.state == CAPTURE_PLAY) {
-        rleEncStartDecode(cap.inputs, cap.inputCnt);
-
-        while (cap.endTime - boardSystemTime() > 0x40000000 || cap.endTime == boardSystemTime()) {
-            cap.endTime -= 0x40000000;
-        }
-        boardTimerAdd(cap.timer, cap.endTime);
+        rleEncStartDecode(cap.inputs, cap.inputCnt, rleIdx, rleRemaining);
+        boardCaptureStartEndTimer();
     }
-    
+
     if (cap.state == CAPTURE_REC) {
-        rleEncStartEncode(cap.inputs, sizeof(cap.inputs), cap.inputCnt);
+        rleEncStartEncode(cap.inputs, CAPTURE_INPUT_COUNT, cap.inputCnt);
+        boardTimerAdd(cap.keyframeTimer, boardSystemTime() + boardFrequency() * CAPTURE_KEYFRAME_PERIOD);
     }
 }
 
@@ -555,15 +945,19 @@ static void onMixerSync(void* ref, UInt32 time)
 static void onStateSync(void* ref, UInt32 time)
 {    
     if (enableSnapshots) {
-        char memFilename[8];
-        ramStateCur = (ramStateCur + 1) % ramMaxStates;
-        if (ramStateCount < ramMaxStates) {
-            ramStateCount++;
-        }
+        int size;
 
-        sprintf(memFilename, "mem%d", ramStateCur);
-        
-        boardSaveState(memFilename, 0);
+        boardSaveState(REWIND_ZIP_NAME, 0);
+
+        size = memZipFileSerialize(REWIND_ZIP_NAME, rewindState, rewindStateSize);
+        if (size > rewindStateSize) {
+            rewindStateSize = size;
+            rewindState = realloc(rewindState, rewindStateSize);
+            size = memZipFileSerialize(REWIND_ZIP_NAME, rewindState, rewindStateSize);
+        }
+        if (size > 0) {
+            rewindBufferPush(rewindBuffer, rewindState, size);
+        }
     }
 
     boardTimerAdd(stateTimer, boardSystemTime() + stateFrequency);
@@ -576,9 +970,29 @@ static void onSync(void* ref, UInt32 time)
 
 void boardOnBreakpoint(UInt16 pc)
 {
+    boardDumpCpuTrace();
     doSync(boardSystemTime(), 1);
 }
 
+void boardSetCpuTrace(UInt32 entries, int registers, const char* fileName)
+{
+    cpuTraceEntries   = entries;
+    cpuTraceRegisters = registers;
+    cpuTraceFile[0]   = 0;
+    if (fileName != NULL) {
+        strncpy(cpuTraceFile, fileName, sizeof(cpuTraceFile) - 1);
+        cpuTraceFile[sizeof(cpuTraceFile) - 1] = 0;
+    }
+}
+
+int boardDumpCpuTrace()
+{
+    if (!boardRunning || boardInfo.cpuRef == NULL || cpuTraceFile[0] == 0) {
+        return 0;
+    }
+    return r800DumpTrace((R800*)boardInfo.cpuRef, cpuTraceFile, 0);
+}
+
 int boardInsertExternalDevices()
 {
     int i;
@@ -609,6 +1023,9 @@ int boardRemoveExternalDevices()
      boardChangeDiskette(0, NULL, NULL);
      boardChangeDiskette(1, NULL, NULL);
 
+     // Hard disk images stay open, make sure their writes reach the file
+     diskFlush();
+
      boardChangeCassette(0, NULL, NULL);
 
      return 1;
@@ -635,19 +1052,21 @@ int boardRewindOne() {
 
 int boardRewind()
 {
-    char stateFile[8];
+    const void* state;
+    int size;
 
-    if (ramStateCount < 2) {
+    if (rewindBuffer == NULL || rewindBufferGetCount(rewindBuffer) < 2) {
         return 0;
     }
 
-    ramStateCount--;
-    sprintf(stateFile, "mem%d", ramStateCur);
-    ramStateCur = (ramStateCur + ramMaxStates - 1) % ramMaxStates;
+    state = rewindBufferPop(rewindBuffer, &size);
+    if (!memZipFileDeserialize(REWIND_ZIP_NAME, state, size)) {
+        return 0;
+    }
 
     boardTimerCleanup();
 
-    saveStateCreateForRead(stateFile);
+    saveStateCreateForRead(REWIND_ZIP_NAME);
 
 //    boardType = boardLoadState();
 //    machineLoadState(boardMachine);
@@ -655,18 +1074,30 @@ int boardRewind()
     boardInfo.loadState();
     boardCaptureLoadState();
 
-#if 1
+    boardRestartTimers();
+
+    return 1;
+}
+
+// Adds the board timers again after a state has been loaded. The mixer
+// sync time is part of the state since it decides how the audio is split
+// into chunks.
+void boardRestartTimers()
+{
+    SaveState* state = saveStateOpenForRead("boardTimers");
+    UInt32 mixerTimeout = saveStateGet(state, "mixerTimeout", boardSystemTime() + boardFrequency() / 50);
+
+    saveStateClose(state);
+
     if (stateFrequency > 0) {
         boardTimerAdd(stateTimer, boardSystemTime() + stateFrequency);
     }
     //boardTimerAdd(syncTimer, boardSystemTime() + 1);
-    boardTimerAdd(mixerTimer, boardSystemTime() + boardFrequency() / 50);
+    boardTimerAdd(mixerTimer, mixerTimeout);
     
-    if (boardPeriodicCallback != NULL) {
+    if (periodicTimer != NULL) {
         boardTimerAdd(periodicTimer, boardSystemTime() + periodicInterval);
     }
-#endif
-    return 1;
 }
 
 void boardEnableSnapshots(int enable)
@@ -736,6 +1167,11 @@ int boardRun(Machine* machine,
     
     boardCaptureInit();
 
+    if (success) {
+        r800TraceEnable((R800*)boardInfo.cpuRef, cpuTraceEntries, cpuTraceRegisters);
+        r800SetTraceContext((R800*)boardInfo.cpuRef, slotGetMappingRef());
+    }
+
     if (success && loadState) {
         boardInfo.loadState();
         boardCaptureLoadState();
@@ -751,9 +1187,9 @@ int boardRun(Machine* machine,
         stateFrequency = boardFrequency() / 1000 * reversePeriod;
 
         if (stateFrequency > 0) {
-            ramStateCur  = 0;
             ramMaxStates = reverseBufferCnt;
-            memZipFileSystemCreate(ramMaxStates);
+            rewindBuffer = rewindBufferCreate(REWIND_BUFFER_SIZE, ramMaxStates);
+            memZipFileSystemCreate(1);
             stateTimer = boardTimerCreate(onStateSync, NULL);
             breakpointTimer = boardTimerCreate(onBreakpointSync, NULL); 
             boardTimerAdd(stateTimer, boardSystemTime() + stateFrequency);
@@ -798,6 +1234,11 @@ int boardRun(Machine* machine,
         if (stateTimer != NULL) {
             boardTimerDestroy(stateTimer);
             memZipFileSystemDestroy();
+            rewindBufferDestroy(rewindBuffer);
+            rewindBuffer = NULL;
+            free(rewindState);
+            rewindState = NULL;
+            rewindStateSize = 0;
         }
     }
     else {
@@ -955,6 +1396,8 @@ void boardSaveState(const char* stateFile, int screenshot)
         return;
     }
 
+    diskFlush();
+
     saveStateCreateForWrite(stateFile);
     
     rv = zipSaveFile(stateFile, "version", 0, saveStateVersion, strlen(saveStateVersion) + 1);
@@ -1005,6 +1448,10 @@ void boardSaveState(const char* stateFile, int screenshot)
 
     boardCaptureSaveState();
 
+    state = saveStateOpenForWrite("boardTimers");
+    saveStateSet(state, "mixerTimeout", boardTimerGetTimeout(mixerTimer));
+    saveStateClose(state);
+
     videoManagerSaveState();
     tapeSaveState();
 
@@ -1366,6 +1813,11 @@ void boardTimerRemove(BoardTimer* timer)
     timer->prev = timer;
 }
 
+static UInt32 boardTimerGetTimeout(BoardTimer* timer)
+{
+    return timer->timeout;
+}
+
 void boardTimerCleanup()
 {
     while (timerList->next != timerList) {
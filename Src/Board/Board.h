@@ -116,9 +116,21 @@ int boardCaptureIsRecording();
 int boardCaptureIsPlaying();
 int boardCaptureCompleteAmount();
 
+// Plays back a capture file from the start.
+int boardCapturePlay(const char* filename);
+// Moves playback of the current capture to a time relative to its start,
+// in boardSystemTime64() units. The state of the closest keyframe before
+// the time is loaded and the emulation needs to run until
+// boardCaptureGetTime() reaches the time to replay the inputs after it.
+int boardCaptureSeek(UInt64 time);
+UInt64 boardCaptureGetTime();
+
 UInt8 boardCaptureUInt8(UInt8 logId, UInt8 value);
 
 void boardSaveState(const char* stateFile, int screenshot);
+// Adds the board timers again after boardInfo.loadState() has loaded a
+// state. Needs to be called before the state is destroyed.
+void boardRestartTimers();
 
 void boardSetFrequency(int frequency);
 int  boardGetRefreshRate();
@@ -180,6 +192,12 @@ UInt32 boardCalcRelativeTimeout(UInt32 timerFrequency, UInt32 nextTimeout);
 
 void   boardOnBreakpoint(UInt16 pc);
 
+// Keeps the last entries executed instructions of the next board in a
+// ring buffer (0 disables the trace). The trace is written to fileName
+// when a breakpoint or watchpoint is hit and by boardDumpCpuTrace.
+void boardSetCpuTrace(UInt32 entries, int registers, const char* fileName);
+int  boardDumpCpuTrace();
+
 int boardInsertExternalDevices();
 int boardRemoveExternalDevices();
 
@@ -326,6 +326,7 @@ static int getRefreshRate()
 static void saveState()
 {    
     r800SaveState(r800);
+    mixerSaveState(boardGetMixer());
     sn76489SaveState(sn76489);
     deviceManagerSaveState();
     slotSaveState();
@@ -335,6 +336,7 @@ static void loadState()
 {
     r800LoadState(r800);
     boardInit(&r800->systemTime);
+    mixerLoadState(boardGetMixer());
     deviceManagerLoadState();
     slotLoadState();
     sn76489LoadState(sn76489);
@@ -152,6 +152,7 @@ static void saveState()
     saveStateClose(state);
 
     r800SaveState(r800);
+    mixerSaveState(boardGetMixer());
     deviceManagerSaveState();
     slotSaveState();
     rtcSaveState(rtc);
@@ -167,6 +168,7 @@ static void loadState()
 
     r800LoadState(r800);
     boardInit(&r800->systemTime);
+    mixerLoadState(boardGetMixer());
 
     deviceManagerLoadState();
     slotLoadState();
@@ -37,6 +37,8 @@
 #include <string.h>
 #include <ctype.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <sys/stat.h>
 #include "ArchFile.h"
 #include "MediaDb.h"
 #include "TokenExtract.h"
@@ -46,6 +48,7 @@
 #include "AppConfig.h"
 
 #include "RomLoader.h"
+#include "Board.h"
 #include "MSXMidi.h"
 #include "ramMapper.h"
 #include "ramMapperIo.h"
@@ -163,6 +166,7 @@
 UInt8* g_mainRam=NULL;
 UInt32 g_mainRamSize=0;
 static char machinesDir[PROP_MAXPATH]  = "";
+static char machineCacheFile[PROP_MAXPATH] = "";
 
 int toint(char* buffer) 
 {
@@ -569,12 +573,276 @@ void machineSave(Machine* machine)
     iniFileClose(configIni);
 }
 
+// Parsed machine configurations are cached in a binary file so config.ini
+// files only need to be parsed when they change. Each entry is stamped with
+// the size and modification time of the config.ini or machine zip, and the
+// whole cache is tied to the machines directory since the slot paths are
+// expanded with it.
+
+#define MACHINE_CACHE_MAGIC   0x434d4d42
+#define MACHINE_CACHE_VERSION 1
+#define MACHINE_CACHE_MAX     256
+
+typedef struct {
+    UInt32 magic;
+    UInt32 version;
+    UInt32 machineSize;
+    UInt32 slotInfoSize;
+    UInt32 count;
+    char   machinesDir[PROP_MAXPATH];
+} MachineCacheHeader;
+
+typedef struct {
+    UInt32 mtime;
+    UInt32 size;
+    UInt32 isZipped;
+    UInt32 length;
+} MachineCacheStamp;
+
+typedef struct {
+    MachineCacheStamp stamp;
+    Machine* machine;
+} MachineCacheEntry;
+
+static MachineCacheEntry machineCache[MACHINE_CACHE_MAX];
+static int  machineCacheCount;
+static int  machineCacheLoaded;
+static int  machineCacheDirty;
+static char machineCacheDir[PROP_MAXPATH];
+
+// Only the used part of the slot table is stored
+static UInt32 machineCacheLength(const Machine* machine)
+{
+    return (UInt32)(offsetof(Machine, slotInfo) + machine->slotInfoCount * sizeof(SlotInfo));
+}
+
+static void machineCacheClear()
+{
+    int i;
+
+    for (i = 0; i < machineCacheCount; i++) {
+        free(machineCache[i].machine);
+    }
+    machineCacheCount = 0;
+}
+
+static void machineCacheLoad()
+{
+    MachineCacheHeader* header;
+    UInt8* data;
+    UInt8* ptr;
+    UInt8* end;
+    long size;
+    FILE* file;
+    UInt32 i;
+
+    machineCacheClear();
+    machineCacheLoaded = 1;
+    machineCacheDirty  = 0;
+    strcpy(machineCacheDir, machinesDir);
+
+    if (machineCacheFile[0] == 0) {
+        return;
+    }
+
+    file = fopen(machineCacheFile, "rb");
+    if (file == NULL) {
+        return;
+    }
+
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    if (size < (long)sizeof(MachineCacheHeader)) {
+        fclose(file);
+        return;
+    }
+
+    data = (UInt8*)malloc(size);
+    if (fread(data, 1, size, file) != (size_t)size) {
+        free(data);
+        fclose(file);
+        return;
+    }
+    fclose(file);
+
+    header = (MachineCacheHeader*)data;
+    if (header->magic        != MACHINE_CACHE_MAGIC   ||
+        header->version      != MACHINE_CACHE_VERSION ||
+        header->machineSize  != sizeof(Machine)       ||
+        header->slotInfoSize != sizeof(SlotInfo)      ||
+        header->count        >  MACHINE_CACHE_MAX     ||
+        strncmp(header->machinesDir, machinesDir, PROP_MAXPATH) != 0)
+    {
+        free(data);
+        return;
+    }
+
+    ptr = data + sizeof(MachineCacheHeader);
+    end = data + size;
+
+    for (i = 0; i < header->count; i++) {
+        MachineCacheStamp stamp;
+        Machine* machine;
+
+        if (ptr + sizeof(stamp) > end) {
+            break;
+        }
+        memcpy(&stamp, ptr, sizeof(stamp));
+        ptr += sizeof(stamp);
+
+        if (stamp.length < offsetof(Machine, slotInfo) || stamp.length > sizeof(Machine) ||
+            ptr + stamp.length > end)
+        {
+            break;
+        }
+
+        machine = (Machine*)calloc(1, sizeof(Machine));
+        memcpy(machine, ptr, stamp.length);
+        ptr += stamp.length;
+
+        if (machine->slotInfoCount < 0 || machineCacheLength(machine) != stamp.length) {
+            free(machine);
+            break;
+        }
+        machine->name[sizeof(machine->name) - 1] = 0;
+        machine->zipFile = NULL;
+
+        machineCache[machineCacheCount].stamp   = stamp;
+        machineCache[machineCacheCount].machine = machine;
+        machineCacheCount++;
+    }
+
+    free(data);
+}
+
+static void machineCacheSave()
+{
+    MachineCacheHeader header;
+    char tmpName[PROP_MAXPATH + 8];
+    FILE* file;
+    int ok;
+    int i;
+
+    if (machineCacheFile[0] == 0) {
+        return;
+    }
+
+    memset(&header, 0, sizeof(header));
+    header.magic        = MACHINE_CACHE_MAGIC;
+    header.version      = MACHINE_CACHE_VERSION;
+    header.machineSize  = sizeof(Machine);
+    header.slotInfoSize = sizeof(SlotInfo);
+    header.count        = machineCacheCount;
+    strcpy(header.machinesDir, machineCacheDir);
+
+    // Write to a temporary file first so a partial cache is never loaded
+    sprintf(tmpName, "%s.tmp", machineCacheFile);
+    file = fopen(tmpName, "wb");
+    if (file == NULL) {
+        return;
+    }
+
+    ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (i = 0; ok && i < machineCacheCount; i++) {
+        ok = fwrite(&machineCache[i].stamp, sizeof(MachineCacheStamp), 1, file) == 1 &&
+             fwrite(machineCache[i].machine, 1, machineCache[i].stamp.length, file) == machineCache[i].stamp.length;
+    }
+    if (fclose(file) != 0) {
+        ok = 0;
+    }
+
+    if (ok) {
+        remove(machineCacheFile);
+        ok = rename(tmpName, machineCacheFile) == 0;
+    }
+    if (!ok) {
+        remove(tmpName);
+    }
+}
+
+static void machineCacheStamp(MachineCacheStamp* stamp, const struct stat* s, int isZipped)
+{
+    memset(stamp, 0, sizeof(MachineCacheStamp));
+    stamp->mtime    = (UInt32)s->st_mtime;
+    stamp->size     = (UInt32)s->st_size;
+    stamp->isZipped = isZipped;
+}
+
+static MachineCacheEntry* machineCacheFind(const char* machineName)
+{
+    int i;
+
+    if (!machineCacheLoaded || strcmp(machineCacheDir, machinesDir) != 0) {
+        machineCacheFlush();
+        machineCacheLoad();
+    }
+
+    for (i = 0; i < machineCacheCount; i++) {
+        if (strcmp(machineCache[i].machine->name, machineName) == 0) {
+            return machineCache + i;
+        }
+    }
+    return NULL;
+}
+
+static int machineCacheGet(Machine* machine, const char* machineName, const MachineCacheStamp* stamp)
+{
+    MachineCacheEntry* entry = machineCacheFind(machineName);
+
+    if (entry == NULL ||
+        entry->stamp.mtime    != stamp->mtime ||
+        entry->stamp.size     != stamp->size  ||
+        entry->stamp.isZipped != stamp->isZipped)
+    {
+        return 0;
+    }
+
+    memcpy(machine, entry->machine, entry->stamp.length);
+    return 1;
+}
+
+static void machineCachePut(const Machine* machine, const MachineCacheStamp* stamp)
+{
+    MachineCacheEntry* entry;
+
+    if (strlen(machine->name) >= sizeof(machine->name)) {
+        return;
+    }
+
+    entry = machineCacheFind(machine->name);
+    if (entry == NULL) {
+        if (machineCacheCount == MACHINE_CACHE_MAX) {
+            return;
+        }
+        entry = machineCache + machineCacheCount++;
+        entry->machine = (Machine*)calloc(1, sizeof(Machine));
+    }
+
+    entry->stamp        = *stamp;
+    entry->stamp.length = machineCacheLength(machine);
+    memcpy(entry->machine, machine, entry->stamp.length);
+    entry->machine->zipFile = NULL;
+
+    machineCacheDirty = 1;
+}
+
+void machineCacheFlush()
+{
+    if (machineCacheDirty) {
+        machineCacheSave();
+        machineCacheDirty = 0;
+    }
+}
+
 Machine* machineCreate(const char* machineName)
 {
     char configIni[512];
     Machine* machine;
+    MachineCacheStamp stamp;
+    struct stat s;
     int success;
-    FILE *file;
     
     machine = (Machine *)malloc(sizeof(Machine));
     if (machine == NULL)
@@ -584,33 +852,33 @@ Machine* machineCreate(const char* machineName)
     machine->isZipped = 0;
     
     sprintf(configIni, "%s/%s/config.ini", machinesDir, machineName);
-    file = fopen(configIni, "rb");
     
-    if (file != NULL)
-    {
-        fclose(file);
-    }
-    else
+    if (stat(configIni, &s) != 0)
     {
         // No config.ini. Is it compressed?
         char zipFile[512];
         
         sprintf(zipFile, "%s/%s.zip", machinesDir, machineName);
-        file = fopen(zipFile, "rb");
         
-        if (file == NULL)
+        if (stat(zipFile, &s) != 0)
         {
 		    machineDestroy(machine);
             return NULL; // Not compressed and no config.ini
         }
-        
-        fclose(file);
 
         machine->zipFile = (char *)calloc(strlen(zipFile) + 1, sizeof(char));
         strcpy(machine->zipFile, zipFile);
         
         machine->isZipped = 1;
     }
+
+    machineCacheStamp(&stamp, &s, machine->isZipped);
+
+    if (machineCacheGet(machine, machineName, &stamp))
+    {
+        machineUpdate(machine);
+        return machine;
+    }
     
     success = readMachine(machine, machineName, configIni);
     if (!success)
@@ -618,6 +886,8 @@ Machine* machineCreate(const char* machineName)
 		machineDestroy(machine);
         return NULL;
     }
+
+    machineCachePut(machine, &stamp);
     
     machineUpdate(machine);
     
@@ -702,7 +972,7 @@ int machineIsValid(const char* machineName, int checkRoms)
     return success;
 }
 
-void machineFillAvailable(ArrayList *list, int checkRoms)
+static void machineFillAvailableList(ArrayList *list, int checkRoms)
 {
     const char* machineName = appConfigGetString("singlemachine", NULL);
     const int maxNameLength = 512;
@@ -802,6 +1072,14 @@ void machineFillAvailable(ArrayList *list, int checkRoms)
     }
 }
 
+void machineFillAvailable(ArrayList *list, int checkRoms)
+{
+    machineFillAvailableList(list, checkRoms);
+
+    // The machines that were read during the scan are cached in one write
+    machineCacheFlush();
+}
+
 void machineUpdate(Machine* machine)
 {
     int entry;
@@ -1045,6 +1323,30 @@ void machineSaveState(Machine* machine)
     saveStateClose(state);
 }
 
+// Reads all ROM images of the machine into the shared image cache before
+// the slots are set up, in parallel when threads are available.
+static void machinePreloadRoms(Machine* machine)
+{
+    const char* fileNames[64];
+    const char* fileInZipFiles[64];
+    int count = 0;
+    int i;
+
+    for (i = 0; i < machine->slotInfoCount && count < 64; i++) {
+        if (machine->slotInfo[i].error || machine->slotInfo[i].name[0] == 0) {
+            continue;
+        }
+        if (machine->slotInfo[i].romType == ROM_MOONSOUND && !boardGetMoonsoundEnable()) {
+            continue;
+        }
+        fileNames[count]      = machine->slotInfo[i].name;
+        fileInZipFiles[count] = machine->slotInfo[i].inZipName;
+        count++;
+    }
+
+    romPreload(fileNames, fileInZipFiles, count);
+}
+
 int machineInitialize(Machine* machine, UInt8** mainRam, UInt32* mainRamSize, UInt32* mainRamStart)
 {
     UInt8* ram       = NULL;
@@ -1061,6 +1363,8 @@ int machineInitialize(Machine* machine, UInt8** mainRam, UInt32* mainRamSize, UI
     int size;
     int i;
 
+    machinePreloadRoms(machine);
+
     // Prioritize 1kB Mirrored ram as main ram (works good with coleco style
     // systems with expansion ram but maybe main ram type should be an arg instead?).
     for (i = 0; i < machine->slotInfoCount; i++) {
@@ -1135,7 +1439,7 @@ int machineInitialize(Machine* machine, UInt8** mainRam, UInt32* mainRamSize, UI
 
         if (machine->slotInfo[i].romType == ROM_JISYO) {
             if (jisyoRom == NULL) {
-                jisyoRom = romLoad(machine->slotInfo[i].name, machine->slotInfo[i].inZipName, &jisyoRomSize);
+                jisyoRom = romLoadShared(machine->slotInfo[i].name, machine->slotInfo[i].inZipName, &jisyoRomSize);
 
                 if (jisyoRom == NULL) {
                     success = 0;
@@ -1153,6 +1457,7 @@ int machineInitialize(Machine* machine, UInt8** mainRam, UInt32* mainRamSize, UI
     }
 
     if (ram == NULL) {
+        romPreloadRelease();
         return 0;
     }
 
@@ -1365,7 +1670,7 @@ int machineInitialize(Machine* machine, UInt8** mainRam, UInt32* mainRamSize, UI
         case SRAM_ESESCC:
             buf = NULL;
             if (strlen(romName)) {
-                buf = romLoad(machine->slotInfo[i].name, machine->slotInfo[i].inZipName, &size);
+                buf = romLoadShared(machine->slotInfo[i].name, machine->slotInfo[i].inZipName, &size);
                 if (buf == NULL) {
                     success = 0;
                     continue;
@@ -1387,13 +1692,18 @@ int machineInitialize(Machine* machine, UInt8** mainRam, UInt32* mainRamSize, UI
                                 (romName, buf, size, slot, subslot, startPage,
                                 machine->slotInfo[i].romType == SRAM_MEGASCSI ? hdId++ : 0, mode);
                 }
-                if (buf) free(buf);
+                if (buf) romRelease(buf);
             }
             continue;
+
+        case ROM_MOONSOUND:
+            // The wave ROM is shared and mapped by the Moonsound mapper
+            success &= romMapperMoonsoundCreateShared(machine->slotInfo[i].name, machine->slotInfo[i].inZipName, 640);
+            continue;
         }
         // -------------------------------
 
-        buf = romLoad(machine->slotInfo[i].name, machine->slotInfo[i].inZipName, &size);
+        buf = romLoadShared(machine->slotInfo[i].name, machine->slotInfo[i].inZipName, &size);
 
         if (buf == NULL) {
 
@@ -1507,11 +1817,6 @@ int machineInitialize(Machine* machine, UInt8** mainRam, UInt32* mainRamSize, UI
             }
             break;
 
-        case ROM_MOONSOUND:
-            success &= romMapperMoonsoundCreate(romName, buf, size, 640);
-            buf = NULL; // Ownership transferred to emulation of moonsound
-            break;
-
         case ROM_SCC:
             success &= romMapperSCCplusCreate(romName, buf, size, slot, subslot, startPage, SCC_EXTENDED);
             break;
@@ -1822,14 +2127,16 @@ int machineInitialize(Machine* machine, UInt8** mainRam, UInt32* mainRamSize, UI
             break;
         }
         if( buf != NULL ) {
-            free(buf);
+            romRelease(buf);
         }
     }
 
     if (jisyoRom != NULL) {
-        free(jisyoRom);
+        romRelease(jisyoRom);
     }
 
+    romPreloadRelease();
+
     if (mainRam != NULL) {
         *mainRam = ram;
     }
@@ -1854,3 +2161,10 @@ void machineSetDirectory(const char* dir)
 {
     strcpy(machinesDir, dir);
 }
+
+void machineSetCacheFile(const char* fileName)
+{
+    machineCacheFlush();
+    strcpy(machineCacheFile, fileName != NULL ? fileName : "");
+    machineCacheLoaded = 0;
+}
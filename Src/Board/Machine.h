@@ -121,6 +121,11 @@ void machineLoadState(Machine* machine);
 void machineSaveState(Machine* machine);
 
 void machineSetDirectory(const char* dir);
+void machineSetCacheFile(const char* fileName);
+
+// Machines read by machineCreate are added to the cache in memory. This
+// writes the cache file if anything was added since it was loaded.
+void machineCacheFlush();
 
 extern UInt8* g_mainRam;
 extern UInt32 g_mainRamSize;
@@ -174,6 +174,7 @@ static UInt32 getTimeTrace(int offset) {
 static void saveState()
 {    
     r800SaveState(r800);
+    mixerSaveState(boardGetMixer());
     deviceManagerSaveState();
     slotSaveState();
     sn76489SaveState(sn76489);
@@ -183,6 +184,7 @@ static void loadState()
 {
     r800LoadState(r800);
     boardInit(&r800->systemTime);
+    mixerLoadState(boardGetMixer());
     deviceManagerLoadState();
     slotLoadState();
     sn76489LoadState(sn76489);
@@ -287,6 +287,7 @@ static void saveState()
     saveStateClose(state);
 
     r800SaveState(r800);
+    mixerSaveState(boardGetMixer());
     deviceManagerSaveState();
     slotSaveState();
     ay8910SaveState(ay8910);
@@ -303,6 +304,7 @@ static void loadState()
     
     r800LoadState(r800);
     boardInit(&r800->systemTime);
+    mixerLoadState(boardGetMixer());
     deviceManagerLoadState();
     slotLoadState();
     ay8910LoadState(ay8910);
@@ -304,101 +304,181 @@ void dbgIoPortsAddPort(DbgIoPorts* ioPorts,
     }
 }
 
-typedef struct Watchpoint {
-    struct Watchpoint* next;
+// Watchpoints of each device type are kept in an array sorted on address.
+// A bitmap with one bit per address marks every byte covered by a
+// watchpoint, so accesses to other addresses are rejected with a single
+// bit test. On a hit the covering watchpoints are found with a binary
+// search; watchpoints are at most maxSize bytes long, so only the ones
+// starting less than maxSize bytes before the address need to be checked.
+
+#define WATCHPOINT_ADDRESS_BITS 18
+#define WATCHPOINT_ADDRESS_SPACE (1 << WATCHPOINT_ADDRESS_BITS)
+
+typedef struct {
     int address;
     DbgWatchpointCondition condition;
     UInt32 refValue;
     int size;
 } Watchpoint;
 
-Watchpoint* watchpoints[MAX_DEVICES];
+typedef struct {
+    Watchpoint* list;
+    int count;
+    int capacity;
+    int maxSize;
+    UInt32* bitmap;
+} WatchpointIndex;
+
+static WatchpointIndex watchpoints[MAX_DEVICES];
 
-void debugDeviceSetMemoryWatchpoint(DbgDeviceType devType, int address, DbgWatchpointCondition condition, UInt32 refValue, int size)
+// Returns the index of the first watchpoint starting at or after address
+static int watchpointFind(WatchpointIndex* wpi, int address)
 {
-    Watchpoint* watchpoint = watchpoints[devType];
+    int lo = 0;
+    int hi = wpi->count;
 
-    while (watchpoint != NULL) {
-        if (watchpoint->address == address) {
-            break;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (wpi->list[mid].address < address) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static void watchpointMark(WatchpointIndex* wpi, Watchpoint* watchpoint)
+{
+    int address;
+
+    for (address = watchpoint->address; address < watchpoint->address + watchpoint->size; address++) {
+        if (address >= 0 && address < WATCHPOINT_ADDRESS_SPACE) {
+            wpi->bitmap[address >> 5] |= 1u << (address & 31);
         }
-        watchpoint = watchpoint->next;
     }
-    if (watchpoint == NULL) {
-        watchpoint = (Watchpoint*)calloc(1, sizeof(Watchpoint));
-        watchpoint->next = watchpoints[devType];
-        watchpoints[devType] = watchpoint;
+}
+
+static void watchpointRebuildIndex(WatchpointIndex* wpi)
+{
+    int i;
+
+    memset(wpi->bitmap, 0, WATCHPOINT_ADDRESS_SPACE / 8);
+    wpi->maxSize = 1;
+
+    for (i = 0; i < wpi->count; i++) {
+        if (wpi->list[i].size > wpi->maxSize) {
+            wpi->maxSize = wpi->list[i].size;
+        }
+        watchpointMark(wpi, &wpi->list[i]);
+    }
+}
+
+void debugDeviceSetMemoryWatchpoint(DbgDeviceType devType, int address, DbgWatchpointCondition condition, UInt32 refValue, int size)
+{
+    WatchpointIndex* wpi = &watchpoints[devType];
+    int i;
+
+    if (wpi->bitmap == NULL) {
+        wpi->bitmap = (UInt32*)calloc(1, WATCHPOINT_ADDRESS_SPACE / 8);
+    }
+
+    if (size < 1) {
+        size = 1;
+    }
+
+    i = watchpointFind(wpi, address);
+    if (i == wpi->count || wpi->list[i].address != address) {
+        if (wpi->count == wpi->capacity) {
+            wpi->capacity = wpi->capacity ? 2 * wpi->capacity : 16;
+            wpi->list = (Watchpoint*)realloc(wpi->list, wpi->capacity * sizeof(Watchpoint));
+        }
+        memmove(wpi->list + i + 1, wpi->list + i, (wpi->count - i) * sizeof(Watchpoint));
+        wpi->count++;
     }
 
-    watchpoint->address = address;
-    watchpoint->condition = condition;
-    watchpoint->refValue = refValue;
-    watchpoint->size = size;
+    wpi->list[i].address = address;
+    wpi->list[i].condition = condition;
+    wpi->list[i].refValue = refValue;
+    wpi->list[i].size = size;
+
+    watchpointRebuildIndex(wpi);
 }
 
 void debugDeviceClearMemoryWatchpoint(DbgDeviceType devType, int address)
 {
-    Watchpoint* watchpoint = watchpoints[devType];
-    Watchpoint* prevWatchpoint = NULL;
-    while (watchpoint != NULL) {
-        if (watchpoint->address == address) {
-            if (prevWatchpoint == NULL) {
-                watchpoints[devType] = watchpoint->next;
+    WatchpointIndex* wpi = &watchpoints[devType];
+    int i = watchpointFind(wpi, address);
+
+    if (i == wpi->count || wpi->list[i].address != address) {
+        return;
+    }
+
+    wpi->count--;
+    memmove(wpi->list + i, wpi->list + i + 1, (wpi->count - i) * sizeof(Watchpoint));
+
+    watchpointRebuildIndex(wpi);
+}
+
+static int watchpointCheck(Watchpoint* watchpoint, int address, UInt8 value, void* ref, WatchpointReadMemCallback callback)
+{
+    UInt32 checkValue = 0;
+
+    if (watchpoint->size == 1) {
+        checkValue = value;
+    }
+    else {
+        int i;
+        for (i = 0; i < watchpoint->size; i++) {
+            checkValue <<= 8;
+            if (callback) {
+                checkValue |= callback(ref, watchpoint->address + i);
             }
-            else {
-                prevWatchpoint->next = watchpoint->next;
+            else if (watchpoint->address + i == address) {
+                checkValue |= value;
             }
-            free(watchpoint);
-            break;
         }
-        prevWatchpoint = watchpoint;
-        watchpoint = watchpoint->next;
     }
+    switch (watchpoint->condition) {
+    case DBGWP_ANY:
+        return 1;
+    case DBGWP_EQUALS:
+        return checkValue == watchpoint->refValue;
+    case DBGWP_NOT_EQUALS:
+        return checkValue != watchpoint->refValue;
+    case DBGWP_GREATER_THAN:
+        return checkValue > watchpoint->refValue;
+    case DBGWP_LESS_THAN:
+        return checkValue < watchpoint->refValue;
+    }
+    return 0;
 }
 
 void tryWatchpoint(DbgDeviceType devType, int address, UInt8 value, void* ref, WatchpointReadMemCallback callback) {
-    Watchpoint* watchpoint = watchpoints[devType];
-    while (watchpoint != NULL) {
-        if (address >= watchpoint->address && address < watchpoint->address + watchpoint->size) {
-            UInt32 checkValue = 0;
-            int breakpointHit = 0;
-            if (watchpoint->size == 1) {
-                checkValue = value;
-            }
-            else {
-                int i;
-                for (i = 0; i < watchpoint->size; i++) {
-                    checkValue <<= 8;
-                    if (callback) {
-                        checkValue |= callback(ref, watchpoint->address + i);
-                    }
-                    else if (watchpoint->address + i == address) {
-                        checkValue |= value;
-                    }
-                }
-            }
-            switch (watchpoint->condition) {
-            case DBGWP_ANY:
-                breakpointHit = 1;
-                break;
-            case DBGWP_EQUALS:
-                breakpointHit = checkValue == watchpoint->refValue;
-                break;
-            case DBGWP_NOT_EQUALS:
-                breakpointHit = checkValue != watchpoint->refValue;
-                break;
-            case DBGWP_GREATER_THAN:
-                breakpointHit = checkValue > watchpoint->refValue;
-                break;
-            case DBGWP_LESS_THAN:
-                breakpointHit = checkValue < watchpoint->refValue;
-                break;
-            }
-            if (breakpointHit) {
-                boardOnBreakpoint(0);
-                return;
-            }
+    WatchpointIndex* wpi = &watchpoints[devType];
+    int i;
+
+    if (wpi->count == 0) {
+        return;
+    }
+    if (address >= 0 && address < WATCHPOINT_ADDRESS_SPACE &&
+        (wpi->bitmap[address >> 5] & (1u << (address & 31))) == 0)
+    {
+        return;
+    }
+
+    // Check the watchpoints that may cover the address, last one first
+    for (i = watchpointFind(wpi, address + 1) - 1; i >= 0; i--) {
+        Watchpoint* watchpoint = &wpi->list[i];
+        if (watchpoint->address <= address - wpi->maxSize) {
+            break;
+        }
+        if (address < watchpoint->address + watchpoint->size &&
+            watchpointCheck(watchpoint, address, value, ref, callback))
+        {
+            boardOnBreakpoint(0);
+            return;
         }
-        watchpoint = watchpoint->next;
     }
 }
@@ -34,6 +34,7 @@
 #include "Properties.h"
 #include "SaveState.h"
 #include "ziphelper.h"
+#include "FileWriter.h"
 
 
 // PacketFileSystem.h Need to be included after all other includes
@@ -56,6 +57,12 @@ static char*  ramImageBuffer = NULL;
 static int    ramImageSize = 0;
 static int    ramImagePos = 0;
 static int    rewindNextInsert = 0;
+static ZipStream* ramImageStream = NULL;
+static int    ramImageFilled = 0;
+
+// Tape format detection only looks at the start of zipped tapes so the
+// rest can be inflated as the tape is played
+#define TAPE_SNIFF_SIZE 0x10000
 
 static char* stripPath(char* filename) {
     char* ptr = filename + strlen(filename) - 1;
@@ -69,6 +76,24 @@ static char* stripPath(char* filename) {
     return filename;
 }
 
+// Zipped tapes are inflated as the tape position advances. Returns 0 if
+// the tape can't be inflated up to end.
+static int ramImageFill(int end)
+{
+    if (ramImageStream != NULL && end > ramImageFilled) {
+        int filled = zipStreamFill(ramImageStream, ramImageBuffer, end);
+        if (filled < 0) {
+            return 0;
+        }
+        ramImageFilled = filled;
+        if (ramImageFilled >= ramImageSize) {
+            zipStreamClose(ramImageStream);
+            ramImageStream = NULL;
+        }
+    }
+    return 1;
+}
+
 static int ramread(void* buf, int size, int* ramPos) {
     if (*ramPos > ramImageSize) {
         return 0;
@@ -77,6 +102,9 @@ static int ramread(void* buf, int size, int* ramPos) {
         size = ramImageSize - *ramPos;
     }
 
+    if (!ramImageFill(*ramPos + size)) {
+        return 0;
+    }
     memcpy(buf, ramImageBuffer + *ramPos, size);
     *ramPos += size;
 
@@ -105,7 +133,7 @@ void tapeSaveState() {
 UInt8 tapeRead(UInt8* value) 
 {
     if (ramImageBuffer != NULL) {
-        if (ramImagePos < ramImageSize) {
+        if (ramImagePos < ramImageSize && ramImageFill(ramImagePos + 1)) {
             *value = ramImageBuffer[ramImagePos++];
             ledSetCas(1);
             return 1;
@@ -119,6 +147,10 @@ UInt8 tapeRead(UInt8* value)
 UInt8 tapeWrite(UInt8 value) 
 {
     if (ramImageBuffer != NULL) {
+        if (!ramImageFill(ramImagePos >= ramImageSize ? ramImageSize : ramImagePos + 1)) {
+            return 0;
+        }
+
         if (ramImagePos >= ramImageSize) {
             char* newBuf = realloc(ramImageBuffer, ramImageSize + 128);
             if (newBuf) {
@@ -193,18 +225,17 @@ int tapeInsert(char *name, const char *fileInZipFile)
     Properties* pProperties = propGetGlobalProperties();
     
     if (ramImageBuffer != NULL) {
-        file = fopen(tapePosName, "w");
-        if (file != NULL) {
-            char buffer[32];
-            sprintf(buffer, "POS:%d", ramImagePos);
-            fwrite(buffer, 1, 32, file);
-            fclose(file);
-        }
+        char buffer[32] = { 0 };
+        sprintf(buffer, "POS:%d", ramImagePos);
+        fileWriterSave(tapePosName, NULL, 0, buffer, 32);
 
         if (*tapeName && tapeRdWr) {
             tapeSave(tapeName, tapeFormat);
         }
 
+        zipStreamClose(ramImageStream);
+        ramImageStream = NULL;
+
         free(ramImageBuffer);
         ramImageBuffer = NULL;
     }
@@ -228,6 +259,7 @@ int tapeInsert(char *name, const char *fileInZipFile)
     ramImagePos = 0;
 
     // Load and verify tape position
+    fileWriterWait(tapePosName);
     file = fopen(tapePosName, "rb");
     if (file != NULL) {
         char buffer[32] = { 0 };
@@ -237,7 +269,13 @@ int tapeInsert(char *name, const char *fileInZipFile)
     }
 
     if (fileInZipFile != NULL) {
-        ramImageBuffer = zipLoadFile(name, fileInZipFile, &ramImageSize);
+        ramImageStream = zipStreamOpen(name, fileInZipFile, &ramImageSize);
+        if (ramImageStream != NULL) {
+            ramImageBuffer = malloc(ramImageSize > 0 ? ramImageSize : 1);
+        }
+        else {
+            ramImageBuffer = zipLoadFile(name, fileInZipFile, &ramImageSize);
+        }
         if (ramImagePos > ramImageSize) {
             ramImagePos = ramImageSize;
         }
@@ -263,8 +301,14 @@ int tapeInsert(char *name, const char *fileInZipFile)
     if (rewindNextInsert&&pProperties->cassette.rewindAfterInsert) ramImagePos=0;
     rewindNextInsert=0;
 
+    ramImageFilled = ramImageSize;
+    if (ramImageStream != NULL) {
+        ramImageFilled = 0;
+        ramImageFill(TAPE_SNIFF_SIZE);
+    }
+
     if (ramImageBuffer != NULL) {
-        UInt8* ptr = ramImageBuffer + ramImageSize - 17;
+        UInt8* ptr = ramImageBuffer + ramImageFilled - 17;
         int cntFMSXDOS = 0;
         int cntFMSX98  = 0;
         int cntSVICAS  = 0;
@@ -327,6 +371,10 @@ int tapeSave(char *name, TapeFormat format)
         return 0;
     }
 
+    if (!ramImageFill(ramImageSize)) {
+        return 0;
+    }
+
     file = fopen(name, "wb");
     if (file == NULL) {
         return 0;
@@ -400,6 +448,8 @@ TapeContent* tapeGetContent(int* count)
         return tapeContent;
     }
 
+    ramImageFill(ramImageSize);
+
     while (ramread(buffer, tapeHeaderSize, &ramPos) == tapeHeaderSize) {
         if (!memcmp(buffer, tapeHeader, tapeHeaderSize)) {
             if (skipNext) {
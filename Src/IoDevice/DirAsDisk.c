@@ -284,6 +284,12 @@ static int sectorsperfat,numberoffats,reservedsectors;
 static int UINT8spersector,direlements,fatelements;
 static int availsectors;
 
+// Free clusters of the MSX image, one bit per cluster. The bits are kept
+// in sync with the FAT so allocating a cluster doesn't scan the FAT.
+static UInt32 freemap[(80*9*2+31)/32];
+static int freecount;
+static int freehint;
+
 static int alBlockNo;
 
 static void load_dsk_svi(int diskType)
@@ -351,11 +357,7 @@ static void load_dsk_svi(int diskType)
     }
 }
 
-static void load_dsk_msx(void) {
-    dskimagesize = 720*1024;
-    dskimage=(UINT8 *) calloc (1,720*1024);
-    memset (dskimage,0,720*1024);
-    memcpy (dskimage,msxboot,512);
+static void set_dsk_msx_layout(void) {
     reservedsectors=*(UINT16 *)(dskimage+0x0E);
     numberoffats=*(dskimage+0x10);
     sectorsperfat=*(UINT16 *)(dskimage+0x16);
@@ -367,6 +369,14 @@ static void load_dsk_msx(void) {
     availsectors=80*9*2-reservedsectors-sectorsperfat*numberoffats;
     availsectors-=direlements*32/UINT8spersector;
     fatelements=availsectors/2;
+}
+
+static void load_dsk_msx(void) {
+    dskimagesize = 720*1024;
+    dskimage=(UINT8 *) calloc (1,720*1024);
+    memset (dskimage,0,720*1024);
+    memcpy (dskimage,msxboot,512);
+    set_dsk_msx_layout();
     fat[0]=0xF9;
     fat[1]=0xFF;
     fat[2]=0xFF;
@@ -456,18 +466,33 @@ static int next_link(int link) {
     return (((int)(fat[pos+1]&0xF))<<8)+fat[pos];
 }
 
-static int UINT8s_free(void) {
-  int i,avail=0;
+static void set_free(int link) {
+  freemap[link>>5]|=1u<<(link&31);
+  freecount++;
+  if (link<freehint)
+    freehint=link;
+}
+
+static void init_freemap(void) {
+  int i;
 
-  for (i=2; i<2+fatelements; i++)
-    if (!next_link (i)) avail++;
-  return avail*1024;
+  memset (freemap,0,sizeof (freemap));
+  freecount=0;
+  freehint=2+fatelements;
+  for (i=2+fatelements-1; i>=2; i--)
+    if (!next_link (i)) set_free (i);
+}
+
+static int UINT8s_free(void) {
+  return freecount*1024;
 }
 
 static int remove_link(int link) {
   int pos;
   int current;
 
+  set_free (link);
+
   pos=(link>>1)*3;
   if (link&1) {
     current=(((int)(fat[pos+2]))<<4)+(fat[pos+1]>>4);
@@ -486,34 +511,40 @@ static int remove_link(int link) {
 static void wipe(fileinfo *file) {
   int current;
 
+  // Empty files have no clusters
   current=file->first;
-  do {
+  while (current>=2 && current<2+fatelements) {
     current=remove_link (current);
-  } while (current!=0xFFF);
+  }
   direc[file->pos*32]=0xE5;
 }
 
-static int get_free(void) {
+static void wipe_matching(char *name) {
+  fileinfo *file;
   int i;
 
-  for (i=2; i<2+fatelements; i++)
-    if (!next_link (i)) return i;
-  //printf ("Internal error\n");
-  //exit (5);
-  return 0;
+  for (i=0; i<direlements; i++) {
+    if ((file=getfileinfo (i))!=NULL) {
+      if (match (file,name)) {
+        wipe (file);
+      }
+      free (file);
+    }
+  }
 }
 
-static int get_next_free(void) {
-  int i,status=0;
-
-  for (i=2; i<2+fatelements; i++)
-    if (!next_link (i)) 
-      if (status) 
-        return i;
-      else
-        status=1;
-  //printf ("Internal error\n");
-  //exit (5);
+// Returns the lowest free cluster and marks it as used
+static int alloc_cluster(void) {
+  int i;
+
+  for (i=freehint; i<2+fatelements; i++) {
+    if (freemap[i>>5]&(1u<<(i&31))) {
+      freemap[i>>5]&=~(1u<<(i&31));
+      freecount--;
+      freehint=i+1;
+      return i;
+    }
+  }
   return 0;
 }
 
@@ -533,12 +564,21 @@ static void store_fat(int link, int next) {
   }
 }
 
+// Reads length bytes, retrying short reads
+static int read_fully(int fileid, UINT8 *buffer, int length) {
+  while (length>0) {
+    int n=read (fileid,buffer,length);
+    if (n<=0)
+      return 0;
+    buffer+=n;
+    length-=n;
+  }
+  return 1;
+}
+
 static int add_single_file(char *name, const char *pathname) {
   int i,total;
-  fileinfo *file;
   int fileid;
-  UINT8 *buffer;
-  UINT8 *b;
   int size;
   struct stat s;
   struct tm *t;
@@ -559,14 +599,7 @@ static int add_single_file(char *name, const char *pathname) {
       return -1;
   }
 
-  for (i=0; i<direlements; i++) {
-    if ((file=getfileinfo (i))!=NULL) {
-      if (match (file,name)) {
-        wipe (file);
-      }
-      free (file);
-    }
-  }
+  wipe_matching (name);
 
   if ((size=getfilelength(fileid))>UINT8s_free())
   {
@@ -585,24 +618,40 @@ static int add_single_file(char *name, const char *pathname) {
 
   pos=i;
 
-  b = buffer=(UINT8 *) malloc ((size+1023)&(~1023));
-  read (fileid,buffer,size);
-
-  close (fileid);
-
+  // Allocate the cluster chain, then read each run of consecutive
+  // clusters straight into the image
   total=(size+1023)>>10;
-  current=first=get_free ();
+  first=total>0?alloc_cluster ():0;
 
-  for (i=0; i<total;) {
-    memcpy (cluster+(current-2)*1024,buffer,1024);
-    buffer+=1024;
-    if (++i==total)
-      next=0xFFF;
-    else
-      next=get_next_free ();
+  current=first;
+  for (i=1; i<total; i++) {
+    next=alloc_cluster ();
     store_fat (current,next);
     current=next;
   }
+  if (total>0)
+    store_fat (current,0xFFF);
+
+  current=first;
+  for (i=0; i<size;) {
+    int start=current;
+    int length;
+
+    while (i+(current-start+1)*1024<size && next_link (current)==current+1)
+      current++;
+    length=(current-start+1)*1024;
+    if (i+length>size)
+      length=size-i;
+
+    memset (cluster+(start-2)*1024+length,0,(current-start+1)*1024-length);
+    if (!read_fully (fileid,cluster+(start-2)*1024,length))
+      break;
+
+    i+=length;
+    current=next_link (current);
+  }
+
+  close (fileid);
 
   memset (direc+pos*32,0,32);
   memset (direc+pos*32,0x20,11);
@@ -634,7 +683,6 @@ static int add_single_file(char *name, const char *pathname) {
     *(UINT16 *)(direc+pos*32+0x18)=
         (t->tm_mday)+(t->tm_mon<<5)+((t->tm_year-1980)<<9);
   }
-  free (b);
   return result;
 }
 
@@ -957,34 +1005,217 @@ static int add_single_file_cpm(int diskType, char *name, const char *pathname)
 }
 
 #ifdef USE_ARCH_GLOB
+// The last MSX image built from a directory is kept together with the
+// size and the modification and status change times of its files. When
+// the same directory is inserted again only the files that changed are
+// read from the host.
+typedef struct {
+    char   name[256];
+    time_t mtime;
+    long   mtimeNsec;
+    time_t ctime;
+    int    size;
+    int    changed;
+} DirFileInfo;
+
+// Whole seconds miss a rewrite of the same size within one second, so
+// the nanoseconds are compared as well where the host provides them
+#if defined(__APPLE__)
+#define DIR_MTIME_NSEC(s) ((long)(s).st_mtimespec.tv_nsec)
+#elif defined(__linux__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__)
+#define DIR_MTIME_NSEC(s) ((long)(s).st_mtim.tv_nsec)
+#else
+#define DIR_MTIME_NSEC(s) 0L
+#endif
+
+static char         cacheDirectory[512];
+static UINT8*       cacheImage;
+static DirFileInfo* cacheFiles;
+static int          cacheFileCount;
+
+static void dirCacheClear()
+{
+    free(cacheImage);
+    free(cacheFiles);
+    cacheImage        = NULL;
+    cacheFiles        = NULL;
+    cacheFileCount    = 0;
+    cacheDirectory[0] = 0;
+}
+
+static DirFileInfo* dirCacheFind(const char* name)
+{
+    int i;
+
+    for (i = 0; i < cacheFileCount; i++) {
+        if (strcmp(cacheFiles[i].name, name) == 0) {
+            return &cacheFiles[i];
+        }
+    }
+    return NULL;
+}
+
+// Builds the 8.3 name add_single_file stores for a host file name
+static void dirEntryName(fileinfo* file, const char* name)
+{
+    UINT8 entry[11];
+    int i = 0;
+
+    memset(entry, 0x20, sizeof(entry));
+    for (; *name; name++) {
+        if (*name == '.') {
+            i = 8;
+            continue;
+        }
+        if (i < 11) {
+            entry[i] = toupper(*name);
+        }
+        i++;
+    }
+
+    for (i = 0; i < 8; i++) {
+        file->name[i] = entry[i] == 0x20 ? 0 : entry[i];
+    }
+    file->name[8] = 0;
+    for (i = 0; i < 3; i++) {
+        file->ext[i] = entry[i + 8] == 0x20 ? 0 : entry[i + 8];
+    }
+    file->ext[3] = 0;
+}
+
+// Host names share a directory entry when adding or wiping one of them
+// would match the entry of the other
+static int dirSameEntry(const char* a, const char* b)
+{
+    fileinfo entry;
+
+    dirEntryName(&entry, b);
+    if (match(&entry, (char*)a)) {
+        return 1;
+    }
+    dirEntryName(&entry, a);
+    return match(&entry, (char*)b);
+}
+
+static void dirMarkSharedEntries(DirFileInfo* files, int fileCount, const char* name)
+{
+    int i;
+
+    for (i = 0; i < fileCount; i++) {
+        if (!files[i].changed && dirSameEntry(files[i].name, name)) {
+            files[i].changed = 1;
+        }
+    }
+}
+
+static char* dirFileName(char* path)
+{
+    char* fileName = strrchr(path, '/');
+    if (fileName == NULL) {
+        fileName = strrchr(path, '\\');
+    }
+    return fileName != NULL ? fileName + 1 : NULL;
+}
+
 void* dirLoadFile(DirDiskType diskType, const char* directory, int* size)
 {
     ArchGlob* glob;
     static char filename[512];
+    DirFileInfo* files = NULL;
+    int fileCount = 0;
+    int incremental = 0;
+
+    sprintf(filename, "%s/*", directory);
+
+    glob = archGlob(filename, ARCH_GLOB_FILES);
+    if (glob != NULL) {
+        fileCount = glob->count;
+    }
 
     if (diskType == 0) {
-        load_dsk_msx();
+        incremental = cacheImage != NULL && strcmp(cacheDirectory, directory) == 0;
+        if (incremental) {
+            dskimagesize = 720*1024;
+            dskimage = (UINT8 *)malloc(dskimagesize);
+            memcpy(dskimage, cacheImage, dskimagesize);
+            set_dsk_msx_layout();
+        }
+        else {
+            load_dsk_msx();
+        }
+        init_freemap();
+
+        if (fileCount > 0) {
+            files = (DirFileInfo*)calloc(fileCount, sizeof(DirFileInfo));
+        }
     }
     else {
         load_dsk_svi(diskType);
     }
 
-    sprintf(filename, "%s/*", directory);
-
-    glob = archGlob(filename, ARCH_GLOB_FILES);
-
     if (glob != NULL) {
         int rv;
         int i;
+
+        if (diskType == 0) {
+            // Remove the files that changed or are gone before adding
+            // anything, so the freed clusters can be reused
+            for (i = 0; incremental && i < cacheFileCount; i++) {
+                cacheFiles[i].changed = 1;
+            }
+            for (i = 0; i < fileCount; i++) {
+                char* fileName = dirFileName(glob->pathVector[i]);
+                DirFileInfo* cached;
+                struct stat s;
+
+                files[i].changed = 1;
+                if (fileName == NULL || stat(glob->pathVector[i], &s) != 0) {
+                    continue;
+                }
+                strncpy(files[i].name, fileName, sizeof(files[i].name) - 1);
+                files[i].mtime     = s.st_mtime;
+                files[i].mtimeNsec = DIR_MTIME_NSEC(s);
+                files[i].ctime     = s.st_ctime;
+                files[i].size      = (int)s.st_size;
+
+                cached = incremental ? dirCacheFind(fileName) : NULL;
+                if (cached != NULL) {
+                    cached->changed = 0;
+                    if (cached->mtime     == files[i].mtime     &&
+                        cached->mtimeNsec == files[i].mtimeNsec &&
+                        cached->ctime     == files[i].ctime     &&
+                        cached->size      == files[i].size)
+                    {
+                        files[i].changed = 0;
+                    }
+                    else {
+                        wipe_matching(fileName);
+                    }
+                }
+            }
+            for (i = 0; incremental && i < cacheFileCount; i++) {
+                if (cacheFiles[i].changed) {
+                    wipe_matching(cacheFiles[i].name);
+                    dirMarkSharedEntries(files, fileCount, cacheFiles[i].name);
+                }
+            }
+            // A wiped entry may have held another file with the same
+            // name, those are added again in the same order as a full build
+            for (i = 0; incremental && i < fileCount; i++) {
+                if (files[i].changed && files[i].name[0] != 0) {
+                    dirMarkSharedEntries(files, fileCount, files[i].name);
+                }
+            }
+        }
+
         for (i = 0; i < glob->count; i++) {
-            char* fileName = strrchr(glob->pathVector[i], '/');
+            char* fileName = dirFileName(glob->pathVector[i]);
             if (fileName == NULL) {
-                fileName = strrchr(glob->pathVector[i], '\\');
+                continue;
             }
-            if (fileName == NULL) {
+            if (files != NULL && !files[i].changed) {
                 continue;
             }
-            fileName++;
             if (diskType == 0) {
                 rv = add_single_file(fileName, directory);
             }
@@ -1004,6 +1235,35 @@ void* dirLoadFile(DirDiskType diskType, const char* directory, int* size)
 
         archGlobFree(glob);
     }
+    else if (incremental) {
+        // No files left in the directory
+        free(dskimage);
+        load_dsk_msx();
+    }
+
+    if (diskType == 0) {
+        // Directories whose path doesn't fit the cache are always rebuilt
+        if (dskimage != NULL && strlen(directory) < sizeof(cacheDirectory)) {
+            int i;
+
+            if (cacheImage == NULL) {
+                cacheImage = (UINT8 *)malloc(dskimagesize);
+            }
+            memcpy(cacheImage, dskimage, dskimagesize);
+            strcpy(cacheDirectory, directory);
+
+            free(cacheFiles);
+            cacheFiles     = files;
+            cacheFileCount = fileCount;
+            for (i = 0; i < fileCount; i++) {
+                cacheFiles[i].changed = 0;
+            }
+        }
+        else {
+            free(files);
+            dirCacheClear();
+        }
+    }
 
     *size = dskimagesize;
 
@@ -28,11 +28,17 @@
 #include "Disk.h"
 #include "DirAsDisk.h"
 #include "ziphelper.h"
+#include "FileWriter.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <sys/stat.h>
 
+#if (defined(__linux__) || defined(__APPLE__)) && !defined(USE_PACKET_FS)
+#define DISK_PREAD
+#include <unistd.h>
+#endif
+
 // PacketFileSystem.h Need to be included after all other includes
 #include "PacketFileSystem.h"
 
@@ -42,12 +48,31 @@
 #define DISK_ERRORS_HEADER_SIZE 0x14
 #define DISK_ERRORS_SIZE        ((MAXSECTOR+7)/8)
 
+// Image files are accessed through a direct mapped cache of 8kB lines, so a
+// sector read brings in the rest of the track and multi sector transfers
+// from the IDE and SCSI devices become a few large reads. Writes are kept
+// in the cache and written back when a line is evicted, the disk is changed,
+// or diskFlush() is called. With positional I/O the write back is done by the
+// background file writer, and lines are only read from the file after the
+// pending writes to it are done.
+#define DISK_CACHE_LINE_SIZE    0x2000
+#define DISK_CACHE_LINES        64
+
+typedef struct {
+    int   line;
+    int   valid;
+    int   dirtyStart;
+    int   dirtyEnd;
+    UInt8 data[DISK_CACHE_LINE_SIZE];
+} DiskCacheLine;
+
 static int   drivesEnabled[MAXDRIVES] = { 1, 1 };
 static int   drivesIsCdrom[MAXDRIVES];
 static FILE* drives[MAXDRIVES];
 static int   RdOnly[MAXDRIVES];
 static char* ramImageBuffer[MAXDRIVES];
 static int   ramImageSize[MAXDRIVES];
+static ZipStream* ramImageStream[MAXDRIVES];
 static int   sectorsPerTrack[MAXDRIVES];
 static int   sectorSize[MAXDRIVES];
 static int   fileSize[MAXDRIVES];
@@ -57,7 +82,203 @@ static int   changed[MAXDRIVES];
 static int   diskType[MAXDRIVES];
 static int   maxSector[MAXDRIVES];
 static char* drivesErrors[MAXDRIVES];
+static char  drivesFileName[MAXDRIVES][512];
+static DiskCacheLine* diskCache[MAXDRIVES];
+static int   diskCacheDirty[MAXDRIVES];
 static const UInt8 svi328Cpm80track[] = "CP/M-80";
+
+// Zipped images are inflated as the sectors are accessed. Returns 0 if
+// the image can't be inflated up to end.
+static int ramImageFill(int driveId, int end)
+{
+    int filled;
+
+    if (ramImageStream[driveId] == NULL) {
+        return 1;
+    }
+
+    filled = zipStreamFill(ramImageStream[driveId], ramImageBuffer[driveId], end);
+    if (filled >= ramImageSize[driveId]) {
+        zipStreamClose(ramImageStream[driveId]);
+        ramImageStream[driveId] = NULL;
+    }
+    return filled >= 0;
+}
+
+static int diskFileRead(int driveId, UInt8* buffer, int offset, int length)
+{
+#ifdef DISK_PREAD
+    int rv;
+
+    fileWriterWaitRange(drivesFileName[driveId], offset, length);
+
+    rv = (int)pread(fileno(drives[driveId]), buffer, length, offset);
+    return rv > 0 ? rv : 0;
+#else
+    if (0 != fseek(drives[driveId], offset, SEEK_SET)) {
+        return 0;
+    }
+    return fread(buffer, 1, length, drives[driveId]);
+#endif
+}
+
+static int diskFileWrite(int driveId, const UInt8* buffer, int offset, int length)
+{
+#ifdef DISK_PREAD
+    fileWriterPatch(drivesFileName[driveId], offset, buffer, length);
+    return 1;
+#else
+    if (0 != fseek(drives[driveId], offset, SEEK_SET)) {
+        return 0;
+    }
+    return fwrite(buffer, 1, length, drives[driveId]) == length;
+#endif
+}
+
+static int diskCacheWriteBack(int driveId, DiskCacheLine* cl)
+{
+    int success = 1;
+
+    if (cl->dirtyEnd > cl->dirtyStart) {
+        success = diskFileWrite(driveId, cl->data + cl->dirtyStart, 
+                                cl->line * DISK_CACHE_LINE_SIZE + cl->dirtyStart,
+                                cl->dirtyEnd - cl->dirtyStart);
+        cl->dirtyStart = 0;
+        cl->dirtyEnd   = 0;
+    }
+    return success;
+}
+
+// Save states flush the disks, so a drive that wasn't written since the
+// last flush returns without looking at its lines
+static void diskCacheFlush(int driveId)
+{
+    int i;
+
+    if (diskCache[driveId] == NULL || !diskCacheDirty[driveId]) {
+        return;
+    }
+
+    for (i = 0; i < DISK_CACHE_LINES; i++) {
+        diskCacheWriteBack(driveId, diskCache[driveId] + i);
+    }
+#ifndef DISK_PREAD
+    fflush(drives[driveId]);
+#endif
+    diskCacheDirty[driveId] = 0;
+}
+
+static void diskCacheCreate(int driveId)
+{
+    int i;
+
+    diskCache[driveId] = malloc(DISK_CACHE_LINES * sizeof(DiskCacheLine));
+    diskCacheDirty[driveId] = 0;
+    for (i = 0; i < DISK_CACHE_LINES; i++) {
+        diskCache[driveId][i].line       = -1;
+        diskCache[driveId][i].valid      = 0;
+        diskCache[driveId][i].dirtyStart = 0;
+        diskCache[driveId][i].dirtyEnd   = 0;
+    }
+}
+
+static void diskCacheDestroy(int driveId)
+{
+    if (diskCache[driveId] != NULL) {
+        diskCacheFlush(driveId);
+        free(diskCache[driveId]);
+        diskCache[driveId] = NULL;
+    }
+}
+
+static DiskCacheLine* diskCacheGetLine(int driveId, int line)
+{
+    DiskCacheLine* cl = diskCache[driveId] + (line & (DISK_CACHE_LINES - 1));
+
+    if (cl->line != line) {
+        diskCacheWriteBack(driveId, cl);
+
+        cl->line  = line;
+        cl->valid = diskFileRead(driveId, cl->data, line * DISK_CACHE_LINE_SIZE, DISK_CACHE_LINE_SIZE);
+        memset(cl->data + cl->valid, 0, DISK_CACHE_LINE_SIZE - cl->valid);
+    }
+    return cl;
+}
+
+// Returns 0 if any part of the range is beyond the end of the image
+static int diskCacheRead(int driveId, UInt8* buffer, int offset, int length)
+{
+    if (offset < 0) {
+        return 0;
+    }
+
+    while (length > 0) {
+        DiskCacheLine* cl = diskCacheGetLine(driveId, offset / DISK_CACHE_LINE_SIZE);
+        int start = offset % DISK_CACHE_LINE_SIZE;
+        int count = DISK_CACHE_LINE_SIZE - start;
+
+        if (count > length) {
+            count = length;
+        }
+        if (start + count > cl->valid) {
+            return 0;
+        }
+
+        memcpy(buffer, cl->data + start, count);
+        buffer += count;
+        offset += count;
+        length -= count;
+    }
+    return 1;
+}
+
+static int diskCacheWrite(int driveId, const UInt8* buffer, int offset, int length)
+{
+    if (offset < 0) {
+        return 0;
+    }
+
+    diskCacheDirty[driveId] = 1;
+
+    while (length > 0) {
+        DiskCacheLine* cl = diskCacheGetLine(driveId, offset / DISK_CACHE_LINE_SIZE);
+        int start = offset % DISK_CACHE_LINE_SIZE;
+        int count = DISK_CACHE_LINE_SIZE - start;
+
+        if (count > length) {
+            count = length;
+        }
+
+        memcpy(cl->data + start, buffer, count);
+
+        if (cl->dirtyEnd == cl->dirtyStart) {
+            cl->dirtyStart = start;
+            cl->dirtyEnd   = start + count;
+        }
+        else {
+            if (start < cl->dirtyStart)       cl->dirtyStart = start;
+            if (start + count > cl->dirtyEnd) cl->dirtyEnd   = start + count;
+        }
+        if (start + count > cl->valid) {
+            cl->valid = start + count;
+        }
+
+        buffer += count;
+        offset += count;
+        length -= count;
+    }
+    return 1;
+}
+
+void diskFlush()
+{
+    int i;
+
+    for (i = 0; i < MAXDRIVES; i++) {
+        diskCacheFlush(i);
+    }
+}
+
 static void diskHdUpdateInfo(int driveId);
 static void diskReadHdIdentifySector(int driveId, UInt8* buffer);
 
@@ -184,15 +405,16 @@ DSKE diskRead(int driveId, UInt8* buffer, int sector)
             return DSKE_NO_DATA;
         }
 
+        if (!ramImageFill(driveId, offset + sectorSize[driveId])) {
+            return DSKE_NO_DATA;
+        }
         memcpy(buffer, ramImageBuffer[driveId] + offset, sectorSize[driveId]);
         return DSKE_OK;
     }
     else {
         if ((drives[driveId] != NULL)) {
-            if (0 == fseek(drives[driveId], sector * sectorSize[driveId], SEEK_SET)) {
-                UInt8 success = fread(buffer, 1, sectorSize[driveId], drives[driveId]) == sectorSize[driveId];
-                return success? diskReadError(driveId, sector) : DSKE_NO_DATA;
-            }
+            UInt8 success = diskCacheRead(driveId, buffer, sector * sectorSize[driveId], sectorSize[driveId]);
+            return success? diskReadError(driveId, sector) : DSKE_NO_DATA;
         }
     }
     return DSKE_NO_DATA;
@@ -224,17 +446,18 @@ DSKE diskReadSector(int driveId, UInt8* buffer, int sector, int side, int track,
             return DSKE_NO_DATA;
         }
 
+        if (!ramImageFill(driveId, offset + secSize)) {
+            return DSKE_NO_DATA;
+        }
         memcpy(buffer, ramImageBuffer[driveId] + offset, secSize);
         sectornum = sector - 1 + diskGetSectorsPerTrack(driveId) * (track * diskGetSides(driveId) + side);
         return diskReadError(driveId, sectornum);
     }
     else {
         if ((drives[driveId] != NULL)) {
-            if (0 == fseek(drives[driveId], offset, SEEK_SET)) {
-                UInt8 success = fread(buffer, 1, secSize, drives[driveId]) == secSize;
-                int sectornum = sector - 1 + diskGetSectorsPerTrack(driveId) * (track * diskGetSides(driveId) + side);
-                return success? diskReadError(driveId, sectornum) : DSKE_NO_DATA;
-            }
+            UInt8 success = diskCacheRead(driveId, buffer, offset, secSize);
+            int sectornum = sector - 1 + diskGetSectorsPerTrack(driveId) * (track * diskGetSides(driveId) + side);
+            return success? diskReadError(driveId, sectornum) : DSKE_NO_DATA;
         }
     }
 
@@ -469,18 +692,19 @@ UInt8 diskWrite(int driveId, UInt8 *buffer, int sector)
             return 0;
         }
 
+        if (!ramImageFill(driveId, offset + sectorSize[driveId])) {
+            return 0;
+        }
         memcpy(ramImageBuffer[driveId] + offset, buffer, sectorSize[driveId]);
         return 1;
     }
     else {
         if (drives[driveId] != NULL && !RdOnly[driveId]) {
-            if (0 == fseek(drives[driveId], sector * sectorSize[driveId], SEEK_SET)) {
-                UInt8 success = fwrite(buffer, 1, sectorSize[driveId], drives[driveId]) == sectorSize[driveId];
-                if (success && sector == 0) {
-                    diskUpdateInfo(driveId);
-                }
-                return success;
+            UInt8 success = diskCacheWrite(driveId, buffer, sector * sectorSize[driveId], sectorSize[driveId]);
+            if (success && sector == 0) {
+                diskUpdateInfo(driveId);
             }
+            return success;
         }
     }
     return 0;
@@ -509,15 +733,15 @@ UInt8 diskWriteSector(int driveId, UInt8 *buffer, int sector, int side, int trac
             return 0;
         }
 
+        if (!ramImageFill(driveId, offset + secSize)) {
+            return 0;
+        }
         memcpy(ramImageBuffer[driveId] + offset, buffer, secSize);
         return 1;
     }
     else {
         if (drives[driveId] != NULL && !RdOnly[driveId]) {
-            if (0 == fseek(drives[driveId], offset, SEEK_SET)) {
-                UInt8 success = fwrite(buffer, 1, secSize, drives[driveId]) == secSize;
-                return success;
-            }
+            return diskCacheWrite(driveId, buffer, offset, secSize);
         }
     }
     return 0;
@@ -556,10 +780,16 @@ UInt8 diskChange(int driveId, const char* fileName, const char* fileInZipFile)
 
     /* Close previous disk image */
     if(drives[driveId] != NULL) { 
+        diskCacheDestroy(driveId);
         fclose(drives[driveId]);
         drives[driveId] = NULL; 
     }
 
+    if (ramImageStream[driveId] != NULL) {
+        zipStreamClose(ramImageStream[driveId]);
+        ramImageStream[driveId] = NULL;
+    }
+
     if (ramImageBuffer[driveId] != NULL) {
         // Flush to file??
         free(ramImageBuffer[driveId]);
@@ -591,7 +821,13 @@ UInt8 diskChange(int driveId, const char* fileName, const char* fileInZipFile)
     }
 
     if (fileInZipFile != NULL) {
-        ramImageBuffer[driveId] = zipLoadFile(fileName, fileInZipFile, &ramImageSize[driveId]);
+        ramImageStream[driveId] = zipStreamOpen(fileName, fileInZipFile, &ramImageSize[driveId]);
+        if (ramImageStream[driveId] != NULL) {
+            ramImageBuffer[driveId] = malloc(ramImageSize[driveId] > 0 ? ramImageSize[driveId] : 1);
+        }
+        else {
+            ramImageBuffer[driveId] = zipLoadFile(fileName, fileInZipFile, &ramImageSize[driveId]);
+        }
         fileSize[driveId] = ramImageSize[driveId];
 
         fname = makeErrorsFileName(fileInZipFile);
@@ -611,6 +847,15 @@ UInt8 diskChange(int driveId, const char* fileName, const char* fileInZipFile)
         return ramImageBuffer[driveId] != NULL;
     }
 
+    // The name is kept for the positional writes to the image, a name
+    // that doesn't fit would send them to another file
+    if (strlen(fileName) >= sizeof(drivesFileName[driveId])) {
+        return 0;
+    }
+
+    // Pending writes from a previous insert of the image must be done first
+    fileWriterWait(fileName);
+
     drives[driveId] = fopen(fileName, "r+b");
     RdOnly[driveId] = 0;
 
@@ -646,6 +891,8 @@ UInt8 diskChange(int driveId, const char* fileName, const char* fileInZipFile)
     fseek(drives[driveId],0,SEEK_END);
     fileSize[driveId] = ftell(drives[driveId]);
 
+    strcpy(drivesFileName[driveId], fileName);
+    diskCacheCreate(driveId);
     diskUpdateInfo(driveId);
 
     return 1;
@@ -745,12 +992,14 @@ int _diskRead2(int driveId, UInt8* buffer, int sector, int numSectors)
 
     if (ramImageBuffer[driveId] == NULL) {
         if ((drives[driveId] != NULL)) {
-            if (0 == fseek(drives[driveId], sector * 512, SEEK_SET))
-                return (fread(buffer, 1, length, drives[driveId]) == length);
+            return diskCacheRead(driveId, buffer, sector * 512, length);
         }
         return 0;
     }
 
+    if (!ramImageFill(driveId, sector * 512 + length)) {
+        return 0;
+    }
     memcpy(buffer, ramImageBuffer[driveId] + sector * 512, numSectors * 512);
     return 1;
 }
@@ -765,13 +1014,15 @@ int _diskWrite2(int driveId, UInt8* buffer, int sector, int numSectors)
         return 0;
 
     if (ramImageBuffer[driveId] == NULL) {
-        if ((drives[driveId] != NULL)) {
-            if (0 == fseek(drives[driveId], sector * 512, SEEK_SET))
-                return (fwrite(buffer, 1, length, drives[driveId]) == length);
+        if (drives[driveId] != NULL && !RdOnly[driveId]) {
+            return diskCacheWrite(driveId, buffer, sector * 512, length);
         }
         return 0;
     }
 
+    if (!ramImageFill(driveId, sector * 512 + length)) {
+        return 0;
+    }
     memcpy(ramImageBuffer[driveId] + sector * 512, buffer, length);
     return 1;
 }
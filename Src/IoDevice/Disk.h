@@ -48,6 +48,7 @@ typedef enum {
 } DSKE;
 
 UInt8 diskChange(int driveId, const char* fileName, const char* fileInZipFile);
+void  diskFlush();
 void diskSetInfo(int driveId, char* fileName, const char* fileInZipFile);
 void  diskEnable(int driveId, int enable);
 UInt8 diskEnabled(int driveId);
@@ -99,6 +99,8 @@ static void loadState(MsxPPI* ppi)
     saveStateClose(state);
     
     i8255LoadState(ppi->i8255);
+    dacLoadState(ppi->dac);
+    audioKeyClickLoadState(ppi->keyClick);
 }
 
 static void saveState(MsxPPI* ppi)
@@ -112,6 +114,8 @@ static void saveState(MsxPPI* ppi)
     saveStateClose(state);
 
     i8255SaveState(ppi->i8255);
+    dacSaveState(ppi->dac);
+    audioKeyClickSaveState(ppi->keyClick);
 }
 
 static void writeA(MsxPPI* ppi, UInt8 value)
@@ -164,6 +164,8 @@ static void loadState(SviPPI* ppi)
     saveStateClose(state);
     
     i8255LoadState(ppi->i8255);
+    dacLoadState(ppi->dac);
+    audioKeyClickLoadState(ppi->keyClick);
 }
 
 static void saveState(SviPPI* ppi)
@@ -176,6 +178,8 @@ static void saveState(SviPPI* ppi)
     saveStateClose(state);
 
     i8255SaveState(ppi->i8255);
+    dacSaveState(ppi->dac);
+    audioKeyClickSaveState(ppi->keyClick);
 }
 
 static UInt8 readRow(SviPPI* ppi, UInt16 ioPort)
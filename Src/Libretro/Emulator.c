@@ -226,6 +226,7 @@ void emulatorStart(const char* stateName) {
     switchSetPause(properties->emulation.pauseSwitch);
 
     machine = machineCreate(properties->emulation.machineName);
+    machineCacheFlush();
 
     if (machine == NULL) {
         archShowStartEmuFailDialog();
@@ -333,6 +334,8 @@ int emulatorGetCurrentScreenMode()
 void emulatorRestart() {
     Machine* machine = machineCreate(properties->emulation.machineName);
 
+    machineCacheFlush();
+
     emulatorStop();
     if (machine != NULL) {
         boardSetMachine(machine);
@@ -1,16 +1,158 @@
+#include <stdlib.h>
+#include "ArchEvent.h"
+
+#ifdef HAVE_THREADS
+
+#include <pthread.h>
+#include <errno.h>
+#include <sys/time.h>
+
+// Events are auto reset, matching the Win32 version of blueMSX. A timeout
+// of zero or less waits forever.
+
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+    int             count;
+    int             max;
+} Sync;
+
+static Sync* syncCreate(int count, int max)
+{
+    Sync* s = (Sync*)calloc(1, sizeof(Sync));
+
+    pthread_mutex_init(&s->mutex, NULL);
+    pthread_cond_init(&s->cond, NULL);
+    s->count = count;
+    s->max   = max;
+
+    return s;
+}
+
+static void syncDestroy(Sync* s)
+{
+    if (s == NULL) {
+        return;
+    }
+    pthread_cond_destroy(&s->cond);
+    pthread_mutex_destroy(&s->mutex);
+    free(s);
+}
+
+static void syncSignal(Sync* s)
+{
+    pthread_mutex_lock(&s->mutex);
+    if (s->max == 0 || s->count < s->max) {
+        s->count++;
+    }
+    pthread_cond_signal(&s->cond);
+    pthread_mutex_unlock(&s->mutex);
+}
+
+static void syncWait(Sync* s, int timeout)
+{
+    pthread_mutex_lock(&s->mutex);
+    if (timeout <= 0) {
+        while (s->count == 0) {
+            pthread_cond_wait(&s->cond, &s->mutex);
+        }
+    }
+    else {
+        struct timeval  now;
+        struct timespec end;
+        int rv = 0;
+
+        gettimeofday(&now, NULL);
+        end.tv_sec  = now.tv_sec + timeout / 1000;
+        end.tv_nsec = now.tv_usec * 1000 + (timeout % 1000) * 1000000;
+        if (end.tv_nsec >= 1000000000) {
+            end.tv_sec++;
+            end.tv_nsec -= 1000000000;
+        }
+        while (s->count == 0 && rv != ETIMEDOUT) {
+            rv = pthread_cond_timedwait(&s->cond, &s->mutex, &end);
+        }
+    }
+    if (s->count > 0) {
+        s->count--;
+    }
+    pthread_mutex_unlock(&s->mutex);
+}
+
+void* archEventCreate(int initState)
+{
+    return syncCreate(initState ? 1 : 0, 1);
+}
+
+void archEventDestroy(void* event)
+{
+    syncDestroy((Sync*)event);
+}
+
+void archEventSet(void* event)
+{
+    syncSignal((Sync*)event);
+}
+
+void archEventWait(void* event, int timeout)
+{
+    syncWait((Sync*)event, timeout);
+}
 
 void* archSemaphoreCreate(int initCount)
 {
+    return syncCreate(initCount, 0);
 }
 
 void archSemaphoreDestroy(void* semaphore)
 {
+    syncDestroy((Sync*)semaphore);
 }
 
 void archSemaphoreSignal(void* semaphore)
 {
+    syncSignal((Sync*)semaphore);
 }
 
 void archSemaphoreWait(void* semaphore, int timeout)
 {
+    syncWait((Sync*)semaphore, timeout);
 }
+
+#else
+
+void* archEventCreate(int initState)
+{
+    return NULL;
+}
+
+void archEventDestroy(void* event)
+{
+}
+
+void archEventSet(void* event)
+{
+}
+
+void archEventWait(void* event, int timeout)
+{
+}
+
+void* archSemaphoreCreate(int initCount)
+{
+    return NULL;
+}
+
+void archSemaphoreDestroy(void* semaphore)
+{
+}
+
+void archSemaphoreSignal(void* semaphore)
+{
+}
+
+void archSemaphoreWait(void* semaphore, int timeout)
+{
+}
+
+#endif
@@ -157,6 +157,87 @@ int archFileDelete(const char* fileName)
 }
 #endif
 
+#if defined(_WIN32) && !defined(_XBOX)
+
+#include <windows.h>
+
+void* archFileMap(const char* fileName, int* size)
+{
+    HANDLE file;
+    HANDLE mapping;
+    void* data = NULL;
+    DWORD fileSize;
+
+    file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return NULL;
+    }
+
+    fileSize = GetFileSize(file, NULL);
+    if (fileSize != INVALID_FILE_SIZE && fileSize > 0) {
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping != NULL) {
+            data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping);
+        }
+    }
+    CloseHandle(file);
+
+    if (data != NULL) {
+        *size = (int)fileSize;
+    }
+    return data;
+}
+
+void archFileUnmap(void* data, int size)
+{
+    UnmapViewOfFile(data);
+}
+
+#elif (defined(__unix__) || defined(__APPLE__)) && !defined(__PS3__) && !defined(SF2000)
+
+#include <sys/mman.h>
+#include <fcntl.h>
+
+void* archFileMap(const char* fileName, int* size)
+{
+    struct stat s;
+    void* data;
+    int fd;
+
+    fd = open(fileName, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    if (fstat(fd, &s) != 0 || s.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+
+    data = mmap(NULL, s.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+
+    *size = (int)s.st_size;
+    return data;
+}
+
+void archFileUnmap(void* data, int size)
+{
+    munmap(data, size);
+}
+
+#else
+
+void* archFileMap(const char* fileName, int* size) { return NULL; }
+void archFileUnmap(void* data, int size) { }
+
+#endif
+
 /* File dialogs: */
 char* archFilenameGetOpenRom(Properties* properties, int cartSlot, RomType* romType) { return NULL; }
 char* archFilenameGetOpenDisk(Properties* properties, int drive, int allowCreate) { return NULL; }
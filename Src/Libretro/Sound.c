@@ -33,15 +33,23 @@
 static retro_audio_sample_batch_t audio_batch_cb = NULL;
 void retro_set_audio_sample_batch(retro_audio_sample_batch_t cb) { audio_batch_cb = cb; }
 
+static UInt32 framesWritten;
+
+// Returns the number of stereo frames written since the core was loaded
+UInt32 archSoundGetWrittenFrames(void) { return framesWritten; }
+
 static Int32 soundWrite(void* dummy, Int16 *buffer, UInt32 count)
 {
+   framesWritten += count / 2;
    if (audio_batch_cb)
       audio_batch_cb(buffer, count / 2);
 }
 
 void archSoundCreate(Mixer* mixer, UInt32 sampleRate, UInt32 bufferSize, Int16 channels) {
     mixerSetStereo(mixer, channels == 2);
-    mixerSetWriteCallback(mixer, soundWrite, NULL, 512);
+    // retro_run() flushes the mixer once per frame, the fragment size only
+    // bounds how much audio a single frame may buffer
+    mixerSetWriteCallback(mixer, soundWrite, NULL, AUDIO_STEREO_BUFFER_SIZE);
 }
 
 void archSoundDestroy(void) {}
@@ -0,0 +1,126 @@
+#include <stdlib.h>
+#include "ArchThread.h"
+
+#ifdef HAVE_THREADS
+
+#include <pthread.h>
+#include <unistd.h>
+
+typedef struct {
+    pthread_t thread;
+    void    (*entryPoint)();
+    void    (*entryPointArg)(void*);
+    void*     arg;
+    int       joined;
+} Thread;
+
+static void* threadEntry(void* arg)
+{
+    Thread* t = (Thread*)arg;
+    if (t->entryPointArg != NULL) {
+        t->entryPointArg(t->arg);
+    }
+    else {
+        t->entryPoint();
+    }
+    return NULL;
+}
+
+static void* threadStart(Thread* t, int stacksize)
+{
+    pthread_attr_t attr;
+    int rv;
+
+    pthread_attr_init(&attr);
+    if (stacksize > 0) {
+        pthread_attr_setstacksize(&attr, stacksize);
+    }
+    rv = pthread_create(&t->thread, &attr, threadEntry, t);
+    pthread_attr_destroy(&attr);
+
+    if (rv != 0) {
+        free(t);
+        return NULL;
+    }
+    return t;
+}
+
+void* archThreadCreateEx(void (*entryPoint)(), int priority, int stacksize)
+{
+    Thread* t = (Thread*)calloc(1, sizeof(Thread));
+
+    t->entryPoint = entryPoint;
+    return threadStart(t, stacksize);
+}
+
+void* archThreadCreate(void (*entryPoint)(), int priority)
+{
+    return archThreadCreateEx(entryPoint, priority, 0);
+}
+
+// Passes arg to the entry point, for threads that work on an object
+void* archThreadCreateArg(void (*entryPoint)(void*), void* arg, int priority)
+{
+    Thread* t = (Thread*)calloc(1, sizeof(Thread));
+
+    t->entryPointArg = entryPoint;
+    t->arg           = arg;
+    return threadStart(t, 0);
+}
+
+void archThreadJoin(void* thread, int timeout)
+{
+    Thread* t = (Thread*)thread;
+
+    // pthreads has no portable timed join, so this always waits
+    if (t != NULL && !t->joined) {
+        pthread_join(t->thread, NULL);
+        t->joined = 1;
+    }
+}
+
+// The thread must have been told to exit before it is destroyed
+void archThreadDestroy(void* thread)
+{
+    archThreadJoin(thread, -1);
+    free(thread);
+}
+
+void archThreadSleep(int milliseconds)
+{
+    usleep(milliseconds * 1000);
+}
+
+#else
+
+// Threads are not available on this platform. Callers must handle a NULL
+// thread and run the work inline instead.
+
+void* archThreadCreateEx(void (*entryPoint)(), int priority, int stacksize)
+{
+    return NULL;
+}
+
+void* archThreadCreate(void (*entryPoint)(), int priority)
+{
+    return NULL;
+}
+
+void* archThreadCreateArg(void (*entryPoint)(void*), void* arg, int priority)
+{
+    return NULL;
+}
+
+void archThreadJoin(void* thread, int timeout)
+{
+}
+
+void archThreadDestroy(void* thread)
+{
+}
+
+void archThreadSleep(int milliseconds)
+{
+}
+
+#endif
@@ -99,24 +99,84 @@ static UInt32 crc32Table[256] = {
 	0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d,
 };
 
-UInt32 calcCrc32(const void* buffer, int size) {
-    const UInt8* ptr = (const UInt8*)buffer;
-    UInt32 crc = 0xffffffff;
+#if defined(__ARM_FEATURE_CRC32)
 
-    while (size--) {
-    	crc = (crc >> 8) ^ crc32Table[*ptr++ ^ (crc & 0xff)];
+// ARMv8 has CRC32 instructions for the same polynomial
+#include <arm_acle.h>
+
+static UInt32 crc32Update(UInt32 crc, const UInt8* ptr, int size)
+{
+    while (size > 0 && ((size_t)ptr & 7)) {
+        crc = __crc32b(crc, *ptr++);
+        size--;
     }
+    while (size >= 8) {
+        crc = __crc32d(crc, *(const UInt64*)ptr);
+        ptr  += 8;
+        size -= 8;
+    }
+    while (size-- > 0) {
+        crc = __crc32b(crc, *ptr++);
+    }
+    return crc;
+}
 
-    return ~crc;
+#else
+
+// Slice-by-8 tables. crc32Slice[0] is crc32Table, crc32Slice[n] gives the
+// CRC of a byte followed by n zero bytes.
+static UInt32 crc32Slice[8][256];
+static int    crc32SliceInit = 0;
+
+static void crc32MakeSliceTables()
+{
+    int i;
+    int n;
+
+    for (i = 0; i < 256; i++) {
+        crc32Slice[0][i] = crc32Table[i];
+    }
+    for (n = 1; n < 8; n++) {
+        for (i = 0; i < 256; i++) {
+            UInt32 crc = crc32Slice[n - 1][i];
+            crc32Slice[n][i] = (crc >> 8) ^ crc32Table[crc & 0xff];
+        }
+    }
+    crc32SliceInit = 1;
 }
 
-UInt32 calcAddCrc32(const void* buffer, int size, UInt32 crc) {
-    const UInt8* ptr = (const UInt8*)buffer;
-    crc = ~crc;
+static UInt32 crc32Update(UInt32 crc, const UInt8* ptr, int size)
+{
+    if (!crc32SliceInit) {
+        crc32MakeSliceTables();
+    }
+
+    // Byte loads keep this independent of host byte order
+    while (size >= 8) {
+        UInt32 one = crc ^ ((UInt32)ptr[0] | (UInt32)ptr[1] << 8 | 
+                            (UInt32)ptr[2] << 16 | (UInt32)ptr[3] << 24);
+        UInt32 two = (UInt32)ptr[4] | (UInt32)ptr[5] << 8 | 
+                     (UInt32)ptr[6] << 16 | (UInt32)ptr[7] << 24;
 
-    while (size--) {
+        crc = crc32Slice[7][one & 0xff] ^ crc32Slice[6][(one >> 8) & 0xff] ^
+              crc32Slice[5][(one >> 16) & 0xff] ^ crc32Slice[4][one >> 24] ^
+              crc32Slice[3][two & 0xff] ^ crc32Slice[2][(two >> 8) & 0xff] ^
+              crc32Slice[1][(two >> 16) & 0xff] ^ crc32Slice[0][two >> 24];
+        ptr  += 8;
+        size -= 8;
+    }
+    while (size-- > 0) {
     	crc = (crc >> 8) ^ crc32Table[*ptr++ ^ (crc & 0xff)];
     }
+    return crc;
+}
 
-    return ~crc;
+#endif
+
+UInt32 calcCrc32(const void* buffer, int size) {
+    return ~crc32Update(0xffffffff, (const UInt8*)buffer, size);
+}
+
+UInt32 calcAddCrc32(const void* buffer, int size, UInt32 crc) {
+    return ~crc32Update(~crc, (const UInt8*)buffer, size);
 }
@@ -32,6 +32,7 @@ extern "C" {
 #include "TokenExtract.h"
 #include "StrcmpNoCase.h"
 #include "ArchGlob.h"
+#include "ArchFile.h"
 #include "Board.h"
 #include "Language.h"
 }
@@ -40,6 +41,11 @@ extern "C" {
 #include "Sha1.h"
 #include <string>
 #include <map>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
 
 using namespace std;
 
@@ -47,9 +53,27 @@ typedef map<UInt32, MediaType*> CrcMap;
 typedef map<string, MediaType*> Sha1Map;
 
 
+struct MediaDbSha1Key {
+    UInt8  sha1[20];
+    UInt32 record;
+};
+
+struct MediaDbCrcKey {
+    UInt32 crc;
+    UInt32 record;
+};
+
 struct MediaDb {
+    MediaDb() : sha1Keys(NULL), sha1Count(0), crcKeys(NULL), crcCount(0) {}
+
     Sha1Map sha1Map;
     CrcMap crcMap;
+
+    // Sorted indexes into the binary cache, see mediaDbLoadCache()
+    const MediaDbSha1Key* sha1Keys;
+    UInt32 sha1Count;
+    const MediaDbCrcKey* crcKeys;
+    UInt32 crcCount;
 };
 
 struct MediaType {
@@ -550,14 +574,447 @@ static void mediaDbAddFromXmlFile(const char* fileName)
     }
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Binary database cache
+//
+// Parsing the XML databases dominates startup on slow storage, so the parsed
+// result is stored in a cache file. The file holds the media records, a pool
+// of zero terminated strings and per database SHA1 and CRC32 keys sorted for
+// binary search. It is mapped at load and used in place. A stamp built from
+// the names, sizes and dates of the XML files detects a stale cache, in which
+// case the XML files are parsed and the cache is written again.
+
+#define MEDIADB_CACHE_MAGIC   0x42444d42 // "BMDB", also catches byte order
+#define MEDIADB_CACHE_VERSION 1
+#define MEDIADB_CACHE_DBS     3
+
+struct MediaDbCacheHeader {
+    UInt32 magic;
+    UInt32 version;
+    UInt32 stamp;
+    UInt32 size;
+    UInt32 recordCount;
+    UInt32 recordOffset;
+    UInt32 stringSize;
+    UInt32 stringOffset;
+    UInt32 sha1Count[MEDIADB_CACHE_DBS];
+    UInt32 sha1Offset[MEDIADB_CACHE_DBS];
+    UInt32 crcCount[MEDIADB_CACHE_DBS];
+    UInt32 crcOffset[MEDIADB_CACHE_DBS];
+};
+
+struct MediaDbCacheRecord {
+    UInt32 romType;
+    UInt32 title;
+    UInt32 company;
+    UInt32 year;
+    UInt32 country;
+    UInt32 remark;
+    UInt32 start;
+};
+
+static string    cacheFileName;
+static UInt8*    cacheData;
+static int       cacheSize;
+static int       cacheMapped;
+static UInt32    loadedStamp;
+static int       loadedFromDir;
+static string    loadedDir;
+static const MediaDbCacheRecord* cacheRecords;
+static UInt32    cacheRecordCount;
+static const char* cacheStrings;
+static vector<MediaType*> cacheTypes;
+
+static UInt32 fnv32(UInt32 hash, const void* data, size_t length)
+{
+    const UInt8* p = (const UInt8*)data;
+
+    while (length--) {
+        hash = (hash ^ *p++) * 16777619;
+    }
+    return hash;
+}
+
+static UInt32 mediaDbStamp(ArchGlob* glob)
+{
+    UInt32 stamp = fnv32(2166136261U, &glob->count, sizeof(glob->count));
+
+    for (int i = 0; i < glob->count; i++) {
+        const char* fileName = glob->pathVector[i];
+        const char* baseName = fileName + strlen(fileName);
+        struct stat s;
+        UInt32 info[2] = { 0, 0 };
+
+        while (baseName > fileName && baseName[-1] != '/' && baseName[-1] != '\\') {
+            baseName--;
+        }
+        if (stat(fileName, &s) == 0) {
+            info[0] = (UInt32)s.st_size;
+            info[1] = (UInt32)s.st_mtime;
+        }
+        stamp = fnv32(stamp, baseName, strlen(baseName));
+        stamp = fnv32(stamp, info, sizeof(info));
+    }
+
+    return stamp;
+}
+
+static void mediaDbFreeCache()
+{
+    for (size_t i = 0; i < cacheTypes.size(); i++) {
+        delete cacheTypes[i];
+    }
+    cacheTypes.clear();
+
+    MediaDb* dbs[MEDIADB_CACHE_DBS] = { romdb, diskdb, casdb };
+    for (int i = 0; i < MEDIADB_CACHE_DBS; i++) {
+        dbs[i]->sha1Keys  = NULL;
+        dbs[i]->sha1Count = 0;
+        dbs[i]->crcKeys   = NULL;
+        dbs[i]->crcCount  = 0;
+    }
+
+    if (cacheData != NULL) {
+        if (cacheMapped) {
+            archFileUnmap(cacheData, cacheSize);
+        }
+        else {
+            free(cacheData);
+        }
+    }
+    cacheData        = NULL;
+    cacheSize        = 0;
+    cacheRecords     = NULL;
+    cacheRecordCount = 0;
+    cacheStrings     = NULL;
+}
+
+static bool cacheRangeValid(UInt32 offset, UInt32 count, UInt32 itemSize)
+{
+    return offset % 4 == 0 && offset <= (UInt32)cacheSize &&
+           count <= ((UInt32)cacheSize - offset) / itemSize;
+}
+
+static bool mediaDbLoadCache(UInt32 stamp)
+{
+    const MediaDbCacheHeader* header;
+    MediaDb* dbs[MEDIADB_CACHE_DBS] = { romdb, diskdb, casdb };
+    int i;
+
+    cacheData   = (UInt8*)archFileMap(cacheFileName.c_str(), &cacheSize);
+    cacheMapped = cacheData != NULL;
+
+    if (cacheData == NULL) {
+        FILE* file = fopen(cacheFileName.c_str(), "rb");
+        if (file == NULL) {
+            return false;
+        }
+        fseek(file, 0, SEEK_END);
+        cacheSize = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        cacheData = cacheSize > 0 ? (UInt8*)malloc(cacheSize) : NULL;
+        if (cacheData != NULL && fread(cacheData, 1, cacheSize, file) != (size_t)cacheSize) {
+            free(cacheData);
+            cacheData = NULL;
+        }
+        fclose(file);
+        if (cacheData == NULL) {
+            cacheSize = 0;
+            return false;
+        }
+    }
+
+    header = (const MediaDbCacheHeader*)cacheData;
+
+    bool valid = cacheSize >= (int)sizeof(MediaDbCacheHeader) &&
+                 header->magic   == MEDIADB_CACHE_MAGIC &&
+                 header->version == MEDIADB_CACHE_VERSION &&
+                 header->stamp   == stamp &&
+                 header->size    == (UInt32)cacheSize &&
+                 cacheRangeValid(header->recordOffset, header->recordCount, sizeof(MediaDbCacheRecord)) &&
+                 cacheRangeValid(header->stringOffset, header->stringSize, 1) &&
+                 header->stringSize > 0 &&
+                 cacheData[header->stringOffset + header->stringSize - 1] == 0;
+
+    for (i = 0; valid && i < MEDIADB_CACHE_DBS; i++) {
+        valid = cacheRangeValid(header->sha1Offset[i], header->sha1Count[i], sizeof(MediaDbSha1Key)) &&
+                cacheRangeValid(header->crcOffset[i],  header->crcCount[i],  sizeof(MediaDbCrcKey));
+    }
+
+    if (!valid) {
+        mediaDbFreeCache();
+        return false;
+    }
+
+    cacheRecords     = (const MediaDbCacheRecord*)(cacheData + header->recordOffset);
+    cacheRecordCount = header->recordCount;
+    cacheStrings     = (const char*)cacheData + header->stringOffset;
+    cacheTypes.assign(cacheRecordCount, (MediaType*)NULL);
+
+    for (i = 0; i < MEDIADB_CACHE_DBS; i++) {
+        dbs[i]->sha1Keys  = (const MediaDbSha1Key*)(cacheData + header->sha1Offset[i]);
+        dbs[i]->sha1Count = header->sha1Count[i];
+        dbs[i]->crcKeys   = (const MediaDbCrcKey*)(cacheData + header->crcOffset[i]);
+        dbs[i]->crcCount  = header->crcCount[i];
+    }
+
+    return true;
+}
+
+static UInt32 cacheAddString(vector<char>& pool, map<string, UInt32>& strings, const string& str)
+{
+    map<string, UInt32>::iterator it = strings.find(str);
+    if (it != strings.end()) {
+        return it->second;
+    }
+
+    UInt32 offset = (UInt32)pool.size();
+    pool.insert(pool.end(), str.begin(), str.end());
+    pool.push_back(0);
+    strings[str] = offset;
+
+    return offset;
+}
+
+static UInt32 cacheAddRecord(vector<MediaDbCacheRecord>& records, map<string, UInt32>& recordMap,
+                             vector<char>& pool, map<string, UInt32>& strings, const MediaType* mt)
+{
+    MediaDbCacheRecord record;
+
+    record.romType = mt->romType;
+    record.title   = cacheAddString(pool, strings, mt->title);
+    record.company = cacheAddString(pool, strings, mt->company);
+    record.year    = cacheAddString(pool, strings, mt->year);
+    record.country = cacheAddString(pool, strings, mt->country);
+    record.remark  = cacheAddString(pool, strings, mt->remark);
+    record.start   = cacheAddString(pool, strings, mt->start);
+
+    // Every hash of a dump has its own copy of the media type
+    string key((const char*)&record, sizeof(record));
+    map<string, UInt32>::iterator it = recordMap.find(key);
+    if (it != recordMap.end()) {
+        return it->second;
+    }
+
+    UInt32 index = (UInt32)records.size();
+    records.push_back(record);
+    recordMap[key] = index;
+
+    return index;
+}
+
+static int hexValue(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+// Only lower case digests can match SHA1::hex_digest(), others are dropped
+static bool sha1FromHex(UInt8* sha1, const string& hex)
+{
+    if (hex.length() != 40) {
+        return false;
+    }
+    for (int i = 0; i < 20; i++) {
+        int hi = hexValue(hex[2 * i]);
+        int lo = hexValue(hex[2 * i + 1]);
+        if (hi < 0 || lo < 0) {
+            return false;
+        }
+        sha1[i] = (UInt8)(hi << 4 | lo);
+    }
+    return true;
+}
+
+static void mediaDbSaveCache(UInt32 stamp)
+{
+    MediaDb* dbs[MEDIADB_CACHE_DBS] = { romdb, diskdb, casdb };
+    vector<MediaDbSha1Key> sha1Keys[MEDIADB_CACHE_DBS];
+    vector<MediaDbCrcKey>  crcKeys[MEDIADB_CACHE_DBS];
+    vector<MediaDbCacheRecord> records;
+    map<string, UInt32> recordMap;
+    vector<char> pool;
+    map<string, UInt32> strings;
+    MediaDbCacheHeader header;
+    int i;
+
+    cacheAddString(pool, strings, "");
+
+    // The maps iterate in key order, which is the order binary search needs
+    for (i = 0; i < MEDIADB_CACHE_DBS; i++) {
+        for (Sha1Map::iterator it = dbs[i]->sha1Map.begin(); it != dbs[i]->sha1Map.end(); ++it) {
+            MediaDbSha1Key key;
+            if (sha1FromHex(key.sha1, it->first)) {
+                key.record = cacheAddRecord(records, recordMap, pool, strings, it->second);
+                sha1Keys[i].push_back(key);
+            }
+        }
+        for (CrcMap::iterator it = dbs[i]->crcMap.begin(); it != dbs[i]->crcMap.end(); ++it) {
+            MediaDbCrcKey key;
+            key.crc    = it->first;
+            key.record = cacheAddRecord(records, recordMap, pool, strings, it->second);
+            crcKeys[i].push_back(key);
+        }
+    }
+
+    while (pool.size() % 4) {
+        pool.push_back(0);
+    }
+
+    memset(&header, 0, sizeof(header));
+    header.magic        = MEDIADB_CACHE_MAGIC;
+    header.version      = MEDIADB_CACHE_VERSION;
+    header.stamp        = stamp;
+    header.recordCount  = (UInt32)records.size();
+    header.recordOffset = sizeof(header);
+    header.stringOffset = header.recordOffset + header.recordCount * sizeof(MediaDbCacheRecord);
+    header.stringSize   = (UInt32)pool.size();
+
+    UInt32 offset = header.stringOffset + header.stringSize;
+    for (i = 0; i < MEDIADB_CACHE_DBS; i++) {
+        header.sha1Count[i]  = (UInt32)sha1Keys[i].size();
+        header.sha1Offset[i] = offset;
+        offset += header.sha1Count[i] * sizeof(MediaDbSha1Key);
+        header.crcCount[i]   = (UInt32)crcKeys[i].size();
+        header.crcOffset[i]  = offset;
+        offset += header.crcCount[i] * sizeof(MediaDbCrcKey);
+    }
+    header.size = offset;
+
+    // Write to a temporary file first so a stale or partial cache is never
+    // picked up by a later load
+    string tmpName = cacheFileName + ".tmp";
+    FILE* file = fopen(tmpName.c_str(), "wb");
+    if (file == NULL) {
+        return;
+    }
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    if (ok && !records.empty()) {
+        ok = fwrite(&records[0], sizeof(MediaDbCacheRecord), records.size(), file) == records.size();
+    }
+    if (ok) {
+        ok = fwrite(&pool[0], 1, pool.size(), file) == pool.size();
+    }
+    for (i = 0; ok && i < MEDIADB_CACHE_DBS; i++) {
+        if (!sha1Keys[i].empty()) {
+            ok = fwrite(&sha1Keys[i][0], sizeof(MediaDbSha1Key), sha1Keys[i].size(), file) == sha1Keys[i].size();
+        }
+        if (ok && !crcKeys[i].empty()) {
+            ok = fwrite(&crcKeys[i][0], sizeof(MediaDbCrcKey), crcKeys[i].size(), file) == crcKeys[i].size();
+        }
+    }
+    if (fclose(file) != 0) {
+        ok = false;
+    }
+
+    if (ok) {
+        remove(cacheFileName.c_str());
+        ok = rename(tmpName.c_str(), cacheFileName.c_str()) == 0;
+    }
+    if (!ok) {
+        remove(tmpName.c_str());
+    }
+}
+
+static MediaType* mediaDbCacheType(UInt32 record)
+{
+    if (record >= cacheRecordCount) {
+        return NULL;
+    }
+
+    if (cacheTypes[record] == NULL) {
+        const MediaDbCacheRecord* r = cacheRecords + record;
+        cacheTypes[record] = new MediaType((RomType)r->romType, cacheStrings + r->title, 
+                                           cacheStrings + r->company, cacheStrings + r->year, 
+                                           cacheStrings + r->country, cacheStrings + r->remark, 
+                                           cacheStrings + r->start);
+    }
+    return cacheTypes[record];
+}
+
+static MediaType* mediaDbCacheLookupSha1(MediaDb* mediaDb, const string& digest)
+{
+    UInt8 sha1[20];
+    UInt32 lo = 0;
+    UInt32 hi = mediaDb->sha1Count;
+
+    if (mediaDb->sha1Keys == NULL || !sha1FromHex(sha1, digest)) {
+        return NULL;
+    }
+
+    while (lo < hi) {
+        UInt32 mid = (lo + hi) / 2;
+        int cmp = memcmp(mediaDb->sha1Keys[mid].sha1, sha1, sizeof(sha1));
+        if (cmp == 0) {
+            return mediaDbCacheType(mediaDb->sha1Keys[mid].record);
+        }
+        if (cmp < 0) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    return NULL;
+}
+
+static MediaType* mediaDbCacheLookupCrc(MediaDb* mediaDb, UInt32 crc)
+{
+    UInt32 lo = 0;
+    UInt32 hi = mediaDb->crcCount;
+
+    if (mediaDb->crcKeys == NULL) {
+        return NULL;
+    }
+
+    while (lo < hi) {
+        UInt32 mid = (lo + hi) / 2;
+        if (mediaDb->crcKeys[mid].crc == crc) {
+            return mediaDbCacheType(mediaDb->crcKeys[mid].record);
+        }
+        if (mediaDb->crcKeys[mid].crc < crc) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    return NULL;
+}
+
+// Computes SHA1 and CRC32 in a single pass. The buffer is walked in blocks
+// small enough to still be in the L1 cache when the second hash reads them.
+#define FINGERPRINT_BLOCK 4096
+
+static void mediaDbFingerprint(const void* buffer, int size, SHA1& sha1, UInt32& crc)
+{
+    const UInt8* data = (const UInt8*)buffer;
+
+    crc = 0;
+    while (size > 0) {
+        int length = size < FINGERPRINT_BLOCK ? size : FINGERPRINT_BLOCK;
+
+        sha1.update(data, length);
+        crc = calcAddCrc32(data, length, crc);
+
+        data += length;
+        size -= length;
+    }
+}
+
 extern MediaType* mediaDbLookup(MediaDb* mediaDb, const void *buffer, int size)
 {
+    MediaType* mediaType;
+    UInt32 crc;
+
     if (size > 2 * 1024 * 1024) {
         return NULL;
     }
 
 	SHA1 sha1;
-	sha1.update((const UInt8*)buffer, size);
+    mediaDbFingerprint(buffer, size, sha1, crc);
     
 //    printf("SHA1: %s\n", sha1.hex_digest().c_str());
 
@@ -566,14 +1023,17 @@ extern MediaType* mediaDbLookup(MediaDb* mediaDb, const void *buffer, int size)
         return iterSha1->second;
     }
 
-    UInt32 crc = calcCrc32(buffer, size);
+    mediaType = mediaDbCacheLookupSha1(mediaDb, sha1.hex_digest());
+    if (mediaType != NULL) {
+        return mediaType;
+    }
 
     CrcMap::iterator iterCrc = mediaDb->crcMap.find(crc);
     if (iterCrc != mediaDb->crcMap.end()) {
         return iterCrc->second;
     }
     
-    return NULL;
+    return mediaDbCacheLookupCrc(mediaDb, crc);
 }
 
 extern "C" const char* romTypeToString(RomType romType)
@@ -1085,12 +1545,38 @@ extern "C" void mediaDbLoad(const char* directory)
 
     ArchGlob* glob = archGlob(searchPath.c_str(), ARCH_GLOB_FILES);
 
-    if (glob != NULL) {
+    if (glob == NULL) {
+        return;
+    }
+
+    UInt32 stamp = mediaDbStamp(glob);
+
+    // Nothing changed since the databases were last loaded
+    if (loadedFromDir && loadedStamp == stamp && loadedDir == directory) {
+        archGlobFree(glob);
+        return;
+    }
+
+    mediaDbFreeCache();
+
+    if (cacheFileName.empty() || !mediaDbLoadCache(stamp)) {
         for (int i = 0; i < glob->count; i++) {
             mediaDbAddFromXmlFile(glob->pathVector[i]);
         }
-        archGlobFree(glob);
+        if (!cacheFileName.empty()) {
+            mediaDbSaveCache(stamp);
+        }
     }
+    archGlobFree(glob);
+
+    loadedFromDir = 1;
+    loadedStamp   = stamp;
+    loadedDir     = directory;
+}
+
+extern "C" void mediaDbSetCacheFile(const char* fileName)
+{
+    cacheFileName = fileName != NULL ? fileName : "";
 }
 
 extern "C" MediaType* mediaDbLookupRom(const void *buffer, int size) 
@@ -1296,54 +1782,57 @@ extern "C" MediaType* mediaDbGuessRom(const void *buffer, int size)
     
     const char ManbowTag[] = "Mapper: Manbow 2";
     UInt32 tagLength = strlen(ManbowTag);
-    for (i = 0; i < (int)(size - tagLength); i++) {
-        if (romData[i] == ManbowTag[0]) {
-            if (memcmp(romData + i, ManbowTag, tagLength) == 0) {
-                mediaType->romType = ROM_MANBOW2;
-			    return mediaType;
-            }
+    const UInt8* end = romData + size - tagLength;
+    const UInt8* ptr = romData;
+
+    // memchr is vectorized in most C libraries, so skip ahead with it
+    // rather than testing every byte
+    while (ptr < end && (ptr = (const UInt8*)memchr(ptr, ManbowTag[0], end - ptr)) != NULL) {
+        if (memcmp(ptr, ManbowTag, tagLength) == 0) {
+            mediaType->romType = ROM_MANBOW2;
+            return mediaType;
         }
+        ptr++;
     }
 
-    /* Count occurences of characteristic addresses */
-    for (i = 0; i < size - 3; i++) {
-        if (romData[i] == 0x32) {
-            UInt32 value = romData[i + 1] + ((UInt32)romData[i + 2] << 8);
-
-            switch(value) {
-            case 0x4000: 
-            case 0x8000: 
-            case 0xa000: 
-                counters[3]++;
-                break;
-
-            case 0x5000: 
-            case 0x9000: 
-            case 0xb000: 
-                counters[2]++;
-                break;
-
-            case 0x6000: 
-                counters[3]++;
-                counters[4]++;
-                counters[5]++;
-                break;
-
-            case 0x6800: 
-            case 0x7800: 
-                counters[4]++;
-                break;
-
-            case 0x7000: 
-                counters[2]++;
-                counters[4]++;
-                counters[5]++;
-                break;
-
-            case 0x77ff: 
-                counters[5]++;
-                break;
-            }
+    /* Count occurences of characteristic addresses (ld (nnnn),a) */
+    end = romData + size - 3;
+    for (ptr = romData; ptr < end && (ptr = (const UInt8*)memchr(ptr, 0x32, end - ptr)) != NULL; ptr++) {
+        UInt32 value = ptr[1] + ((UInt32)ptr[2] << 8);
+
+        switch(value) {
+        case 0x4000: 
+        case 0x8000: 
+        case 0xa000: 
+            counters[3]++;
+            break;
+
+        case 0x5000: 
+        case 0x9000: 
+        case 0xb000: 
+            counters[2]++;
+            break;
+
+        case 0x6000: 
+            counters[3]++;
+            counters[4]++;
+            counters[5]++;
+            break;
+
+        case 0x6800: 
+        case 0x7800: 
+            counters[4]++;
+            break;
+
+        case 0x7000: 
+            counters[2]++;
+            counters[4]++;
+            counters[5]++;
+            break;
+
+        case 0x77ff: 
+            counters[5]++;
+            break;
         }
     }
 
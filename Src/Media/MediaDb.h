@@ -215,6 +215,10 @@ MediaType* mediaDbLookup(MediaDb* mediaDb, const void *buffer, int size);
 
 void mediaDbLoad(const char* directory);
 
+// Caches the parsed databases in a binary file that mediaDbLoad() uses
+// instead of the XML files as long as these are unchanged
+void mediaDbSetCacheFile(const char* fileName);
+
 void mediaDbCreateRomdb();
 void mediaDbCreateDiskdb();
 void mediaDbCreateCasdb();
@@ -27,6 +27,7 @@
 */
 #include "IoPort.h"
 #include "Board.h"
+#include "PerfCounters.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -113,6 +114,8 @@ UInt8 ioPortRead(void* ref, UInt16 port)
 {
     port &= 0xff;
 
+    perfCounters.ioRead[port]++;
+
     if (boardGetType() == BOARD_MSX && port >= 0x40 && port < 0x50) {
         if (ioSubTable[currentSubport].read == NULL) {
             return 0xff;
@@ -138,6 +141,8 @@ void  ioPortWrite(void* ref, UInt16 port, UInt8 value)
 {
     port &= 0xff;
 
+    perfCounters.ioWrite[port]++;
+
     if (boardGetType() == BOARD_MSX && port >= 0x40 && port < 0x50) {
         if (port == 0x40) {
             currentSubport = value;
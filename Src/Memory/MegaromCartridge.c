@@ -338,7 +338,7 @@ int cartridgeInsert(int cartNo, RomType romType, const char* cart, const char* c
             buf = romLoad("Machines/Shared Roms/nowindDos2.rom", cartZip, &size);
         }
         else {
-            buf = romLoad(cart, cartZip, &size);
+            buf = romLoadShared(cart, cartZip, &size);
         }
         if (buf == NULL) {
             switch (romType) {
@@ -802,7 +802,7 @@ int cartridgeInsert(int cartNo, RomType romType, const char* cart, const char* c
             break;
         }
 
-        free(buf);
+        romRelease(buf);
     }
 
     return success;
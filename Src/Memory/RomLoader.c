@@ -27,9 +27,13 @@
 */
 #include "RomLoader.h"
 #include "ziphelper.h"
+#include "ArchFile.h"
+#include "ArchThread.h"
+#include "ArchEvent.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <sys/stat.h>
 
 #ifdef SF2000
 #include "Memory_SF2000.h"
@@ -82,3 +86,393 @@ error:
       fflush(stdout);
     return NULL;
 }
+
+// Number of unused memory mapped images kept around so they are reused
+// when a machine or cartridge is reloaded.
+#define ROM_BLOB_IDLE_MAX 4
+
+typedef struct RomBlob RomBlob;
+
+struct RomBlob {
+    RomBlob* next;
+    char     fileName[512];
+    char     fileInZipFile[512];
+    UInt8*   data;
+    int      size;
+    int      capacity;
+    int      mapped;
+    int      refCount;
+    time_t   mtime;
+};
+
+static RomBlob* romBlobs;
+
+static RomBlob* romBlobFind(const UInt8* data)
+{
+    RomBlob* blob;
+
+    for (blob = romBlobs; blob != NULL; blob = blob->next) {
+        if (blob->data == data) {
+            return blob;
+        }
+    }
+    return NULL;
+}
+
+static RomBlob* romBlobAdd(UInt8* data, int size, int capacity, int mapped)
+{
+    RomBlob* blob = (RomBlob*)calloc(1, sizeof(RomBlob));
+
+    blob->data     = data;
+    blob->size     = size;
+    blob->capacity = capacity;
+    blob->mapped   = mapped;
+    blob->refCount = 1;
+    blob->next     = romBlobs;
+    romBlobs       = blob;
+
+    return blob;
+}
+
+static void romBlobRemove(RomBlob* blob)
+{
+    RomBlob** link;
+
+    for (link = &romBlobs; *link != NULL; link = &(*link)->next) {
+        if (*link == blob) {
+            *link = blob->next;
+            break;
+        }
+    }
+
+    if (blob->mapped) {
+        archFileUnmap(blob->data, blob->size);
+    }
+    else {
+        free(blob->data);
+    }
+    free(blob);
+}
+
+static void romBlobTrimIdle()
+{
+    RomBlob* blob;
+    RomBlob* oldest = NULL;
+    int idle = 0;
+
+    for (blob = romBlobs; blob != NULL; blob = blob->next) {
+        if (blob->refCount == 0) {
+            oldest = blob;
+            idle++;
+        }
+    }
+    if (idle > ROM_BLOB_IDLE_MAX) {
+        romBlobRemove(oldest);
+    }
+}
+
+static time_t romFileTime(const char* fileName)
+{
+    struct stat s;
+
+    return stat(fileName, &s) == 0 ? s.st_mtime : 0;
+}
+
+// Allocates a zero filled buffer with a power of two capacity so the
+// common mappers can reference it without padding it themselves.
+static UInt8* romPaddedAlloc(int size, int* capacity)
+{
+    int cap = 0x8000;
+
+    while (cap < size) {
+        cap *= 2;
+    }
+
+    *capacity = cap;
+    return (UInt8*)calloc(1, cap);
+}
+
+static int romBlobNameFits(const char* fileName, const char* fileInZipFile)
+{
+    return strlen(fileName) < sizeof(romBlobs->fileName) &&
+           strlen(fileInZipFile) < sizeof(romBlobs->fileInZipFile);
+}
+
+static RomBlob* romBlobLookup(const char* fileName, const char* fileInZipFile)
+{
+    RomBlob* blob;
+
+    for (blob = romBlobs; blob != NULL; blob = blob->next) {
+        if (strcmp(blob->fileName, fileName) == 0 &&
+            strcmp(blob->fileInZipFile, fileInZipFile) == 0)
+        {
+            break;
+        }
+    }
+
+    // An unused image may be stale if the file was replaced
+    if (blob != NULL && blob->refCount == 0 && blob->mtime != romFileTime(fileName)) {
+        romBlobRemove(blob);
+        blob = NULL;
+    }
+    return blob;
+}
+
+static RomBlob* romBlobRegister(const char* fileName, const char* fileInZipFile,
+                                UInt8* data, int size, int capacity, int mapped)
+{
+    RomBlob* blob = romBlobAdd(data, size, capacity, mapped);
+
+    strcpy(blob->fileName, fileName);
+    strcpy(blob->fileInZipFile, fileInZipFile);
+    blob->mtime = romFileTime(fileName);
+
+    return blob;
+}
+
+UInt8* romLoadShared(const char *fileName, const char *fileInZipFile, int* size)
+{
+    RomBlob* blob;
+    UInt8* data;
+    int mapped = 0;
+    int capacity;
+
+    if (!fileName || strlen(fileName) == 0)
+        return NULL;
+
+    if (fileInZipFile == NULL)
+        fileInZipFile = "";
+
+    if (!romBlobNameFits(fileName, fileInZipFile))
+        return romLoad(fileName, fileInZipFile, size);
+
+    blob = romBlobLookup(fileName, fileInZipFile);
+    if (blob != NULL) {
+        blob->refCount++;
+        *size = blob->size;
+        return blob->data;
+    }
+
+    data = NULL;
+#ifndef USE_PACKET_FS
+    if (fileInZipFile[0] == 0) {
+        data = (UInt8*)archFileMap(fileName, size);
+        mapped = data != NULL;
+        capacity = *size;
+    }
+#endif
+    if (data == NULL) {
+        UInt8* buf = romLoad(fileName, fileInZipFile, size);
+        if (buf == NULL) {
+            return NULL;
+        }
+        data = romPaddedAlloc(*size, &capacity);
+        memcpy(data, buf, *size);
+        free(buf);
+    }
+
+    romBlobRegister(fileName, fileInZipFile, data, *size, capacity, mapped);
+
+    return data;
+}
+
+UInt8* romRetain(const UInt8* romData, int size, int capacity)
+{
+    RomBlob* blob = romBlobFind(romData);
+    UInt8* data;
+
+    if (blob != NULL && blob->size == size && blob->capacity >= capacity) {
+        blob->refCount++;
+        return blob->data;
+    }
+
+    if (capacity < size) {
+        capacity = size;
+    }
+    data = (UInt8*)calloc(1, capacity);
+    memcpy(data, romData, size);
+
+    return data;
+}
+
+void romRelease(UInt8* romData)
+{
+    RomBlob* blob;
+
+    if (romData == NULL) {
+        return;
+    }
+
+    blob = romBlobFind(romData);
+    if (blob == NULL) {
+        free(romData);
+        return;
+    }
+
+    if (--blob->refCount > 0) {
+        return;
+    }
+
+    if (blob->mapped) {
+        romBlobTrimIdle();
+    }
+    else {
+        romBlobRemove(blob);
+    }
+}
+
+// Preloading reads a set of images into the shared cache on worker threads.
+// Zipped images are inflated by the workers and mapped files are paged in
+// by touching every page. Everything that touches the cache itself is done
+// by the calling thread.
+
+#define ROM_PRELOAD_MAX     64
+#define ROM_PRELOAD_THREADS 4
+
+typedef struct {
+    RomBlob*   blob;
+    ZipStream* stream;
+    int        failed;
+} RomPreloadJob;
+
+static RomPreloadJob preloadJobs[ROM_PRELOAD_MAX];
+static int   preloadCount;
+static int   preloadNext;
+static void* preloadLock;
+static volatile UInt8 preloadSink;
+
+static void romPreloadRun(RomPreloadJob* job)
+{
+    if (job->stream != NULL) {
+        if (zipStreamFill(job->stream, job->blob->data, job->blob->size) < job->blob->size) {
+            job->failed = 1;
+        }
+        zipStreamClose(job->stream);
+        job->stream = NULL;
+    }
+    else if (job->blob->mapped) {
+        const UInt8* data = job->blob->data;
+        UInt8 sum = 0;
+        int i;
+
+        for (i = 0; i < job->blob->size; i += 0x1000) {
+            sum += data[i];
+        }
+        preloadSink = sum;
+    }
+}
+
+static void romPreloadWorker()
+{
+    for (;;) {
+        RomPreloadJob* job = NULL;
+
+        archSemaphoreWait(preloadLock, -1);
+        if (preloadNext < preloadCount) {
+            job = preloadJobs + preloadNext++;
+        }
+        archSemaphoreSignal(preloadLock);
+
+        if (job == NULL) {
+            return;
+        }
+        romPreloadRun(job);
+    }
+}
+
+void romPreload(const char** fileNames, const char** fileInZipFiles, int count)
+{
+    void* threads[ROM_PRELOAD_THREADS];
+    int threadCount = 0;
+    int kept;
+    int i;
+
+    romPreloadRelease();
+
+    for (i = 0; i < count && preloadCount < ROM_PRELOAD_MAX; i++) {
+        const char* fileName = fileNames[i];
+        const char* fileInZipFile = fileInZipFiles[i] != NULL ? fileInZipFiles[i] : "";
+        ZipStream* stream = NULL;
+        RomBlob* blob;
+        UInt8* data = NULL;
+        int capacity;
+        int size;
+
+        if (fileName == NULL || fileName[0] == 0 || !romBlobNameFits(fileName, fileInZipFile)) {
+            continue;
+        }
+
+        blob = romBlobLookup(fileName, fileInZipFile);
+        if (blob != NULL) {
+            blob->refCount++;
+        }
+        else if (fileInZipFile[0] != 0) {
+            stream = zipStreamOpen(fileName, fileInZipFile, &size);
+            if (stream == NULL) {
+                continue;
+            }
+            data = romPaddedAlloc(size, &capacity);
+            blob = romBlobRegister(fileName, fileInZipFile, data, size, capacity, 0);
+        }
+        else {
+#ifndef USE_PACKET_FS
+            data = (UInt8*)archFileMap(fileName, &size);
+#endif
+            // Images that can't be mapped are loaded when they are used
+            if (data == NULL) {
+                continue;
+            }
+            blob = romBlobRegister(fileName, fileInZipFile, data, size, size, 1);
+        }
+
+        preloadJobs[preloadCount].blob   = blob;
+        preloadJobs[preloadCount].stream = stream;
+        preloadJobs[preloadCount].failed = 0;
+        preloadCount++;
+    }
+
+    preloadNext = 0;
+    preloadLock = archSemaphoreCreate(1);
+
+    while (threadCount < ROM_PRELOAD_THREADS && threadCount < preloadCount - 1) {
+        threads[threadCount] = archThreadCreate(romPreloadWorker, THREAD_PRIO_NORMAL);
+        if (threads[threadCount] == NULL) {
+            break;
+        }
+        threadCount++;
+    }
+
+    // The calling thread takes jobs too, so without threads this simply
+    // loads everything in sequence
+    romPreloadWorker();
+
+    for (i = 0; i < threadCount; i++) {
+        archThreadDestroy(threads[i]);
+    }
+
+    archSemaphoreDestroy(preloadLock);
+    preloadLock = NULL;
+
+    // Images that failed to inflate are dropped from the cache so they
+    // are loaded again the normal way when they are used
+    kept = 0;
+    for (i = 0; i < preloadCount; i++) {
+        if (preloadJobs[i].failed) {
+            romRelease(preloadJobs[i].blob->data);
+        }
+        else {
+            preloadJobs[kept++] = preloadJobs[i];
+        }
+    }
+    preloadCount = kept;
+}
+
+void romPreloadRelease()
+{
+    int i;
+
+    for (i = 0; i < preloadCount; i++) {
+        romRelease(preloadJobs[i].blob->data);
+    }
+    preloadCount = 0;
+}
@@ -32,4 +32,21 @@
 
 UInt8* romLoad(const char *fileName, const char *fileInZipFile, int* size);
 
+// Shared, read only ROM images. romLoadShared returns a reference counted
+// image that is memory mapped when loaded from a plain file. Mappers call
+// romRetain to reference an image instead of copying it. The returned
+// buffer is at least capacity bytes with zeros after the first size bytes.
+// A copy is made if romData is not a shared image or if it is too small.
+// romRelease drops a reference from either function and frees buffers
+// that were not shared.
+UInt8* romLoadShared(const char *fileName, const char *fileInZipFile, int* size);
+UInt8* romRetain(const UInt8* romData, int size, int capacity);
+void romRelease(UInt8* romData);
+
+// Reads a set of ROM images into the shared image cache, concurrently when
+// threads are available. The images are referenced until romPreloadRelease
+// so the romLoadShared calls in between find them in the cache.
+void romPreload(const char** fileNames, const char** fileInZipFiles, int count);
+void romPreloadRelease();
+
 #endif
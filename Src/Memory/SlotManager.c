@@ -29,6 +29,7 @@
 #include "SaveState.h"
 #include "Led.h"
 #include "IoPort.h"
+#include "PerfCounters.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -70,6 +71,28 @@ static Slot             slotTable[4][4][8];
 static Slot             slotAddr0;
 static UInt8            emptyRAM[0x2000];
 static Int32            initialized;
+static UInt16           slotMapping;
+
+// Packs the selected slot of each page into a word, four bits per page
+// with the primary slot in the low bits and the subslot in the high bits
+static void slotUpdateMapping()
+{
+    UInt16 mapping = 0;
+    int page;
+
+    for (page = 0; page < 4; page++) {
+        int psl = pslot[page].state;
+        int ssl = pslot[psl].subslotted ? pslot[page].substate : 0;
+
+        mapping |= (psl | (ssl << 2)) << (4 * page);
+    }
+    slotMapping = mapping;
+}
+
+const UInt16* slotGetMappingRef()
+{
+    return &slotMapping;
+}
 
 void slotMapRamPage(int slot, int sslot, int page)
 {
@@ -82,6 +105,10 @@ void slotSetRamSlot(int slot, int psl)
 {
     int ssl;
 
+    if (pslot[slot].state != psl) {
+        perfCounters.primarySlotSwitches++;
+    }
+
     pslot[slot].state    = psl;
     pslot[slot].substate = (pslot[psl].sslReg >> (slot * 2)) & 3;
 
@@ -89,6 +116,8 @@ void slotSetRamSlot(int slot, int psl)
     
     slotMapRamPage(psl, ssl, 2 * slot);
     slotMapRamPage(psl, ssl, 2 * slot + 1);
+
+    slotUpdateMapping();
 }
 
 int slotGetRamSlot(int page)
@@ -109,6 +138,8 @@ void slotMapPage(int slot, int sslot, int page, UInt8* pageData,
         return;
     }
 
+    perfCounters.pageMaps[slot][sslot]++;
+
     slotTable[slot][sslot][page].readEnable  = readEnable;
     slotTable[slot][sslot][page].writeEnable = writeEnable;
 
@@ -249,6 +280,8 @@ void slotSetSubslotted(int slot, int subslotted)
     }
 
     pslot[slot].subslotted = subslotted;
+
+    slotUpdateMapping();
 }
 
 void slotManagerReset() 
@@ -266,6 +299,8 @@ void slotManagerReset()
         slotMapRamPage(0, 0, 2 * page);
         slotMapRamPage(0, 0, 2 * page + 1);
     }
+
+    slotUpdateMapping();
 }
 
 void slotManagerCreate()
@@ -284,6 +319,7 @@ void slotManagerCreate()
     memset(pslot, 0, sizeof(pslot));
     memset(slotTable, 0, sizeof(slotTable));
     memset(&slotAddr0, 0, sizeof(slotAddr0));
+    slotMapping = 0;
 
     for (slot = 0; slot < 4; slot++) {
         for (sslot = 0; sslot < 4; sslot++) {
@@ -385,6 +421,9 @@ void slotWrite(void* ref, UInt16 address, UInt8 value)
 
         if (pslot[pslReg].subslotted) {
 //            printf("SW: %d %d %d %d\n", (value>>0)&3, (value>>2)&3, (value>>4)&3, (value>>6)&3);
+            if (pslot[pslReg].sslReg != value) {
+                perfCounters.secondarySlotSwitches++;
+            }
             pslot[pslReg].sslReg = value;
 
             for (page = 0; page < 4; page++) {
@@ -396,6 +435,7 @@ void slotWrite(void* ref, UInt16 address, UInt8 value)
                 value >>= 2;
             }
 
+            slotUpdateMapping();
             return;
         }
     }
@@ -488,4 +528,6 @@ void slotLoadState()
         slotMapRamPage(psl, ssl, 2 * page);
         slotMapRamPage(psl, ssl, 2 * page + 1);
     }
+
+    slotUpdateMapping();
 }
@@ -69,4 +69,9 @@ void slotUpdatePage(int slot, int sslot, int page, UInt8* pageData,
 
 void slotSetSubslotted(int slot, int subslotted);
 
+// Returns a pointer to the current slot selection of the four pages,
+// four bits per page (primary slot in bits 0-1, subslot in bits 2-3).
+// The value is kept up to date on every slot switch.
+const UInt16* slotGetMappingRef();
+
 #endif
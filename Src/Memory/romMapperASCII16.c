@@ -30,6 +30,7 @@
 #include "SlotManager.h"
 #include "DeviceManager.h"
 #include "SaveState.h"
+#include "RomLoader.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -50,7 +51,7 @@ static void destroy(RomMapperASCII16* rm)
     slotUnregister(rm->slot, rm->sslot, rm->startPage);
     deviceManagerUnregister(rm->deviceHandle);
 
-    free(rm->romData);
+    romRelease(rm->romData);
     free(rm);
 }
 
@@ -132,8 +133,7 @@ int romMapperASCII16Create(const char* filename, UInt8* romData,
 
     size = (size + 0x3fff) & ~0x3fff;
 
-    rm->romData = calloc(1, size);
-    memcpy(rm->romData, romData, origSize);
+    rm->romData = romRetain(romData, origSize, size);
     rm->romMask = size / 0x4000 - 1;
     rm->slot  = slot;
     rm->sslot = sslot;
@@ -30,6 +30,7 @@
 #include "SlotManager.h"
 #include "DeviceManager.h"
 #include "SaveState.h"
+#include "RomLoader.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -82,7 +83,7 @@ static void destroy(RomMapperASCII8* rm)
     slotUnregister(rm->slot, rm->sslot, rm->startPage);
     deviceManagerUnregister(rm->deviceHandle);
 
-    free(rm->romData);
+    romRelease(rm->romData);
     free(rm);
 }
 
@@ -127,8 +128,7 @@ int romMapperASCII8Create(const char* filename, UInt8* romData,
     rm->deviceHandle = deviceManagerRegister(ROM_ASCII8, &callbacks, rm);
     slotRegister(slot, sslot, startPage, 4, NULL, NULL, write, destroy, rm);
 
-    rm->romData = calloc(1, size);
-    memcpy(rm->romData, romData, origSize);
+    rm->romData = romRetain(romData, origSize, size);
     rm->romMask = size / 0x2000 - 1;
     rm->slot  = slot;
     rm->sslot = sslot;
@@ -30,6 +30,7 @@
 #include "SlotManager.h"
 #include "DeviceManager.h"
 #include "SaveState.h"
+#include "RomLoader.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -82,7 +83,7 @@ static void destroy(RomMapperKonami4* rm)
     slotUnregister(rm->slot, rm->sslot, rm->startPage);
     deviceManagerUnregister(rm->deviceHandle);
 
-    free(rm->romData);
+    romRelease(rm->romData);
     free(rm);
 }
 
@@ -127,12 +128,14 @@ int romMapperKonami4Create(const char* filename, UInt8* romData,
     slotRegister(slot, sslot, startPage, 4, NULL, NULL, write, destroy, rm);
 
     romSize = size > 0x40000 ? size : 0x40000;
-    rm->romData = malloc(romSize);
-    memcpy(rm->romData, romData, size);
-
     if (size < 0x40000) {
+        rm->romData = malloc(romSize);
+        memcpy(rm->romData, romData, size);
         memset(rm->romData + size, 0xff, 0x40000 - size);
     }
+    else {
+        rm->romData = romRetain(romData, size, size);
+    }
 
     rm->size = romSize;
     rm->slot  = slot;
@@ -32,6 +32,7 @@
 #include "SCC.h"
 #include "Board.h"
 #include "SaveState.h"
+#include "RomLoader.h"
 #include <stdlib.h>
 #include <string.h>
 
@@ -101,7 +102,7 @@ static void destroy(RomMapperKonami5* rm)
     deviceManagerUnregister(rm->deviceHandle);
     sccDestroy(rm->scc);
 
-    free(rm->romData);
+    romRelease(rm->romData);
     free(rm);
 }
 
@@ -193,8 +194,7 @@ int romMapperKonami5Create(const char* filename, UInt8* romData,
     rm->deviceHandle = deviceManagerRegister(ROM_KONAMI5, &callbacks, rm);
     slotRegister(slot, sslot, startPage, 4, read, peek, write, destroy, rm);
 
-    rm->romData = calloc(1, size);
-    memcpy(rm->romData, romData, origSize);
+    rm->romData = romRetain(romData, origSize, size);
     rm->romMask = size / 0x2000 - 1;
     rm->slot  = slot;
     rm->sslot = sslot;
@@ -35,6 +35,7 @@
 #include "Board.h"
 #include "SaveState.h"
 #include "Language.h"
+#include "RomLoader.h"
 #include <stdlib.h>
 #include <string.h>
 
@@ -42,6 +43,7 @@ typedef struct {
     int      deviceHandle;
     int      debugHandle;
     Moonsound* moonsound;
+    UInt8*   romData;
 } RomMapperMoonsound;
 
 static void destroy(RomMapperMoonsound* rm)
@@ -57,6 +59,8 @@ static void destroy(RomMapperMoonsound* rm)
         moonsoundDestroy(rm->moonsound);
     }
 
+    romRelease(rm->romData);
+
     deviceManagerUnregister(rm->deviceHandle);
     debugDeviceUnregister(rm->debugHandle);
 
@@ -126,7 +130,7 @@ static void getDebugInfo(RomMapperMoonsound* rm, DbgDevice* dbgDevice)
     dbgIoPortsAddPort(ioPorts, 5, 0xc7, DBG_IO_READWRITE, peek(rm, 0xc7));
 }
 
-int romMapperMoonsoundCreate(const char* filename, UInt8* romData, int size, int sramSize)
+static int create(UInt8* romData, int size, int sramSize)
 {
     DeviceCallbacks callbacks = { destroy, reset, saveState, loadState };
     DebugCallbacks dbgCallbacks = { getDebugInfo, NULL, NULL, NULL };
@@ -136,8 +140,9 @@ int romMapperMoonsoundCreate(const char* filename, UInt8* romData, int size, int
     rm->debugHandle = debugDeviceRegister(DBGTYPE_AUDIO, langDbgDevMoonsound(), &dbgCallbacks, rm);
     
     rm->moonsound = NULL;
+    rm->romData   = romData;
 
-    if (boardGetMoonsoundEnable()) {
+    if (rm->romData != NULL) {
         rm->moonsound = moonsoundCreate(boardGetMixer(), romData, size, sramSize);
         ioPortRegister(0x7e, read, write, rm);
         ioPortRegister(0x7f, read, write, rm);
@@ -146,13 +151,34 @@ int romMapperMoonsoundCreate(const char* filename, UInt8* romData, int size, int
         ioPortRegister(0xc6, read, write, rm);
         ioPortRegister(0xc7, read, write, rm);
     }
-    else {
-        // moonsound emulation has ownership of rom data. Need to
-        // free it if its not being used.
-        free(romData);
-    }
 
     reset(rm);
 
     return 1;
 }
+
+int romMapperMoonsoundCreate(const char* filename, UInt8* romData, int size, int sramSize)
+{
+    if (!boardGetMoonsoundEnable()) {
+        // The mapper has ownership of rom data. Need to
+        // free it if its not being used.
+        romRelease(romData);
+        romData = NULL;
+    }
+    return create(romData, size, sramSize);
+}
+
+int romMapperMoonsoundCreateShared(const char* filename, const char* fileInZipFile, int sramSize)
+{
+    UInt8* romData = NULL;
+    int size = 0;
+
+    // The wave ROM is only loaded when the Moonsound is enabled
+    if (boardGetMoonsoundEnable()) {
+        romData = romLoadShared(filename, fileInZipFile, &size);
+        if (romData == NULL) {
+            return 0;
+        }
+    }
+    return create(romData, size, sramSize);
+}
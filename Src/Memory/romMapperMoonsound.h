@@ -31,5 +31,6 @@
 #include "MsxTypes.h"
 
 int romMapperMoonsoundCreate(const char* filename, UInt8* romData, int size, int sramSize);
+int romMapperMoonsoundCreateShared(const char* filename, const char* fileInZipFile, int sramSize);
 
 #endif
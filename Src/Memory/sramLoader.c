@@ -27,6 +27,7 @@
 */
 #include "sramLoader.h"
 #include "Board.h"
+#include "FileWriter.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -80,6 +81,9 @@ const char* sramCreateFilename(const char* romFilename) {
 void sramLoad(const char* filename, UInt8* sram, int length, void* header, int headerLength) {
     FILE* file;
 
+    // The file may still be written by an earlier save
+    fileWriterWait(filename);
+
     file = fopen(filename, "rb");
     if (file != NULL) {
         if (headerLength > 0) {
@@ -97,15 +101,6 @@ void sramLoad(const char* filename, UInt8* sram, int length, void* header, int h
 }
 
 void sramSave(const char* filename, UInt8* sram, int length, void* header, int headerLength) {
-    FILE* file;
-
-    file = fopen(filename, "wb");
-    if (file != NULL) {
-        if (headerLength > 0) {
-            fwrite(header, 1, headerLength, file);
-        }
-        fwrite(sram, 1, length, file);
-        fclose(file);
-    }
+    fileWriterSave(filename, header, headerLength, sram, length);
 }
 
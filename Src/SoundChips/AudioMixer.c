@@ -26,9 +26,13 @@
 ******************************************************************************
 */
 #include "AudioMixer.h"
+#include "AudioResampler.h"
 #include "Board.h"
 #include "ArchTimer.h"
 #include "ArchMidi.h"
+#include "ArchThread.h"
+#include "ArchEvent.h"
+#include "SaveState.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
@@ -41,6 +45,10 @@
 
 #define str2ul(s) ((UInt32)s[0]<<0|(UInt32)s[1]<<8|(UInt32)s[2]<<16|(UInt32)s[3]<<24)
 
+// Syncs shorter than this are rendered inline since waking the workers
+// costs more than the rendering itself
+#define MIXER_THREAD_MIN_SAMPLES 64
+
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
 
@@ -95,6 +103,8 @@ typedef struct {
     MixerSetSampleRateCallback rateCallback;
     void* ref;
     MixerAudioType type;
+    UInt32 nativeRate;
+    AudioResampler* resampler;
     // User config
     Int32 volume;
     Int32 pan;
@@ -129,6 +139,7 @@ struct Mixer
     UInt32  oldTick;
     Int32   stereo;
     UInt32  rate;
+    MixerResampleMode resampleMode;
     DoubleT  masterVolume;
     Int32   masterEnable;
     Int32   volIntLeft;
@@ -137,11 +148,25 @@ struct Mixer
     Int32   volCntRight;
     FILE*   file;
     int     enable;
+    // Worker threads
+    void*   threads[MIXER_MAX_THREADS];
+    Int32   threadCount;
+    void*   jobStart;
+    void*   jobDone;
+    void*   jobLock;
+    volatile Int32 jobQuit;
+    Int32   jobNext;
+    Int32   jobCount;
+    Int32   jobList[MAX_CHANNELS];
+    UInt32  jobSamples;
+    Int32*  jobBuff[MAX_CHANNELS];
 };
 
 
 static void recalculateChannelVolume(Mixer* mixer, MixerChannel* channel);
 static void updateVolumes(Mixer* mixer);
+static void updateChannelResampler(Mixer* mixer, MixerChannel* channel);
+static void updateChannelRate(Mixer* mixer, MixerChannel* channel);
 
 ///////////////////////////////////////////////////////
 
@@ -324,6 +349,11 @@ Mixer* mixerCreate(void)
     mixer->fragmentSize = 512;
     mixer->enable       = 1;
     mixer->rate         = AUDIO_SAMPLERATE;
+#ifdef SF2000
+    mixer->resampleMode = MIXER_RESAMPLE_LINEAR;
+#else
+    mixer->resampleMode = MIXER_RESAMPLE_SINC;
+#endif
 
 // Temporarily disable SF2000 audio optimizations to fix exception 4
 //#ifdef SF2000
@@ -338,6 +368,17 @@ Mixer* mixerCreate(void)
 
 void mixerDestroy(Mixer* mixer)
 {
+    int i;
+
+    // Joins the workers and clears their handles
+    mixerSetThreadCount(mixer, 0);
+
+    for (i = 0; i < mixer->channelCount; i++) {
+        if (mixer->channels[i].resampler != NULL) {
+            audioResamplerDestroy(mixer->channels[i].resampler);
+        }
+    }
+
     globalMixer = NULL;
     free(mixer);
 }
@@ -352,12 +393,242 @@ void mixerSetSampleRate(Mixer* mixer, UInt32 rate)
     int i;
     mixer->rate = rate;
     for(i = 0; i < mixer->channelCount; i++) {
-        if (mixer->channels[i].rateCallback != NULL) {
-            mixer->channels[i].rateCallback(mixer->channels[i].ref, rate);
+        updateChannelRate(mixer, mixer->channels + i);
+    }
+}
+
+void mixerSetResampleMode(Mixer* mixer, MixerResampleMode mode)
+{
+    int i;
+    mixer->resampleMode = mode;
+    for(i = 0; i < mixer->channelCount; i++) {
+        updateChannelRate(mixer, mixer->channels + i);
+    }
+}
+
+MixerResampleMode mixerGetResampleMode(Mixer* mixer)
+{
+    return mixer->resampleMode;
+}
+
+static MixerChannel* findChannel(Mixer* mixer, Int32 handle)
+{
+    int i;
+
+    for (i = 0; i < mixer->channelCount; i++) {
+        if (mixer->channels[i].handle == handle) {
+            return mixer->channels + i;
+        }
+    }
+    return NULL;
+}
+
+static UInt32 channelSampleRate(Mixer* mixer, MixerChannel* channel)
+{
+    if (mixer->resampleMode == MIXER_RESAMPLE_NONE) {
+        return mixer->rate;
+    }
+    return channel->nativeRate;
+}
+
+// Creates, reconfigures or drops the channel resampler
+static void updateChannelResampler(Mixer* mixer, MixerChannel* channel)
+{
+    UInt32 rate = channelSampleRate(mixer, channel);
+
+    if (rate != mixer->rate) {
+        if (channel->resampler == NULL) {
+            channel->resampler = audioResamplerCreate(channel->stereo);
         }
+        audioResamplerSetRates(channel->resampler, rate, mixer->rate, mixer->resampleMode);
+    }
+    else if (channel->resampler != NULL) {
+        audioResamplerDestroy(channel->resampler);
+        channel->resampler = NULL;
     }
 }
 
+static void updateChannelRate(Mixer* mixer, MixerChannel* channel)
+{
+    updateChannelResampler(mixer, channel);
+
+    if (channel->rateCallback != NULL) {
+        channel->rateCallback(channel->ref, channelSampleRate(mixer, channel));
+    }
+}
+
+void mixerSetChannelNativeRate(Mixer* mixer, Int32 handle, UInt32 nativeRate)
+{
+    MixerChannel* channel = findChannel(mixer, handle);
+
+    if (channel == NULL || channel->nativeRate == nativeRate) {
+        return;
+    }
+    channel->nativeRate = nativeRate;
+    updateChannelResampler(mixer, channel);
+}
+
+UInt32 mixerGetChannelSampleRate(Mixer* mixer, Int32 handle)
+{
+    MixerChannel* channel = findChannel(mixer, handle);
+
+    if (channel == NULL) {
+        return mixer->rate;
+    }
+    return channelSampleRate(mixer, channel);
+}
+
+Int32 mixerGetChannelOversampling(Mixer* mixer, Int32 handle, Int32 oversampling)
+{
+    if (findChannel(mixer, handle) == NULL || mixer->resampleMode == MIXER_RESAMPLE_NONE) {
+        return oversampling;
+    }
+    return 1;
+}
+
+static Int32* channelUpdate(MixerChannel* channel, UInt32 count)
+{
+    if (channel->resampler != NULL) {
+        return audioResamplerProcess(channel->resampler, channel->updateCallback,
+                                     channel->ref, count);
+    }
+    if (channel->updateCallback != NULL) {
+        return channel->updateCallback(channel->ref, count);
+    }
+    return NULL;
+}
+
+// Runs queued jobs until the queue is empty. A job renders every channel
+// that shares the update callback of its first channel.
+static void mixerRunJobs(Mixer* mixer)
+{
+    for (;;) {
+        MixerUpdateCallback callback;
+        Int32 job;
+        int i;
+
+        archSemaphoreWait(mixer->jobLock, -1);
+        job = mixer->jobNext++;
+        archSemaphoreSignal(mixer->jobLock);
+
+        if (job >= mixer->jobCount) {
+            return;
+        }
+
+        callback = mixer->channels[mixer->jobList[job]].updateCallback;
+        for (i = mixer->jobList[job]; i < mixer->channelCount; i++) {
+            if (mixer->channels[i].updateCallback == callback) {
+                mixer->jobBuff[i] = channelUpdate(mixer->channels + i, mixer->jobSamples);
+            }
+        }
+    }
+}
+
+static void mixerWorkerThread(void* arg)
+{
+    Mixer* mixer = (Mixer*)arg;
+
+    for (;;) {
+        archSemaphoreWait(mixer->jobStart, -1);
+        if (mixer->jobQuit) {
+            break;
+        }
+        mixerRunJobs(mixer);
+        archSemaphoreSignal(mixer->jobDone);
+    }
+}
+
+static void mixerSyncChannelsThreaded(Mixer* mixer, Int32** chBuff, UInt32 count)
+{
+    int i;
+    int j;
+
+    mixer->jobCount   = 0;
+    mixer->jobNext    = 0;
+    mixer->jobSamples = count;
+
+    for (i = 0; i < mixer->channelCount; i++) {
+        for (j = 0; j < i; j++) {
+            if (mixer->channels[j].updateCallback == mixer->channels[i].updateCallback) {
+                break;
+            }
+        }
+        if (j == i) {
+            mixer->jobList[mixer->jobCount++] = i;
+        }
+    }
+
+    for (i = 0; i < mixer->threadCount; i++) {
+        archSemaphoreSignal(mixer->jobStart);
+    }
+    mixerRunJobs(mixer);
+    for (i = 0; i < mixer->threadCount; i++) {
+        archSemaphoreWait(mixer->jobDone, -1);
+    }
+
+    for (i = 0; i < mixer->channelCount; i++) {
+        chBuff[i] = mixer->jobBuff[i];
+    }
+}
+
+Int32 mixerSetThreadCount(Mixer* mixer, Int32 count)
+{
+    int i;
+
+    if (count > MIXER_MAX_THREADS) {
+        count = MIXER_MAX_THREADS;
+    }
+    if (count == mixer->threadCount) {
+        return count;
+    }
+
+    if (mixer->threadCount > 0) {
+        mixer->jobQuit = 1;
+        for (i = 0; i < mixer->threadCount; i++) {
+            archSemaphoreSignal(mixer->jobStart);
+        }
+        for (i = 0; i < mixer->threadCount; i++) {
+            archThreadDestroy(mixer->threads[i]);
+            mixer->threads[i] = NULL;
+        }
+        archSemaphoreDestroy(mixer->jobStart);
+        archSemaphoreDestroy(mixer->jobDone);
+        archSemaphoreDestroy(mixer->jobLock);
+        mixer->threadCount = 0;
+        mixer->jobQuit     = 0;
+    }
+
+    if (count <= 0) {
+        return 0;
+    }
+
+    mixer->jobStart = archSemaphoreCreate(0);
+    mixer->jobDone  = archSemaphoreCreate(0);
+    mixer->jobLock  = archSemaphoreCreate(1);
+    if (mixer->jobStart == NULL || mixer->jobDone == NULL || mixer->jobLock == NULL) {
+        archSemaphoreDestroy(mixer->jobStart);
+        archSemaphoreDestroy(mixer->jobDone);
+        archSemaphoreDestroy(mixer->jobLock);
+        return 0;
+    }
+
+    for (i = 0; i < count; i++) {
+        mixer->threads[i] = archThreadCreateArg(mixerWorkerThread, mixer, THREAD_PRIO_HIGH);
+        if (mixer->threads[i] == NULL) {
+            break;
+        }
+        mixer->threadCount++;
+    }
+
+    if (mixer->threadCount == 0) {
+        archSemaphoreDestroy(mixer->jobStart);
+        archSemaphoreDestroy(mixer->jobDone);
+        archSemaphoreDestroy(mixer->jobLock);
+    }
+
+    return mixer->threadCount;
+}
+
 void mixerSetWriteCallback(Mixer* mixer, MixerWriteCallback callback, void* ref, int fragmentSize)
 {
     mixer->fragmentSize = fragmentSize;
@@ -367,6 +638,9 @@ void mixerSetWriteCallback(Mixer* mixer, MixerWriteCallback callback, void* ref,
     if (mixer->fragmentSize <= 0) {
         mixer->fragmentSize = 512;
     }
+    if (mixer->fragmentSize > AUDIO_STEREO_BUFFER_SIZE) {
+        mixer->fragmentSize = AUDIO_STEREO_BUFFER_SIZE;
+    }
 }
 
 Int32 mixerRegisterChannel(Mixer* mixer, Int32 audioType, Int32 stereo, MixerUpdateCallback callback, MixerSetSampleRateCallback rateCallback, void* ref)
@@ -396,8 +670,11 @@ Int32 mixerRegisterChannel(Mixer* mixer, Int32 audioType, Int32 stereo, MixerUpd
     channel->volume         = type->volume;
     channel->pan            = type->pan;
     channel->handle         = ++mixer->handleCount;
+    channel->nativeRate     = AUDIO_SAMPLERATE;
+    channel->resampler      = NULL;
 
     recalculateChannelVolume(mixer, channel);
+    updateChannelResampler(mixer, channel);
 
     return channel->handle;
 }
@@ -418,6 +695,9 @@ void mixerUnregisterChannel(Mixer* mixer, Int32 handle)
     if (i == mixer->channelCount)
         return;
 
+    if (mixer->channels[i].resampler != NULL)
+        audioResamplerDestroy(mixer->channels[i].resampler);
+
     mixer->channelCount--;
     while (i < mixer->channelCount)
     {
@@ -432,6 +712,76 @@ void mixerReset(Mixer* mixer)
     mixer->index = 0;
 }
 
+// The sample timing and the resampler positions are saved so the audio
+// stream after a state load is identical to the one of the original run
+void mixerSaveState(Mixer* mixer)
+{
+    SaveState* state = saveStateOpenForWrite("mixer");
+    int i;
+
+    saveStateSet(state, "refTime",      mixer->refTime);
+    saveStateSet(state, "refFrag",      mixer->refFrag);
+    saveStateSet(state, "index",        mixer->index);
+    saveStateSet(state, "volIndex",     mixer->volIndex);
+    saveStateSet(state, "channelCount", mixer->channelCount);
+    saveStateSetBuffer(state, "buffer", mixer->buffer, mixer->index * sizeof(Int16));
+
+    saveStateClose(state);
+
+    for (i = 0; i < mixer->channelCount; i++) {
+        state = saveStateOpenForWrite("mixerChannel");
+        if (mixer->channels[i].resampler != NULL) {
+            audioResamplerSaveState(mixer->channels[i].resampler, state);
+        }
+        saveStateClose(state);
+    }
+}
+
+void mixerLoadState(Mixer* mixer)
+{
+    SaveState* state = saveStateOpenForRead("mixer");
+    UInt32 index;
+    int i;
+
+    // States without mixer info keep the current timing
+    if (saveStateGet(state, "channelCount", -1) != mixer->channelCount) {
+        saveStateClose(state);
+        mixerReset(mixer);
+        return;
+    }
+
+    index = saveStateGet(state, "index", 0);
+    if (index > sizeof(mixer->buffer) / sizeof(mixer->buffer[0]) || index >= (UInt32)mixer->fragmentSize) {
+        index = 0;
+    }
+
+    mixer->refTime  = saveStateGet(state, "refTime",  boardSystemTime());
+    mixer->refFrag  = saveStateGet(state, "refFrag",  0);
+    mixer->volIndex = saveStateGet(state, "volIndex", 0);
+    mixer->index    = index;
+    saveStateGetBuffer(state, "buffer", mixer->buffer, index * sizeof(Int16));
+
+    saveStateClose(state);
+
+    for (i = 0; i < mixer->channelCount; i++) {
+        state = saveStateOpenForRead("mixerChannel");
+        if (mixer->channels[i].resampler != NULL) {
+            audioResamplerLoadState(mixer->channels[i].resampler, state);
+        }
+        saveStateClose(state);
+    }
+}
+
+void mixerFlush(Mixer* mixer)
+{
+    mixerSync(mixer);
+
+    if (mixer->index > 0 && mixer->writeCallback != NULL) {
+        mixer->writeCallback(mixer->writeRef, mixer->buffer, mixer->index);
+    }
+    mixer->index = 0;
+}
+
 void mixerSync(Mixer* mixer)
 {
     UInt32 systemTime = boardSystemTime();
@@ -469,12 +819,12 @@ void mixerSync(Mixer* mixer)
         return;
     }
     
-    for (i = 0; i < mixer->channelCount; i++) {
-        if (mixer->channels[i].updateCallback != NULL) {
-            chBuff[i] = mixer->channels[i].updateCallback(mixer->channels[i].ref, count);
-        }
-        else {
-            chBuff[i] = NULL;
+    if (mixer->threadCount > 0 && mixer->channelCount > 1 && count >= MIXER_THREAD_MIN_SAMPLES) {
+        mixerSyncChannelsThreaded(mixer, chBuff, count);
+    }
+    else {
+        for (i = 0; i < mixer->channelCount; i++) {
+            chBuff[i] = channelUpdate(mixer->channels + i, count);
         }
     }
 
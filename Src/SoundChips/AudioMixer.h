@@ -59,6 +59,12 @@ typedef enum {
 
 #define MAX_CHANNELS 16
 
+typedef enum {
+    MIXER_RESAMPLE_NONE = 0,
+    MIXER_RESAMPLE_LINEAR,
+    MIXER_RESAMPLE_SINC
+} MixerResampleMode;
+
 typedef Int32* (*MixerUpdateCallback)(void*, UInt32);
 typedef void (*MixerSetSampleRateCallback)(void*, UInt32);
 typedef Int32 (*MixerWriteCallback)(void*, Int16*, UInt32);
@@ -74,6 +80,8 @@ void mixerEnableMaster(Mixer* mixer, Int32 enable);
 void mixerSetStereo(Mixer* mixer, Int32 stereo);
 UInt32 mixerGetSampleRate(Mixer* mixer);
 void mixerSetSampleRate(Mixer* mixer, UInt32 rate);
+void mixerSetResampleMode(Mixer* mixer, MixerResampleMode mode);
+MixerResampleMode mixerGetResampleMode(Mixer* mixer);
 
 void mixerSetChannelTypeVolume(Mixer* mixer, Int32 channelType, Int32 volume);
 void mixerSetChannelTypePan(Mixer* mixer, Int32 channelType, Int32 pan);
@@ -83,8 +91,17 @@ Int32 mixerIsChannelTypeActive(Mixer* mixer, Int32 channelType, Int32 reset);
 /* Write callback registration for audio drivers */
 void mixerSetWriteCallback(Mixer* mixer, MixerWriteCallback callback, void*, int);
 
+/* Renders all channels up to the current time and passes every sample
+ * buffered so far to the write callback in a single call. Drivers that
+ * want one write per emulated frame set a fragment size larger than a
+ * frame and call this when the frame is done.
+ */
+void mixerFlush(Mixer* mixer);
+
 /* Internal interface methods */
 void mixerReset(Mixer* mixer);
+void mixerSaveState(Mixer* mixer);
+void mixerLoadState(Mixer* mixer);
 void mixerSync(Mixer* mixer);
 
 Int32 mixerRegisterChannel(Mixer* mixer, Int32 audioType, Int32 stereo, 
@@ -93,6 +110,30 @@ Int32 mixerRegisterChannel(Mixer* mixer, Int32 audioType, Int32 stereo,
 void mixerSetEnable(Mixer* mixer, int enable);
 void mixerUnregisterChannel(Mixer* mixer, Int32 handle);
 
+/* Native rate support. A channel renders at its native rate and the mixer
+ * resamples it to the output rate. Channels default to AUDIO_SAMPLERATE.
+ * Chips should configure themselves with mixerGetChannelSampleRate() which
+ * returns the rate the update callback is expected to produce.
+ */
+void mixerSetChannelNativeRate(Mixer* mixer, Int32 handle, UInt32 nativeRate);
+UInt32 mixerGetChannelSampleRate(Mixer* mixer, Int32 handle);
+
+/* Returns the oversampling factor a chip should use. Chips rendering at
+ * their native rate don't oversample, so this is 1 unless the resampler
+ * is disabled.
+ */
+Int32 mixerGetChannelOversampling(Mixer* mixer, Int32 handle, Int32 oversampling);
+
+/* Optional worker threads. When enabled, the channel update callbacks of
+ * larger syncs run in parallel and mixerSync waits for all of them before
+ * mixing. Channels sharing an update callback always run on the same
+ * thread since several chip cores keep global state. Returns the number
+ * of workers actually started, which is 0 when threads are unavailable.
+ */
+#define MIXER_MAX_THREADS 4
+
+Int32 mixerSetThreadCount(Mixer* mixer, Int32 count);
+
 void mixerSetBoardFrequency(int CPUFrequency);
 void mixerSetBoardFrequencyFixed(int CPUFrequency);
 
@@ -0,0 +1,273 @@
+/*****************************************************************************
+** File: AudioResampler.c
+**
+** More info: http://www.bluemsx.com
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+**
+******************************************************************************
+*/
+#include "AudioResampler.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define SINC_TAPS       16
+#define SINC_PHASES     256
+#define SINC_COEF_BITS  15
+
+// Maximum number of native frames requested from a chip in one go. Must
+// stay well below AUDIO_MONO_BUFFER_SIZE since that is what the chips
+// use for their own generation buffers.
+#define MAX_INPUT_FRAMES 4096
+
+struct AudioResampler
+{
+    MixerResampleMode mode;
+    Int32  channels;
+    Int32  taps;
+    UInt32 inRate;
+    UInt32 outRate;
+    UInt32 stepInt;
+    UInt32 stepFrac;
+    UInt32 fracScale;
+    UInt32 maxChunk;
+    UInt32 acc;
+    UInt32 pos;
+    UInt32 avail;
+    Int32  in[2 * (MAX_INPUT_FRAMES + SINC_TAPS + 1)];
+    Int32  out[AUDIO_STEREO_BUFFER_SIZE];
+    Int32  coef[SINC_PHASES][SINC_TAPS];
+};
+
+static void makeSincTable(AudioResampler* rs)
+{
+    DoubleT cutoff = 0.90;
+    int p;
+    int k;
+
+    if (rs->outRate < rs->inRate) {
+        cutoff = cutoff * rs->outRate / rs->inRate;
+    }
+
+    for (p = 0; p < SINC_PHASES; p++) {
+        DoubleT frac = (DoubleT)p / SINC_PHASES;
+        DoubleT h[SINC_TAPS];
+        DoubleT sum = 0;
+        Int32 isum = 0;
+
+        for (k = 0; k < SINC_TAPS; k++) {
+            DoubleT x = k - (SINC_TAPS / 2 - 1) - frac;
+            DoubleT w = 2 * M_PI * (x + SINC_TAPS / 2) / SINC_TAPS;
+            DoubleT s = x == 0 ? 1.0 : sin(M_PI * cutoff * x) / (M_PI * cutoff * x);
+
+            // Blackman window
+            h[k] = s * (0.42 - 0.5 * cos(w) + 0.08 * cos(2 * w));
+            sum += h[k];
+        }
+
+        // Normalize every phase to unity DC gain
+        for (k = 0; k < SINC_TAPS; k++) {
+            rs->coef[p][k] = (Int32)floor(h[k] / sum * (1 << SINC_COEF_BITS) + 0.5);
+            isum += rs->coef[p][k];
+        }
+        rs->coef[p][SINC_TAPS / 2 - 1] += (1 << SINC_COEF_BITS) - isum;
+    }
+}
+
+AudioResampler* audioResamplerCreate(Int32 stereo)
+{
+    AudioResampler* rs = (AudioResampler*)calloc(1, sizeof(AudioResampler));
+
+    rs->channels = stereo ? 2 : 1;
+    rs->mode     = MIXER_RESAMPLE_LINEAR;
+    rs->taps     = 2;
+
+    return rs;
+}
+
+void audioResamplerDestroy(AudioResampler* rs)
+{
+    free(rs);
+}
+
+void audioResamplerReset(AudioResampler* rs)
+{
+    // Prime the history so the first output sample is centered in the
+    // filter window. This adds taps/2 native samples of latency.
+    rs->acc   = 0;
+    rs->pos   = 0;
+    rs->avail = rs->taps / 2 - 1;
+    memset(rs->in, 0, sizeof(rs->in));
+}
+
+void audioResamplerSetRates(AudioResampler* rs, UInt32 inRate, UInt32 outRate, MixerResampleMode mode)
+{
+    rs->mode      = mode == MIXER_RESAMPLE_SINC ? MIXER_RESAMPLE_SINC : MIXER_RESAMPLE_LINEAR;
+    rs->taps      = rs->mode == MIXER_RESAMPLE_SINC ? SINC_TAPS : 2;
+    rs->inRate    = inRate;
+    rs->outRate   = outRate;
+    rs->stepInt   = inRate / outRate;
+    rs->stepFrac  = inRate % outRate;
+    rs->fracScale = (UInt32)(((UInt64)1 << 32) / outRate);
+    rs->maxChunk  = (UInt32)((UInt64)(MAX_INPUT_FRAMES - rs->taps) * outRate / inRate) - 1;
+
+    if (rs->mode == MIXER_RESAMPLE_SINC) {
+        makeSincTable(rs);
+    }
+
+    audioResamplerReset(rs);
+}
+
+static void fillInput(AudioResampler* rs, MixerUpdateCallback callback, void* ref, UInt32 frames)
+{
+    Int32* dst = rs->in + rs->avail * rs->channels;
+    Int32* src = callback != NULL ? callback(ref, frames) : NULL;
+
+    if (src != NULL) {
+        memcpy(dst, src, frames * rs->channels * sizeof(Int32));
+    }
+    else {
+        memset(dst, 0, frames * rs->channels * sizeof(Int32));
+    }
+    rs->avail += frames;
+}
+
+static void resampleLinear(AudioResampler* rs, Int32* out, UInt32 count)
+{
+    const Int32 channels = rs->channels;
+
+    while (count--) {
+        // 12 bit fraction, the product is taken in 64 bits since the FM
+        // channels are scaled well beyond 16 bits before mixing
+        Int32  frac = (Int32)((rs->acc * rs->fracScale) >> 20);
+        Int32* s    = rs->in + rs->pos * channels;
+
+        if (channels == 2) {
+            *out++ = s[0] + (Int32)(((__int64)(s[2] - s[0]) * frac) >> 12);
+            *out++ = s[1] + (Int32)(((__int64)(s[3] - s[1]) * frac) >> 12);
+        }
+        else {
+            *out++ = s[0] + (Int32)(((__int64)(s[1] - s[0]) * frac) >> 12);
+        }
+
+        rs->pos += rs->stepInt;
+        rs->acc += rs->stepFrac;
+        if (rs->acc >= rs->outRate) {
+            rs->acc -= rs->outRate;
+            rs->pos++;
+        }
+    }
+}
+
+static void resampleSinc(AudioResampler* rs, Int32* out, UInt32 count)
+{
+    const Int32 channels = rs->channels;
+    int k;
+
+    while (count--) {
+        Int32* c = rs->coef[(rs->acc * rs->fracScale) >> 24];
+        Int32* s = rs->in + rs->pos * channels;
+
+        if (channels == 2) {
+            __int64 left  = 0;
+            __int64 right = 0;
+            for (k = 0; k < SINC_TAPS; k++) {
+                left  += (__int64)c[k] * s[2 * k + 0];
+                right += (__int64)c[k] * s[2 * k + 1];
+            }
+            *out++ = (Int32)(left  >> SINC_COEF_BITS);
+            *out++ = (Int32)(right >> SINC_COEF_BITS);
+        }
+        else {
+            __int64 sum = 0;
+            for (k = 0; k < SINC_TAPS; k++) {
+                sum += (__int64)c[k] * s[k];
+            }
+            *out++ = (Int32)(sum >> SINC_COEF_BITS);
+        }
+
+        rs->pos += rs->stepInt;
+        rs->acc += rs->stepFrac;
+        if (rs->acc >= rs->outRate) {
+            rs->acc -= rs->outRate;
+            rs->pos++;
+        }
+    }
+}
+
+Int32* audioResamplerProcess(AudioResampler* rs, MixerUpdateCallback callback, void* ref, UInt32 count)
+{
+    Int32* out = rs->out;
+
+    if (count > AUDIO_MONO_BUFFER_SIZE) {
+        count = AUDIO_MONO_BUFFER_SIZE;
+    }
+
+    while (count > 0) {
+        UInt32 chunk = count < rs->maxChunk ? count : rs->maxChunk;
+        UInt32 last  = rs->pos + (UInt32)(((UInt64)rs->acc + (UInt64)(chunk - 1) * rs->inRate) / rs->outRate);
+        UInt32 need  = last + rs->taps + rs->stepInt;
+
+        if (need > rs->avail) {
+            fillInput(rs, callback, ref, need - rs->avail);
+        }
+
+        if (rs->mode == MIXER_RESAMPLE_SINC) {
+            resampleSinc(rs, out, chunk);
+        }
+        else {
+            resampleLinear(rs, out, chunk);
+        }
+
+        // Drop consumed input but keep the filter history
+        memmove(rs->in, rs->in + rs->pos * rs->channels,
+                (rs->avail - rs->pos) * rs->channels * sizeof(Int32));
+        rs->avail -= rs->pos;
+        rs->pos    = 0;
+
+        out   += chunk * rs->channels;
+        count -= chunk;
+    }
+
+    return rs->out;
+}
+
+void audioResamplerSaveState(AudioResampler* rs, SaveState* state)
+{
+    saveStateSet(state, "acc",   rs->acc);
+    saveStateSet(state, "avail", rs->avail);
+    saveStateSetBuffer(state, "in", rs->in, rs->avail * rs->channels * sizeof(Int32));
+}
+
+void audioResamplerLoadState(AudioResampler* rs, SaveState* state)
+{
+    UInt32 avail = saveStateGet(state, "avail", rs->avail);
+
+    if (avail * rs->channels > sizeof(rs->in) / sizeof(rs->in[0])) {
+        audioResamplerReset(rs);
+        return;
+    }
+
+    rs->acc   = saveStateGet(state, "acc", 0) % rs->outRate;
+    rs->pos   = 0;
+    rs->avail = avail;
+    memset(rs->in, 0, sizeof(rs->in));
+    saveStateGetBuffer(state, "in", rs->in, avail * rs->channels * sizeof(Int32));
+}
@@ -0,0 +1,50 @@
+/*****************************************************************************
+** File: AudioResampler.h
+**
+** More info: http://www.bluemsx.com
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+**
+******************************************************************************
+*/
+#ifndef AUDIO_RESAMPLER_H
+#define AUDIO_RESAMPLER_H
+
+#include "MsxTypes.h"
+#include "AudioMixer.h"
+#include "SaveState.h"
+
+/* Converts the output of a sound chip running at its native rate to the
+ * mixer output rate. The resampler pulls exactly as many native samples
+ * from the channel update callback as it needs to produce the requested
+ * number of output samples, so the chip stays in sync with emulated time.
+ */
+typedef struct AudioResampler AudioResampler;
+
+AudioResampler* audioResamplerCreate(Int32 stereo);
+void audioResamplerDestroy(AudioResampler* rs);
+
+void audioResamplerSetRates(AudioResampler* rs, UInt32 inRate, UInt32 outRate, MixerResampleMode mode);
+void audioResamplerReset(AudioResampler* rs);
+
+Int32* audioResamplerProcess(AudioResampler* rs, MixerUpdateCallback callback, void* ref, UInt32 count);
+
+/* The position and the buffered native samples are part of the save
+ * state so the output after a state load matches the original run.
+ */
+void audioResamplerSaveState(AudioResampler* rs, SaveState* state);
+void audioResamplerLoadState(AudioResampler* rs, SaveState* state);
+
+#endif
@@ -27,6 +27,7 @@
 */
 #include "DAC.h"
 #include "Board.h"
+#include "SaveState.h"
 #include <stdlib.h>
 #include <string.h>
 
@@ -66,6 +67,58 @@ void dacReset(DAC* dac) {
     dac->daVolume[DAC_CH_RIGHT]        = 0;
 }
 
+void dacLoadState(DAC* dac)
+{
+    SaveState* state = saveStateOpenForRead("dac");
+    char tag[32];
+    int i;
+
+    dac->enabled = saveStateGet(state, "enabled", 0);
+
+    for (i = 0; i < 2; i++) {
+        sprintf(tag, "sampleVolume%d", i);
+        dac->sampleVolume[i] = saveStateGet(state, tag, 0);
+        sprintf(tag, "oldSampleVolume%d", i);
+        dac->oldSampleVolume[i] = saveStateGet(state, tag, 0);
+        sprintf(tag, "sampleVolumeSum%d", i);
+        dac->sampleVolumeSum[i] = saveStateGet(state, tag, 0);
+        sprintf(tag, "count%d", i);
+        dac->count[i] = saveStateGet(state, tag, 0);
+        sprintf(tag, "ctrlVolume%d", i);
+        dac->ctrlVolume[i] = saveStateGet(state, tag, 0);
+        sprintf(tag, "daVolume%d", i);
+        dac->daVolume[i] = saveStateGet(state, tag, 0);
+    }
+
+    saveStateClose(state);
+}
+
+void dacSaveState(DAC* dac)
+{
+    SaveState* state = saveStateOpenForWrite("dac");
+    char tag[32];
+    int i;
+
+    saveStateSet(state, "enabled", dac->enabled);
+
+    for (i = 0; i < 2; i++) {
+        sprintf(tag, "sampleVolume%d", i);
+        saveStateSet(state, tag, dac->sampleVolume[i]);
+        sprintf(tag, "oldSampleVolume%d", i);
+        saveStateSet(state, tag, dac->oldSampleVolume[i]);
+        sprintf(tag, "sampleVolumeSum%d", i);
+        saveStateSet(state, tag, dac->sampleVolumeSum[i]);
+        sprintf(tag, "count%d", i);
+        saveStateSet(state, tag, dac->count[i]);
+        sprintf(tag, "ctrlVolume%d", i);
+        saveStateSet(state, tag, dac->ctrlVolume[i]);
+        sprintf(tag, "daVolume%d", i);
+        saveStateSet(state, tag, dac->daVolume[i]);
+    }
+
+    saveStateClose(state);
+}
+
 DAC* dacCreate(Mixer* mixer, DacMode mode)
 {
     DAC* dac = (DAC*)calloc(1, sizeof(DAC));
@@ -44,6 +44,10 @@ DAC* dacCreate(Mixer* mixer, DacMode mode);
 void dacDestroy(DAC* dac);
 void dacReset(DAC* dac);
 
+/* Utility functions */
+void dacLoadState(DAC* dac);
+void dacSaveState(DAC* dac);
+
 /* Register read/write methods */
 void dacWrite(DAC* dac, DacChannel channel, UInt8 value);
 
@@ -26,6 +26,7 @@
 ******************************************************************************
 */
 #include "KeyClick.h"
+#include "SaveState.h"
 #include <stdlib.h>
 #include <string.h>
 
@@ -72,6 +73,34 @@ void audioKeyClick(AudioKeyClick* keyClick, UInt8 value)
     keyClick->sampleVolume = value ? 32000 : 0;
 }
 
+void audioKeyClickLoadState(AudioKeyClick* keyClick)
+{
+    SaveState* state = saveStateOpenForRead("keyClick");
+
+    keyClick->sampleVolume    = saveStateGet(state, "sampleVolume",    0);
+    keyClick->sampleVolumeSum = saveStateGet(state, "sampleVolumeSum", 0);
+    keyClick->oldSampleVolume = saveStateGet(state, "oldSampleVolume", 0);
+    keyClick->ctrlVolume      = saveStateGet(state, "ctrlVolume",      0);
+    keyClick->daVolume        = saveStateGet(state, "daVolume",        0);
+    keyClick->count           = saveStateGet(state, "count",           0);
+
+    saveStateClose(state);
+}
+
+void audioKeyClickSaveState(AudioKeyClick* keyClick)
+{
+    SaveState* state = saveStateOpenForWrite("keyClick");
+
+    saveStateSet(state, "sampleVolume",    keyClick->sampleVolume);
+    saveStateSet(state, "sampleVolumeSum", keyClick->sampleVolumeSum);
+    saveStateSet(state, "oldSampleVolume", keyClick->oldSampleVolume);
+    saveStateSet(state, "ctrlVolume",      keyClick->ctrlVolume);
+    saveStateSet(state, "daVolume",        keyClick->daVolume);
+    saveStateSet(state, "count",           keyClick->count);
+
+    saveStateClose(state);
+}
+
 static Int32* audioKeyClickSync(void* ref, UInt32 count)
 {
     AudioKeyClick* keyClick = (AudioKeyClick*)ref;
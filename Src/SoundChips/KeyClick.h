@@ -41,4 +41,8 @@ void audioKeyClickDestroy(AudioKeyClick* keyClick);
 /* Register read/write methods */
 void audioKeyClick(AudioKeyClick* keyClick, UInt8 value);
 
+/* Utility functions */
+void audioKeyClickLoadState(AudioKeyClick* keyClick);
+void audioKeyClickSaveState(AudioKeyClick* keyClick);
+
 #endif
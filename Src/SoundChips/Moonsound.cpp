@@ -45,10 +45,12 @@ struct Moonsound {
 
     Mixer* mixer;
     Int32 handle;
+    Int32 handleFm;
 
     YMF278* ymf278;
     YMF262* ymf262;
     Int32  buffer[AUDIO_STEREO_BUFFER_SIZE];
+    Int32  bufferFm[AUDIO_STEREO_BUFFER_SIZE];
     Int32  defaultBuffer[AUDIO_STEREO_BUFFER_SIZE];
     BoardTimer* timer1;
     BoardTimer* timer2;
@@ -134,6 +136,7 @@ extern "C" {
 void moonsoundDestroy(Moonsound* moonsound) 
 {
     mixerUnregisterChannel(moonsound->mixer, moonsound->handle);
+    mixerUnregisterChannel(moonsound->mixer, moonsound->handleFm);
 
     delete moonsound->ymf262;
     delete moonsound->ymf278;
@@ -288,28 +291,42 @@ void moonsoundReset(Moonsound* moonsound)
     moonsoundTimerStart(moonsound, 4, 0, moonsound->timerRef2);
 }
 
+// The wave (YMF278) and FM (YMF262) parts run at different rates, so
+// each has its own mixer channel
 static Int32* moonsoundSync(void* ref, UInt32 count) 
 {
     Moonsound* moonsound = (Moonsound*)ref;
-    int* genBuf1 = NULL;
-    int* genBuf2 = NULL;
+    int* genBuf;
     UInt32 i;
 
-    genBuf1 = moonsound->ymf262->updateBuffer(count);
-    if (genBuf1 == NULL) {
-        genBuf1 = (int*)moonsound->defaultBuffer;
+    genBuf = moonsound->ymf278->updateBuffer(count);
+    if (genBuf == NULL) {
+        return moonsound->defaultBuffer;
     }
 
-    genBuf2 = moonsound->ymf278->updateBuffer(count);
-    if (genBuf2 == NULL) {
-        genBuf2 = (int*)moonsound->defaultBuffer;
+    for (i = 0; i < 2 * count; i++) {
+        moonsound->buffer[i] = genBuf[i];
+    }
+
+    return moonsound->buffer;
+}
+
+static Int32* moonsoundSyncFm(void* ref, UInt32 count) 
+{
+    Moonsound* moonsound = (Moonsound*)ref;
+    int* genBuf;
+    UInt32 i;
+
+    genBuf = moonsound->ymf262->updateBuffer(count);
+    if (genBuf == NULL) {
+        return moonsound->defaultBuffer;
     }
 
     for (i = 0; i < 2 * count; i++) {
-        moonsound->buffer[i] = genBuf1[i] + genBuf2[i];
+        moonsound->bufferFm[i] = genBuf[i];
     }
 
-    return moonsound->buffer;
+    return moonsound->bufferFm;
 }
 
 UInt8 moonsoundPeek(Moonsound* moonsound, UInt16 ioPort)
@@ -408,8 +425,13 @@ void moonsoundWrite(Moonsound* moonsound, UInt16 ioPort, UInt8 value)
 void moonsoundSetSampleRate(void* ref, UInt32 rate)
 {
     Moonsound* moonsound = (Moonsound*)ref;
-    moonsound->ymf262->setSampleRate(rate, boardGetMoonsoundOversampling());
-    moonsound->ymf278->setSampleRate(rate, boardGetMoonsoundOversampling());
+    moonsound->ymf278->setSampleRate(rate, mixerGetChannelOversampling(moonsound->mixer, moonsound->handle, boardGetMoonsoundOversampling()));
+}
+
+void moonsoundSetSampleRateFm(void* ref, UInt32 rate)
+{
+    Moonsound* moonsound = (Moonsound*)ref;
+    moonsound->ymf262->setSampleRate(rate, mixerGetChannelOversampling(moonsound->mixer, moonsound->handleFm, boardGetMoonsoundOversampling()));
 }
 
 Moonsound* moonsoundCreate(Mixer* mixer, void* romData, int romSize, int sramSize)
@@ -425,13 +447,17 @@ Moonsound* moonsoundCreate(Mixer* mixer, void* romData, int romSize, int sramSiz
     moonsound->timer2 = boardTimerCreate(onTimeout2, moonsound);
 
     moonsound->handle = mixerRegisterChannel(mixer, MIXER_CHANNEL_MOONSOUND, 1, moonsoundSync, moonsoundSetSampleRate, moonsound);
+    mixerSetChannelNativeRate(mixer, moonsound->handle, 33868800 / 768);
+    moonsound->handleFm = mixerRegisterChannel(mixer, MIXER_CHANNEL_MOONSOUND, 1, moonsoundSyncFm, moonsoundSetSampleRateFm, moonsound);
+    // The YMF262 runs from 14.31818 MHz / 288
+    mixerSetChannelNativeRate(mixer, moonsound->handleFm, 49716);
 
     moonsound->ymf262 = new YMF262(0, systemTime, moonsound);
-    moonsound->ymf262->setSampleRate(mixerGetSampleRate(mixer), boardGetMoonsoundOversampling());
+    moonsoundSetSampleRateFm(moonsound, mixerGetChannelSampleRate(mixer, moonsound->handleFm));
 	moonsound->ymf262->setVolume(32767 * 9 / 10);
 
     moonsound->ymf278 = new YMF278(0, sramSize, romData, romSize, systemTime);
-    moonsound->ymf278->setSampleRate(mixerGetSampleRate(mixer), boardGetMoonsoundOversampling());
+    moonsoundSetSampleRate(moonsound, mixerGetChannelSampleRate(mixer, moonsound->handle));
     moonsound->ymf278->setVolume(32767 * 9 / 10);
 
     return moonsound;
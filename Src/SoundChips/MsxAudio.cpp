@@ -194,7 +194,7 @@ extern "C" void msxaudioWrite(MsxAudio* msxaudio, UInt16 ioPort, UInt8 value)
 void msxaudioSetSampleRate(void* ref, UInt32 rate)
 {
     MsxAudio* msxaudio = (MsxAudio*)ref;
-    msxaudio->y8950->setSampleRate(rate, boardGetY8950Oversampling());
+    msxaudio->y8950->setSampleRate(rate, mixerGetChannelOversampling(msxaudio->mixer, msxaudio->handle, boardGetY8950Oversampling()));
 }
 
 extern "C" int msxaudioCreate(Mixer* mixer)
@@ -211,11 +211,12 @@ extern "C" int msxaudioCreate(Mixer* mixer)
     msxaudio->registerLatch = 0;
 
     msxaudio->handle = mixerRegisterChannel(mixer, MIXER_CHANNEL_MSXAUDIO, 0, msxaudioSync, msxaudioSetSampleRate, msxaudio);
+    mixerSetChannelNativeRate(mixer, msxaudio->handle, FREQUENCY / 72);
 
     msxaudio->deviceHandle = deviceManagerRegister(ROM_MSXAUDIO, &callbacks, msxaudio);
 
     msxaudio->y8950 = new Y8950("MsxAudio", 256*1024, systemTime);
-    msxaudio->y8950->setSampleRate(mixerGetSampleRate(mixer), boardGetY8950Oversampling());
+    msxaudioSetSampleRate(msxaudio, mixerGetChannelSampleRate(mixer, msxaudio->handle));
 	msxaudio->y8950->setVolume(32767);
 
     ioPortRegister(0xc0, (IoPortRead)msxaudioRead, (IoPortWrite)msxaudioWrite, msxaudio);
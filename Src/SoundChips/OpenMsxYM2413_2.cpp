@@ -27,7 +27,7 @@ static const DoubleT PI = 3.14159265358979323846;
 
 int OpenYM2413_2::pmtable[PM_PG_WIDTH];
 int OpenYM2413_2::amtable[AM_PG_WIDTH];
-unsigned int OpenYM2413_2::tllTable[16][8][1 << TL_BITS][4];
+UINT8 OpenYM2413_2::kslTable[16][8][4];
 int OpenYM2413_2::rksTable[2][8][2];
 UINT16 OpenYM2413_2::AR_ADJUST_TABLE[1 << EG_BITS];
 UINT16 OpenYM2413_2::fullsintable[PG_WIDTH];
@@ -36,7 +36,8 @@ UINT16* OpenYM2413_2::waveform[2] = {fullsintable, halfsintable};
 short OpenYM2413_2::dB2LinTab[(2 * DB_MUTE) * 2];
 unsigned int OpenYM2413_2::dphaseARTable[16][16];
 unsigned int OpenYM2413_2::dphaseDRTable[16][16];
-unsigned int OpenYM2413_2::dphaseTable[512][8][16];
+// The chip runs at its native rate until setSampleRate() is called
+int OpenYM2413_2::dphaseRate = CLOCK_FREQ / 72;
 unsigned int OpenYM2413_2::pm_dphase;
 unsigned int OpenYM2413_2::am_dphase;
 
@@ -176,27 +177,7 @@ void OpenYM2413_2::makeAmTable()
 	}
 }
 
-// Phase increment counter table
-void OpenYM2413_2::makeDphaseTable(int sampleRate)
-{
-	unsigned int mltable[16] = {
-		1,   1*2,  2*2,  3*2,  4*2,  5*2,  6*2,  7*2,
-		8*2, 9*2, 10*2, 10*2, 12*2, 12*2, 15*2, 15*2
-	};
-
-	for (unsigned fnum = 0; fnum < 512; ++fnum) {
-		for (unsigned block = 0; block < 8; ++block) {
-			for (unsigned ML = 0; ML < 16; ++ML) {
-				dphaseTable[fnum][block][ML] = 
-				    rate_adjust(((fnum * mltable[ML]) << block) >>
-				                (20 - DP_BITS),
-				                sampleRate);
-			}
-		}
-	}
-}
-
-void OpenYM2413_2::makeTllTable()
+void OpenYM2413_2::makeKslTable()
 {
 	DoubleT kltable[16] = {
 		( 0.000 * 2), ( 9.000 * 2), (12.000 * 2), (13.875 * 2),
@@ -207,17 +188,15 @@ void OpenYM2413_2::makeTllTable()
   
 	for (int fnum = 0; fnum < 16; ++fnum) {
 		for (int block = 0; block < 8; ++block) {
-			for (int TL = 0; TL < 64; ++TL) {
-				for (int KL = 0; KL < 4; ++KL) {
-					if (KL == 0) {
-						tllTable[fnum][block][TL][KL] = TL2EG(TL);
-					} else {
-						int tmp = (int)(kltable[fnum] - (3.000 * 2) * (7 - block));
-						tllTable[fnum][block][TL][KL] =
-						    (tmp <= 0) ?
-						    TL2EG(TL) :
-						    (unsigned int)((tmp >> (3 - KL)) / EG_STEP) + TL2EG(TL);
-					}
+			for (int KL = 0; KL < 4; ++KL) {
+				if (KL == 0) {
+					kslTable[fnum][block][KL] = 0;
+				} else {
+					int tmp = (int)(kltable[fnum] - (3.000 * 2) * (7 - block));
+					kslTable[fnum][block][KL] =
+					    (tmp <= 0) ?
+					    0 :
+					    (UINT8)((tmp >> (3 - KL)) / EG_STEP);
 				}
 			}
 		}
@@ -332,9 +311,9 @@ OpenYM2413_2::Patch::Patch(int n, const UINT8* data)
 //                                                            //
 //************************************************************//
 
-OpenYM2413_2::Slot::Slot(bool type)
+OpenYM2413_2::Slot::Slot(bool type_)
+	: patches(NULL), op(NULL), n(0), type(type_)
 {
-	reset(type);
 }
 
 void OpenYM2413_2::Slot::reset(bool type_)
@@ -342,22 +321,22 @@ void OpenYM2413_2::Slot::reset(bool type_)
 	type = type_;
     sintblIdx = 0;
 	sintbl = waveform[sintblIdx];
-	phase = 0;
-	dphase = 0;
-	output[0] = 0;
-	output[1] = 0;
-	feedback = 0;
-	eg_mode = FINISH;
-	eg_phase = EG_DP_WIDTH;
-	eg_dphase = 0;
+	op->phase[n] = 0;
+	op->dphase[n] = 0;
+	op->output[0][n] = 0;
+	op->output[1][n] = 0;
+	op->feedback[n] = 0;
+	op->eg_mode[n] = FINISH;
+	op->eg_phase[n] = EG_DP_WIDTH;
+	op->eg_dphase[n] = 0;
 	rks = 0;
 	tll = 0;
 	sustine = false;
 	fnum = 0;
 	block = 0;
 	volume = 0;
-	pgout = 0;
-	egout = 0;
+	op->pgout[n] = 0;
+	op->egout[n] = 0;
 	slot_on_flag = false;
 
     setPatch(NULL_PATCH_IDX);
@@ -366,13 +345,20 @@ void OpenYM2413_2::Slot::reset(bool type_)
 
 void OpenYM2413_2::Slot::updatePG()
 {
-	dphase = dphaseTable[fnum][block][patches[patchIdx].ML];
+	static const unsigned int mltable[16] = {
+		1,   1*2,  2*2,  3*2,  4*2,  5*2,  6*2,  7*2,
+		8*2, 9*2, 10*2, 10*2, 12*2, 12*2, 15*2, 15*2
+	};
+
+	op->dphase[n] = rate_adjust(((fnum * mltable[patches[patchIdx].ML]) << block) >>
+	                            (20 - DP_BITS),
+	                            dphaseRate);
 }
 
 void OpenYM2413_2::Slot::updateTLL()
 {
-	tll = type ? tllTable[fnum >> 5][block][volume]   [patches[patchIdx].KL]:
-	             tllTable[fnum >> 5][block][patches[patchIdx].TL][patches[patchIdx].KL];
+	tll = type ? TL2EG(volume) + kslTable[fnum >> 5][block][patches[patchIdx].KL]:
+	             TL2EG(patches[patchIdx].TL) + kslTable[fnum >> 5][block][patches[patchIdx].KL];
 }
 
 void OpenYM2413_2::Slot::updateRKS()
@@ -388,7 +374,9 @@ void OpenYM2413_2::Slot::updateWF()
 
 void OpenYM2413_2::Slot::updateEG()
 {
-	switch (eg_mode) {
+	unsigned int& eg_dphase = op->eg_dphase[n];
+
+	switch (op->eg_mode[n]) {
 	case ATTACK:
 		eg_dphase = dphaseARTable[patches[patchIdx].AR][rks];
 		break;
@@ -431,30 +419,30 @@ void OpenYM2413_2::Slot::updateAll()
 // Slot key on
 void OpenYM2413_2::Slot::slotOn()
 {
-	eg_mode = ATTACK;
-	eg_phase = 0;
-	phase = 0;
+	op->eg_mode[n] = ATTACK;
+	op->eg_phase[n] = 0;
+	op->phase[n] = 0;
 	updateEG();
 }
 
 // Slot key on, without resetting the phase
 void OpenYM2413_2::Slot::slotOn2()
 {
-	eg_mode = ATTACK;
-	eg_phase = 0;
+	op->eg_mode[n] = ATTACK;
+	op->eg_phase[n] = 0;
 	updateEG();
 }
 
 // Slot key off
 void OpenYM2413_2::Slot::slotOff()
 {
-	if (eg_mode == ATTACK) {
-		eg_phase = EXPAND_BITS(
+	if (op->eg_mode[n] == ATTACK) {
+		op->eg_phase[n] = EXPAND_BITS(
 			AR_ADJUST_TABLE[HIGHBITS(
-				eg_phase, EG_DP_BITS - EG_BITS)],
+				op->eg_phase[n], EG_DP_BITS - EG_BITS)],
 			EG_BITS, EG_DP_BITS);
 	}
-	eg_mode = RELEASE;
+	op->eg_mode[n] = RELEASE;
 	updateEG();
 }
 
@@ -480,9 +468,8 @@ void OpenYM2413_2::Slot::setVolume(int newVolume)
 
 
 OpenYM2413_2::Channel::Channel()
-	: mod(false), car(true)
+	: patch_number(0), mod(false), car(true)
 {
-	reset();
 }
 
 // reset channel
@@ -591,13 +578,17 @@ OpenYM2413_2::OpenYM2413_2(const string& name_, short volume, const UINT32& time
 		ch[i].patches = patches;
         ch[i].mod.patches = patches;
         ch[i].car.patches = patches;
+        ch[i].mod.op = &op;
+        ch[i].car.op = &op;
+        ch[i].mod.n = 2 * i + 0;
+        ch[i].car.n = 2 * i + 1;
 	}
 
 	makePmTable();
 	makeAmTable();
 	makeDB2LinTable();
 	makeAdjustTable();
-	makeTllTable();
+	makeKslTable();
 	makeRksTable();
 	makeSinTable();
 
@@ -624,8 +615,14 @@ void OpenYM2413_2::reset(const UINT32 &time)
 {
 	pm_phase = 0;
 	am_phase = 0;
+	lfo_pm = 0;
+	lfo_am = 0;
 	noise_seed = 0xFFFF;
 
+	for (int i = 0; i < 5; i++) {
+		in[i] = 0;
+	}
+
 	for(int i = 0; i < 9; i++) {
 		ch[i].reset();
 	}
@@ -637,11 +634,16 @@ void OpenYM2413_2::reset(const UINT32 &time)
 
 void OpenYM2413_2::setSampleRate(int sampleRate, int Oversampling)
 {
-	makeDphaseTable(sampleRate);
+	dphaseRate = sampleRate;
 	makeDphaseARTable(sampleRate);
 	makeDphaseDRTable(sampleRate);
 	pm_dphase = rate_adjust(PM_SPEED * PM_DP_WIDTH / (CLOCK_FREQ / 72), sampleRate);
 	am_dphase = rate_adjust(AM_SPEED * AM_DP_WIDTH / (CLOCK_FREQ / 72), sampleRate);
+
+	for (int i = 0; i < 9; i++) {
+		ch[i].mod.updateAll();
+		ch[i].car.updateAll();
+	}
 }
 
 
@@ -664,13 +666,13 @@ void OpenYM2413_2::update_rhythm_mode()
 	if (ch[6].patch_number & 0x10) {
 		if (!(ch[6].car.slot_on_flag ||
 		      (reg[0x0e] & 0x20))) {
-			ch[6].mod.eg_mode = FINISH;
-			ch[6].car.eg_mode = FINISH;
+			op.eg_mode[ch[6].mod.n] = FINISH;
+			op.eg_mode[ch[6].car.n] = FINISH;
 			ch[6].setPatch(reg[0x36] >> 4);
 		}
 	} else if (reg[0x0e] & 0x20) {
-		ch[6].mod.eg_mode = FINISH;
-		ch[6].car.eg_mode = FINISH;
+		op.eg_mode[ch[6].mod.n] = FINISH;
+		op.eg_mode[ch[6].car.n] = FINISH;
 		ch[6].setPatch(16);
 	}
 
@@ -678,14 +680,14 @@ void OpenYM2413_2::update_rhythm_mode()
 		if (!((ch[7].mod.slot_on_flag && ch[7].car.slot_on_flag) ||
 		      (reg[0x0e] & 0x20))) {
 			ch[7].mod.type = false;
-			ch[7].mod.eg_mode = FINISH;
-			ch[7].car.eg_mode = FINISH;
+			op.eg_mode[ch[7].mod.n] = FINISH;
+			op.eg_mode[ch[7].car.n] = FINISH;
 			ch[7].setPatch(reg[0x37] >> 4);
 		}
 	} else if (reg[0x0e] & 0x20) {
 		ch[7].mod.type = true;
-		ch[7].mod.eg_mode = FINISH;
-		ch[7].car.eg_mode = FINISH;
+		op.eg_mode[ch[7].mod.n] = FINISH;
+		op.eg_mode[ch[7].car.n] = FINISH;
 		ch[7].setPatch(17);
 	}
 
@@ -693,14 +695,14 @@ void OpenYM2413_2::update_rhythm_mode()
 		if (!((ch[8].mod.slot_on_flag && ch[8].car.slot_on_flag) ||
 		      (reg[0x0e] & 0x20))) {
 			ch[8].mod.type = false;
-			ch[8].mod.eg_mode = FINISH;
-			ch[8].car.eg_mode = FINISH;
+			op.eg_mode[ch[8].mod.n] = FINISH;
+			op.eg_mode[ch[8].car.n] = FINISH;
 			ch[8].setPatch(reg[0x38] >> 4);
 		}
 	} else if (reg[0x0e] & 0x20) {
 		ch[8].mod.type = true;
-		ch[8].mod.eg_mode = FINISH;
-		ch[8].car.eg_mode = FINISH;
+		op.eg_mode[ch[8].mod.n] = FINISH;
+		op.eg_mode[ch[8].car.n] = FINISH;
 		ch[8].setPatch(18);
 	}
 }
@@ -762,13 +764,33 @@ inline void OpenYM2413_2::update_ampm()
 // PG
 void OpenYM2413_2::Slot::calc_phase(int lfo_pm)
 {
+	unsigned int& phase = op->phase[n];
+
+	if (patches[patchIdx].PM) {
+		phase += (op->dphase[n] * lfo_pm) >> PM_AMP_BITS;
+	} else {
+		phase += op->dphase[n];
+	}
+	phase &= (DP_WIDTH - 1);
+	op->pgout[n] = HIGHBITS(phase, DP_BASE_BITS);
+}
+
+// PG of a silent slot, only the phase needs to advance
+void OpenYM2413_2::Slot::skip_phase(const int* lfo_pm, int length)
+{
+	unsigned int phase = op->phase[n];
+	unsigned int dphase = op->dphase[n];
+
 	if (patches[patchIdx].PM) {
-		phase += (dphase * lfo_pm) >> PM_AMP_BITS;
+		for (int i = 0; i < length; ++i) {
+			phase += (dphase * lfo_pm[i]) >> PM_AMP_BITS;
+		}
 	} else {
-		phase += dphase;
+		phase += dphase * length;
 	}
 	phase &= (DP_WIDTH - 1);
-	pgout = HIGHBITS(phase, DP_BASE_BITS);
+	op->phase[n] = phase;
+	op->pgout[n] = HIGHBITS(phase, DP_BASE_BITS);
 }
 
 // Update Noise unit
@@ -789,11 +811,14 @@ void OpenYM2413_2::Slot::calc_envelope(int lfo_am)
 		S2E(36.0), S2E(39.0), S2E(42.0), S2E(48.0)
 	};
 
+	int& eg_mode = op->eg_mode[n];
+	unsigned int& eg_phase = op->eg_phase[n];
 	unsigned out;
+
 	switch (eg_mode) {
 	case ATTACK:
 		out = AR_ADJUST_TABLE[HIGHBITS(eg_phase, EG_DP_BITS - EG_BITS)];
-		eg_phase += eg_dphase;
+		eg_phase += op->eg_dphase[n];
 		if ((EG_DP_WIDTH & eg_phase) || (patches[patchIdx].AR == 15)) {
 			out = 0;
 			eg_phase = 0;
@@ -803,7 +828,7 @@ void OpenYM2413_2::Slot::calc_envelope(int lfo_am)
 		break;
 	case DECAY:
 		out = HIGHBITS(eg_phase, EG_DP_BITS - EG_BITS);
-		eg_phase += eg_dphase;
+		eg_phase += op->eg_dphase[n];
 		if (eg_phase >= SL[patches[patchIdx].SL]) {
 			eg_phase = SL[patches[patchIdx].SL];
 			if (patches[patchIdx].EG) {
@@ -824,7 +849,7 @@ void OpenYM2413_2::Slot::calc_envelope(int lfo_am)
 	case SUSTINE:
 	case RELEASE:
 		out = HIGHBITS(eg_phase, EG_DP_BITS - EG_BITS);
-		eg_phase += eg_dphase;
+		eg_phase += op->eg_dphase[n];
 		if (out >= (1 << EG_BITS)) {
 			eg_mode = FINISH;
 			out = (1 << EG_BITS) - 1;
@@ -832,7 +857,7 @@ void OpenYM2413_2::Slot::calc_envelope(int lfo_am)
 		break;
 	case SETTLE:
 		out = HIGHBITS(eg_phase, EG_DP_BITS - EG_BITS);
-		eg_phase += eg_dphase;
+		eg_phase += op->eg_dphase[n];
 		if (out >= (1 << EG_BITS)) {
 			eg_mode = ATTACK;
 			out = (1 << EG_BITS) - 1;
@@ -853,64 +878,73 @@ void OpenYM2413_2::Slot::calc_envelope(int lfo_am)
 		out = DB_MUTE - 1;
 	}
 	
-	egout = out | 3;
+	op->egout[n] = out | 3;
 }
 
 // CARRIOR
 int OpenYM2413_2::Slot::calc_slot_car(int fm)
 {
+	int* output = op->output[0] + n;
+	unsigned int egout = op->egout[n];
+
 	if (egout >= (DB_MUTE - 1)) {
 		output[0] = 0;
 	} else {
-		output[0] = dB2LinTab[sintbl[(pgout + wave2_8pi(fm)) & (PG_WIDTH - 1)]
+		output[0] = dB2LinTab[sintbl[(op->pgout[n] + wave2_8pi(fm)) & (PG_WIDTH - 1)]
 		                       + egout];
 	}
-	output[1] = (output[1] + output[0]) >> 1;
-	return output[1];
+	op->output[1][n] = (op->output[1][n] + output[0]) >> 1;
+	return op->output[1][n];
 }
 
 // MODULATOR
 int OpenYM2413_2::Slot::calc_slot_mod()
 {
-	output[1] = output[0];
+	unsigned int egout = op->egout[n];
+	unsigned int pgout = op->pgout[n];
+	int& feedback = op->feedback[n];
+
+	op->output[1][n] = op->output[0][n];
 
 	if (egout >= (DB_MUTE - 1)) {
-		output[0] = 0;
+		op->output[0][n] = 0;
 	} else if (patches[patchIdx].FB != 0) {
 		int fm = wave2_4pi(feedback) >> (7 - patches[patchIdx].FB);
-		output[0] = dB2LinTab[sintbl[(pgout + fm) & (PG_WIDTH - 1)] + egout];
+		op->output[0][n] = dB2LinTab[sintbl[(pgout + fm) & (PG_WIDTH - 1)] + egout];
 	} else {
-		output[0] = dB2LinTab[sintbl[pgout] + egout];
+		op->output[0][n] = dB2LinTab[sintbl[pgout] + egout];
 	}
-	feedback = (output[1] + output[0]) >> 1;
+	feedback = (op->output[1][n] + op->output[0][n]) >> 1;
 	return feedback;
 }
 
 // TOM
 int OpenYM2413_2::Slot::calc_slot_tom()
 {
-	return (egout >= (DB_MUTE - 1))
+	return (op->egout[n] >= (DB_MUTE - 1))
 	     ? 0
-	     : dB2LinTab[sintbl[pgout] + egout];
+	     : dB2LinTab[sintbl[op->pgout[n]] + op->egout[n]];
 }
 
 // SNARE
 int OpenYM2413_2::Slot::calc_slot_snare(bool noise)
 {
-	if (egout >= (DB_MUTE - 1)) {
+	if (op->egout[n] >= (DB_MUTE - 1)) {
 		return 0;
 	} 
-	if (BIT(pgout, 7)) {
-		return dB2LinTab[(noise ? DB_POS(0.0) : DB_POS(15.0)) + egout];
+	if (BIT(op->pgout[n], 7)) {
+		return dB2LinTab[(noise ? DB_POS(0.0) : DB_POS(15.0)) + op->egout[n]];
 	} else {
-		return dB2LinTab[(noise ? DB_NEG(0.0) : DB_NEG(15.0)) + egout];
+		return dB2LinTab[(noise ? DB_NEG(0.0) : DB_NEG(15.0)) + op->egout[n]];
 	}
 }
 
 // TOP-CYM
 int OpenYM2413_2::Slot::calc_slot_cym(unsigned int pgout_hh)
 {
-	if (egout >= (DB_MUTE - 1)) {
+	unsigned int pgout = op->pgout[n];
+
+	if (op->egout[n] >= (DB_MUTE - 1)) {
 		return 0;
 	}
 	unsigned int dbout
@@ -919,13 +953,15 @@ int OpenYM2413_2::Slot::calc_slot_cym(unsigned int pgout_hh)
 	       (BIT(pgout, PG_BITS - 7) & !BIT(pgout, PG_BITS - 5)))
 	    ? DB_NEG(3.0)
 	    : DB_POS(3.0);
-	return dB2LinTab[dbout + egout];
+	return dB2LinTab[dbout + op->egout[n]];
 }
 
 // HI-HAT
 int OpenYM2413_2::Slot::calc_slot_hat(int pgout_cym, bool noise)
 {
-	if (egout >= (DB_MUTE - 1)) {
+	unsigned int pgout = op->pgout[n];
+
+	if (op->egout[n] >= (DB_MUTE - 1)) {
 		return 0;
 	}
 	unsigned int dbout;
@@ -936,7 +972,7 @@ int OpenYM2413_2::Slot::calc_slot_hat(int pgout_cym, bool noise)
 	} else {
 		dbout = noise ? DB_POS(12.0) : DB_POS(24.0);
 	}
-	return dB2LinTab[dbout + egout];
+	return dB2LinTab[dbout + op->egout[n]];
 }
 
 
@@ -950,59 +986,77 @@ int OpenYM2413_2::filter(int input) {
     return (0 * (in[0] + in[4]) + 1 * (in[3] + in[1]) + 2 * in[2]) / 4;
 }
 
-inline int OpenYM2413_2::calcSample()
+// Adds one block of a melodic channel to buf. A channel whose carrier
+// envelope has finished stays silent until the next key on, so only its
+// phase is advanced.
+inline void OpenYM2413_2::calcChannel(Channel& c, int* buf, int length)
 {
-	// while muted updated_ampm() and update_noise() aren't called, probably ok
-	update_ampm();
-	update_noise();
-
-	for (int i = 0; i < 9; ++i) {
-		ch[i].mod.calc_phase(lfo_pm);
-		ch[i].mod.calc_envelope(lfo_am);
-		ch[i].car.calc_phase(lfo_pm);
-		ch[i].car.calc_envelope(lfo_am);
+	if (op.eg_mode[c.car.n] == FINISH) {
+		c.mod.skip_phase(lfoPmBuf, length);
+		c.car.skip_phase(lfoPmBuf, length);
+		return;
 	}
 
-	int channelMask = 0;
-	for (int i = 0; i < 9; ++i) {
-		if (ch[i].car.eg_mode != FINISH) {
-			channelMask |= (1 << i);
+	for (int i = 0; i < length; ++i) {
+		c.mod.calc_phase(lfoPmBuf[i]);
+		c.mod.calc_envelope(lfoAmBuf[i]);
+		c.car.calc_phase(lfoPmBuf[i]);
+		c.car.calc_envelope(lfoAmBuf[i]);
+		if (op.eg_mode[c.car.n] != FINISH) {
+			buf[i] += c.car.calc_slot_car(c.mod.calc_slot_mod());
 		}
 	}
+}
 
-	int mix = 0;
-	if (ch[6].patch_number & 0x10) {
-		if (channelMask & (1 << 6)) {
-			mix += ch[6].car.calc_slot_car(ch[6].mod.calc_slot_mod());
-			channelMask &= ~(1 << 6);
-		}
-	}
-	if (ch[7].patch_number & 0x10) {
-		if (ch[7].mod.eg_mode != FINISH) {
-			mix += ch[7].mod.calc_slot_hat(ch[8].car.pgout, noise_seed & 1);
-		}
-		if (channelMask & (1 << 7)) {
-			mix -= ch[7].car.calc_slot_snare(noise_seed & 1);
-			channelMask &= ~(1 << 7);
-		}
-	}
-	if (ch[8].patch_number & 0x10) {
-		if (ch[8].mod.eg_mode != FINISH) {
-			mix += ch[8].mod.calc_slot_tom();
-		}
-		if (channelMask & (1 << 8)) {
-			mix -= ch[8].car.calc_slot_cym(ch[7].mod.pgout);
-			channelMask &= ~(1 << 8);
-		}
+// Adds one block of channels 7 and 8 to buf. In rhythm mode hi-hat and
+// cymbal use each others phase so the two channels run in lock step.
+inline void OpenYM2413_2::calcRhythm(int* buf, int length)
+{
+	Slot& hh  = ch[7].mod;
+	Slot& sd  = ch[7].car;
+	Slot& tom = ch[8].mod;
+	Slot& cym = ch[8].car;
+
+	if (op.eg_mode[hh.n] == FINISH && op.eg_mode[sd.n] == FINISH &&
+	    op.eg_mode[tom.n] == FINISH && op.eg_mode[cym.n] == FINISH) {
+		hh.skip_phase(lfoPmBuf, length);
+		sd.skip_phase(lfoPmBuf, length);
+		tom.skip_phase(lfoPmBuf, length);
+		cym.skip_phase(lfoPmBuf, length);
+		return;
 	}
-	mix *= 2;
 
-	for (Channel* cp = ch; channelMask; channelMask >>= 1, ++cp) {
-		if (channelMask & 1) {
-			mix += cp->car.calc_slot_car(cp->mod.calc_slot_mod());
+	for (int i = 0; i < length; ++i) {
+		hh.calc_phase(lfoPmBuf[i]);
+		hh.calc_envelope(lfoAmBuf[i]);
+		sd.calc_phase(lfoPmBuf[i]);
+		sd.calc_envelope(lfoAmBuf[i]);
+		tom.calc_phase(lfoPmBuf[i]);
+		tom.calc_envelope(lfoAmBuf[i]);
+		cym.calc_phase(lfoPmBuf[i]);
+		cym.calc_envelope(lfoAmBuf[i]);
+
+		if (ch[7].patch_number & 0x10) {
+			if (op.eg_mode[hh.n] != FINISH) {
+				rhythmBuf[i] += hh.calc_slot_hat(op.pgout[cym.n], noiseBuf[i]);
+			}
+			if (op.eg_mode[sd.n] != FINISH) {
+				rhythmBuf[i] -= sd.calc_slot_snare(noiseBuf[i]);
+			}
+		} else if (op.eg_mode[sd.n] != FINISH) {
+			buf[i] += sd.calc_slot_car(hh.calc_slot_mod());
+		}
+		if (ch[8].patch_number & 0x10) {
+			if (op.eg_mode[tom.n] != FINISH) {
+				rhythmBuf[i] += tom.calc_slot_tom();
+			}
+			if (op.eg_mode[cym.n] != FINISH) {
+				rhythmBuf[i] -= cym.calc_slot_cym(op.pgout[hh.n]);
+			}
+		} else if (op.eg_mode[cym.n] != FINISH) {
+			buf[i] += cym.calc_slot_car(tom.calc_slot_mod());
 		}
 	}
-	return filter((maxVolume * mix) >> (DB2LIN_AMP_BITS - 1)); 
 }
 
 void OpenYM2413_2::checkMute()
@@ -1012,18 +1066,18 @@ void OpenYM2413_2::checkMute()
 bool OpenYM2413_2::checkMuteHelper()
 {
 	for (int i = 0; i < 6; i++) {
-		if (ch[i].car.eg_mode != FINISH) return false;
+		if (op.eg_mode[ch[i].car.n] != FINISH) return false;
 	}
 	if (!(reg[0x0e] & 0x20)) {
 		for(int i = 6; i < 9; i++) {
-			 if (ch[i].car.eg_mode != FINISH) return false;
+			 if (op.eg_mode[ch[i].car.n] != FINISH) return false;
 		}
 	} else {
-		if (ch[6].car.eg_mode != FINISH) return false;
-		if (ch[7].mod.eg_mode != FINISH) return false;
-		if (ch[7].car.eg_mode != FINISH) return false;
-		if (ch[8].mod.eg_mode != FINISH) return false;
-		if (ch[8].car.eg_mode != FINISH) return false;
+		if (op.eg_mode[ch[6].car.n] != FINISH) return false;
+		if (op.eg_mode[ch[7].mod.n] != FINISH) return false;
+		if (op.eg_mode[ch[7].car.n] != FINISH) return false;
+		if (op.eg_mode[ch[8].mod.n] != FINISH) return false;
+		if (op.eg_mode[ch[8].car.n] != FINISH) return false;
 	}
 	return true;	// nothing is playing, then mute
 }
@@ -1032,8 +1086,34 @@ int* OpenYM2413_2::updateBuffer(int length)
 {
     int* buf = buffer;
 
-	while (length--) {
-		*(buf++) = calcSample();
+	while (length > 0) {
+		int count = length < BLOCK_SIZE ? length : BLOCK_SIZE;
+		int i;
+
+		// while muted updated_ampm() and update_noise() aren't called, probably ok
+		for (i = 0; i < count; ++i) {
+			update_ampm();
+			update_noise();
+			lfoPmBuf[i] = lfo_pm;
+			lfoAmBuf[i] = lfo_am;
+			noiseBuf[i] = noise_seed & 1;
+			rhythmBuf[i] = 0;
+			buf[i] = 0;
+		}
+
+		for (i = 0; i < 6; ++i) {
+			calcChannel(ch[i], buf, count);
+		}
+		// Bass drum is a regular channel, but mixed at rhythm volume
+		calcChannel(ch[6], (ch[6].patch_number & 0x10) ? rhythmBuf : buf, count);
+		calcRhythm(buf, count);
+
+		for (i = 0; i < count; ++i) {
+			buf[i] = filter((maxVolume * (2 * rhythmBuf[i] + buf[i])) >> (DB2LIN_AMP_BITS - 1));
+		}
+
+		buf    += count;
+		length -= count;
 	}
 	checkMute();
 
@@ -1307,19 +1387,10 @@ void OpenYM2413_2::loadState()
         ch[i].setPatch(ch[i].patch_number);
 
         sprintf(tag, "mod.output0%d", i);
-        ch[i].mod.output[0] = saveStateGet(state, tag, 0);
+        op.output[0][2 * i + 0] = saveStateGet(state, tag, 0);
 
         sprintf(tag, "mod.output1%d", i);
-        ch[i].mod.output[1] = saveStateGet(state, tag, 0);
-
-        sprintf(tag, "mod.output2%d", i);
-        ch[i].mod.output[2] = saveStateGet(state, tag, 0);
-
-        sprintf(tag, "mod.output3%d", i);
-        ch[i].mod.output[3] = saveStateGet(state, tag, 0);
-
-        sprintf(tag, "mod.output4%d", i);
-        ch[i].mod.output[4] = saveStateGet(state, tag, 0);
+        op.output[1][2 * i + 0] = saveStateGet(state, tag, 0);
 
         sprintf(tag, "mod.sintblIdx%d", i);
         ch[i].mod.sintblIdx = saveStateGet(state, tag, 0);
@@ -1332,13 +1403,13 @@ void OpenYM2413_2::loadState()
         ch[i].mod.slot_on_flag = 0 != saveStateGet(state, tag, 0);
 
         sprintf(tag, "mod.phase%d", i);
-        ch[i].mod.phase = saveStateGet(state, tag, 0);
+        op.phase[2 * i + 0] = saveStateGet(state, tag, 0);
 
         sprintf(tag, "mod.dphase%d", i);
-        ch[i].mod.dphase = saveStateGet(state, tag, 0);
+        op.dphase[2 * i + 0] = saveStateGet(state, tag, 0);
 
         sprintf(tag, "mod.pgout%d", i);
-        ch[i].mod.pgout = saveStateGet(state, tag, 0);
+        op.pgout[2 * i + 0] = saveStateGet(state, tag, 0);
 
         sprintf(tag, "mod.fnum%d", i);
         ch[i].mod.fnum = saveStateGet(state, tag, 0);
@@ -1359,32 +1430,23 @@ void OpenYM2413_2::loadState()
         ch[i].mod.rks = saveStateGet(state, tag, 0);
 
         sprintf(tag, "mod.eg_mode%d", i);
-        ch[i].mod.eg_mode = saveStateGet(state, tag, 0);
+        op.eg_mode[2 * i + 0] = saveStateGet(state, tag, 0);
 
         sprintf(tag, "mod.eg_phase%d", i);
-        ch[i].mod.eg_phase = saveStateGet(state, tag, 0);
+        op.eg_phase[2 * i + 0] = saveStateGet(state, tag, 0);
 
         sprintf(tag, "mod.eg_dphase%d", i);
-        ch[i].mod.eg_dphase = saveStateGet(state, tag, 0);
+        op.eg_dphase[2 * i + 0] = saveStateGet(state, tag, 0);
 
         sprintf(tag, "mod.egout%d", i);
-        ch[i].mod.egout = saveStateGet(state, tag, 0);
+        op.egout[2 * i + 0] = saveStateGet(state, tag, 0);
 
 
         sprintf(tag, "car.output0%d", i);
-        ch[i].car.output[0] = saveStateGet(state, tag, 0);
+        op.output[0][2 * i + 1] = saveStateGet(state, tag, 0);
 
         sprintf(tag, "car.output1%d", i);
-        ch[i].car.output[1] = saveStateGet(state, tag, 0);
-
-        sprintf(tag, "car.output2%d", i);
-        ch[i].car.output[2] = saveStateGet(state, tag, 0);
-
-        sprintf(tag, "car.output3%d", i);
-        ch[i].car.output[3] = saveStateGet(state, tag, 0);
-
-        sprintf(tag, "car.output4%d", i);
-        ch[i].car.output[4] = saveStateGet(state, tag, 0);
+        op.output[1][2 * i + 1] = saveStateGet(state, tag, 0);
 
         sprintf(tag, "car.sintblIdx%d", i);
         ch[i].car.sintblIdx = saveStateGet(state, tag, 0);
@@ -1397,13 +1459,13 @@ void OpenYM2413_2::loadState()
         ch[i].car.slot_on_flag = 0 != saveStateGet(state, tag, 0);
 
         sprintf(tag, "car.phase%d", i);
-        ch[i].car.phase = saveStateGet(state, tag, 0);
+        op.phase[2 * i + 1] = saveStateGet(state, tag, 0);
 
         sprintf(tag, "car.dphase%d", i);
-        ch[i].car.dphase = saveStateGet(state, tag, 0);
+        op.dphase[2 * i + 1] = saveStateGet(state, tag, 0);
 
         sprintf(tag, "car.pgout%d", i);
-        ch[i].car.pgout = saveStateGet(state, tag, 0);
+        op.pgout[2 * i + 1] = saveStateGet(state, tag, 0);
 
         sprintf(tag, "car.fnum%d", i);
         ch[i].car.fnum = saveStateGet(state, tag, 0);
@@ -1424,16 +1486,16 @@ void OpenYM2413_2::loadState()
         ch[i].car.rks = saveStateGet(state, tag, 0);
 
         sprintf(tag, "car.eg_mode%d", i);
-        ch[i].car.eg_mode = saveStateGet(state, tag, 0);
+        op.eg_mode[2 * i + 1] = saveStateGet(state, tag, 0);
 
         sprintf(tag, "car.eg_phase%d", i);
-        ch[i].car.eg_phase = saveStateGet(state, tag, 0);
+        op.eg_phase[2 * i + 1] = saveStateGet(state, tag, 0);
 
         sprintf(tag, "car.eg_dphase%d", i);
-        ch[i].car.eg_dphase = saveStateGet(state, tag, 0);
+        op.eg_dphase[2 * i + 1] = saveStateGet(state, tag, 0);
 
         sprintf(tag, "car.egout%d", i);
-        ch[i].car.egout = saveStateGet(state, tag, 0);
+        op.egout[2 * i + 1] = saveStateGet(state, tag, 0);
     }
 
     saveStateClose(state);
@@ -1504,19 +1566,10 @@ void OpenYM2413_2::saveState()
         saveStateSet(state, tag, ch[i].patch_number);
 
         sprintf(tag, "mod.output0%d", i);
-        saveStateSet(state, tag, ch[i].mod.output[0]);
+        saveStateSet(state, tag, op.output[0][2 * i + 0]);
 
         sprintf(tag, "mod.output1%d", i);
-        saveStateSet(state, tag, ch[i].mod.output[1]);
-
-        sprintf(tag, "mod.output2%d", i);
-        saveStateSet(state, tag, ch[i].mod.output[2]);
-
-        sprintf(tag, "mod.output3%d", i);
-        saveStateSet(state, tag, ch[i].mod.output[3]);
-
-        sprintf(tag, "mod.output4%d", i);
-        saveStateSet(state, tag, ch[i].mod.output[4]);
+        saveStateSet(state, tag, op.output[1][2 * i + 0]);
 
         sprintf(tag, "mod.sintblIdx%d", i);
         saveStateSet(state, tag, ch[i].mod.sintblIdx);
@@ -1528,13 +1581,13 @@ void OpenYM2413_2::saveState()
         saveStateSet(state, tag, ch[i].mod.slot_on_flag);
 
         sprintf(tag, "mod.phase%d", i);
-        saveStateSet(state, tag, ch[i].mod.phase);
+        saveStateSet(state, tag, op.phase[2 * i + 0]);
 
         sprintf(tag, "mod.dphase%d", i);
-        saveStateSet(state, tag, ch[i].mod.dphase);
+        saveStateSet(state, tag, op.dphase[2 * i + 0]);
 
         sprintf(tag, "mod.pgout%d", i);
-        saveStateSet(state, tag, ch[i].mod.pgout);
+        saveStateSet(state, tag, op.pgout[2 * i + 0]);
 
         sprintf(tag, "mod.fnum%d", i);
         saveStateSet(state, tag, ch[i].mod.fnum);
@@ -1555,32 +1608,23 @@ void OpenYM2413_2::saveState()
         saveStateSet(state, tag, ch[i].mod.rks);
 
         sprintf(tag, "mod.eg_mode%d", i);
-        saveStateSet(state, tag, ch[i].mod.eg_mode);
+        saveStateSet(state, tag, op.eg_mode[2 * i + 0]);
 
         sprintf(tag, "mod.eg_phase%d", i);
-        saveStateSet(state, tag, ch[i].mod.eg_phase);
+        saveStateSet(state, tag, op.eg_phase[2 * i + 0]);
 
         sprintf(tag, "mod.eg_dphase%d", i);
-        saveStateSet(state, tag, ch[i].mod.eg_dphase);
+        saveStateSet(state, tag, op.eg_dphase[2 * i + 0]);
 
         sprintf(tag, "mod.egout%d", i);
-        saveStateSet(state, tag, ch[i].mod.egout);
+        saveStateSet(state, tag, op.egout[2 * i + 0]);
 
 
         sprintf(tag, "car.output0%d", i);
-        saveStateSet(state, tag, ch[i].car.output[0]);
+        saveStateSet(state, tag, op.output[0][2 * i + 1]);
 
         sprintf(tag, "car.output1%d", i);
-        saveStateSet(state, tag, ch[i].car.output[1]);
-
-        sprintf(tag, "car.output2%d", i);
-        saveStateSet(state, tag, ch[i].car.output[2]);
-
-        sprintf(tag, "car.output3%d", i);
-        saveStateSet(state, tag, ch[i].car.output[3]);
-
-        sprintf(tag, "car.output4%d", i);
-        saveStateSet(state, tag, ch[i].car.output[4]);
+        saveStateSet(state, tag, op.output[1][2 * i + 1]);
 
         sprintf(tag, "car.sintblIdx%d", i);
         saveStateSet(state, tag, ch[i].car.sintblIdx);
@@ -1592,13 +1636,13 @@ void OpenYM2413_2::saveState()
         saveStateSet(state, tag, ch[i].car.slot_on_flag);
 
         sprintf(tag, "car.phase%d", i);
-        saveStateSet(state, tag, ch[i].car.phase);
+        saveStateSet(state, tag, op.phase[2 * i + 1]);
 
         sprintf(tag, "car.dphase%d", i);
-        saveStateSet(state, tag, ch[i].car.dphase);
+        saveStateSet(state, tag, op.dphase[2 * i + 1]);
 
         sprintf(tag, "car.pgout%d", i);
-        saveStateSet(state, tag, ch[i].car.pgout);
+        saveStateSet(state, tag, op.pgout[2 * i + 1]);
 
         sprintf(tag, "car.fnum%d", i);
         saveStateSet(state, tag, ch[i].car.fnum);
@@ -1619,16 +1663,16 @@ void OpenYM2413_2::saveState()
         saveStateSet(state, tag, ch[i].car.rks);
 
         sprintf(tag, "car.eg_mode%d", i);
-        saveStateSet(state, tag, ch[i].car.eg_mode);
+        saveStateSet(state, tag, op.eg_mode[2 * i + 1]);
 
         sprintf(tag, "car.eg_phase%d", i);
-        saveStateSet(state, tag, ch[i].car.eg_phase);
+        saveStateSet(state, tag, op.eg_phase[2 * i + 1]);
 
         sprintf(tag, "car.eg_dphase%d", i);
-        saveStateSet(state, tag, ch[i].car.eg_dphase);
+        saveStateSet(state, tag, op.eg_dphase[2 * i + 1]);
 
         sprintf(tag, "car.egout%d", i);
-        saveStateSet(state, tag, ch[i].car.egout);
+        saveStateSet(state, tag, op.egout[2 * i + 1]);
     }
 
     saveStateClose(state);
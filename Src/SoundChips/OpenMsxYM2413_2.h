@@ -149,6 +149,20 @@ class OpenYM2413_2 : public OpenYM2413Base
 		UINT8 RR; // 0-15
 	};
 	
+	// Generator state of all 18 operators in structure-of-arrays layout.
+	// Operator 2 * n is the modulator and 2 * n + 1 the carrier of channel n.
+	struct Operators {
+		unsigned int phase[18];		// Phase
+		unsigned int dphase[18];	// Phase increment amount
+		unsigned int pgout[18];		// PG output
+		int eg_mode[18];		// Current envelope state
+		unsigned int eg_phase[18];	// Envelope phase
+		unsigned int eg_dphase[18];	// Envelope phase increment amount
+		unsigned int egout[18];		// EG output
+		int output[2][18];		// Output values of slot
+		int feedback[18];
+	};
+
 	class Slot {
 	public:
 		Slot(bool type);
@@ -160,6 +174,7 @@ class OpenYM2413_2 : public OpenYM2413Base
 		inline void setPatch(int idx);
 		inline void setVolume(int volume);
 		inline void calc_phase(int lfo_pm);
+		inline void skip_phase(const int* lfo_pm, int length);
 		inline void calc_envelope(int lfo_am);
 		inline int calc_slot_car(int fm);
 		inline int calc_slot_mod();
@@ -179,20 +194,15 @@ class OpenYM2413_2 : public OpenYM2413Base
 		inline static int SL2EG(int d);
 	
 		Patch* patches;
+		Operators* op;	// Generator state, this slot is op[n]
+		int n;
         int patchIdx;
 		bool type;		// 0 : modulator 1 : carrier 
 		bool slot_on_flag;
 
-		// OUTPUT
-		int feedback;
-		int output[5];	// Output value of slot 
-
 		// for Phase Generator (PG)
 		UINT16* sintbl;		// Wavetable
         int sintblIdx;
-		unsigned int phase;	// Phase 
-		unsigned int dphase;	// Phase increment amount 
-		unsigned int pgout;	// output
 
 		// for Envelope Generator (EG)
 		int fnum;		// F-Number
@@ -201,10 +211,6 @@ class OpenYM2413_2 : public OpenYM2413Base
 		int sustine;		// Sustine 1 = ON, 0 = OFF
 		int tll;		// Total Level + Key scale level
 		int rks;		// Key scale offset (Rks)
-		int eg_mode;		// Current state
-		unsigned int eg_phase;	// Phase
-		unsigned int eg_dphase;	// Phase increment amount
-		unsigned egout;		// output
 	};
 	friend class Slot;
 	
@@ -244,7 +250,8 @@ public:
     virtual void saveState();
 
 private:
-	inline int calcSample();
+	inline void calcChannel(Channel& c, int* buf, int length);
+	inline void calcRhythm(int* buf, int length);
 
 	void checkMute();
 	bool checkMuteHelper();
@@ -254,8 +261,7 @@ private:
 	static int lin2db(DoubleT d);
 	static void makePmTable();
 	static void makeAmTable();
-	static void makeDphaseTable(int sampleRate);
-	static void makeTllTable();
+	static void makeKslTable();
 	static void makeDphaseARTable(int sampleRate);
 	static void makeDphaseDRTable(int sampleRate);
 	static void makeRksTable();
@@ -306,6 +312,16 @@ private:
 
         int in[5];
 
+	// Samples are generated in blocks, LFO and noise are computed
+	// up front for the whole block
+	static const int BLOCK_SIZE = 64;
+	int lfoPmBuf[BLOCK_SIZE];
+	int lfoAmBuf[BLOCK_SIZE];
+	int noiseBuf[BLOCK_SIZE];
+	int rhythmBuf[BLOCK_SIZE];
+
+	Operators op;
+
 	// CHECK check with orig code header file line 98-104
 	
 	// Channel & Slot
@@ -321,8 +337,6 @@ private:
 	static UINT16 fullsintable[PG_WIDTH];
 	static UINT16 halfsintable[PG_WIDTH];
 
-	static unsigned int dphaseNoiseTable[512][8];
-
 	static UINT16* waveform[2];
 
 	// LFO Table
@@ -344,12 +358,12 @@ private:
     // Phase incr table for Decay and Release
     static unsigned int dphaseDRTable[16][16];
 
-    // KSL + TL Table
-    static unsigned int tllTable[16][8][1 << TL_BITS][4];
+    // Key scale level table, total level is added at run time
+    static UINT8 kslTable[16][8][4];
     static int rksTable[2][8][2];
 
-    // Phase incr table for PG 
-    static unsigned int dphaseTable[512][8][16];
+    // Sample rate used for the phase increment of the PG
+    static int dphaseRate;
 
 	const std::string name;
 
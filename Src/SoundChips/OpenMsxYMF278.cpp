@@ -7,6 +7,7 @@
 
 #include <stdio.h>
 #include <cmath>
+#include <algorithm>
 #include <cstring>
 #include <stdlib.h>
 
@@ -779,6 +780,8 @@ YMF278::YMF278(short volume, int ramSize, void* romData, int romSize,
     this->ramSize = ramSize;
 	rom = (UINT8*)romData;
     ram = (UINT8*)calloc(1, ramSize);
+    ramPages = (ramSize + (1 << RAM_PAGE_BITS) - 1) >> RAM_PAGE_BITS;
+    ramDirty = (UINT8*)calloc(1, ramPages);
 
     oplOversampling = 1;
 
@@ -790,7 +793,7 @@ YMF278::YMF278(short volume, int ramSize, void* romData, int romSize,
 YMF278::~YMF278()
 {
 	free(ram);
-	free(rom);
+	free(ramDirty);
 }
 
 void YMF278::reset(const UINT32 &time)
@@ -848,12 +851,39 @@ void YMF278::writeMem(unsigned int address, UINT8 value)
 		// can't write to ROM
 	} else if (address < endRam) {
 		ram[address - endRom] = value;
+		ramDirty[(address - endRom) >> RAM_PAGE_BITS] = 1;
 	} else {
 		// can't write to unmapped memory
 	}
 }
 
 
+void YMF278::loadRamPages(SaveState* state)
+{
+    for (int i = 0; i < ramPages; i++) {
+        if (ramDirty[i]) {
+            char tag[32];
+            int offset = i << RAM_PAGE_BITS;
+
+            sprintf(tag, "ram%d", i);
+            saveStateGetBuffer(state, tag, ram + offset, std::min(1 << RAM_PAGE_BITS, ramSize - offset));
+        }
+    }
+}
+
+void YMF278::saveRamPages(SaveState* state)
+{
+    for (int i = 0; i < ramPages; i++) {
+        if (ramDirty[i]) {
+            char tag[32];
+            int offset = i << RAM_PAGE_BITS;
+
+            sprintf(tag, "ram%d", i);
+            saveStateSetBuffer(state, tag, ram + offset, std::min(1 << RAM_PAGE_BITS, ramSize - offset));
+        }
+    }
+}
+
 //REMEMBER TO SAVE RAM
 void YMF278::loadState()
 {
@@ -881,7 +911,17 @@ void YMF278::loadState()
     BUSY_Time         = saveStateGet(state, "BUSY_Time",         0);
 
     saveStateGetBuffer(state, "regs", regs, sizeof(regs));
-    saveStateGetBuffer(state, "ram", ram, ramSize);
+    if (saveStateGet(state, "ramPageBits", 0) == RAM_PAGE_BITS) {
+        memset(ram, 0, ramSize);
+        memset(ramDirty, 0, ramPages);
+        saveStateGetBuffer(state, "ramDirty", ramDirty, ramPages);
+        loadRamPages(state);
+    }
+    else {
+        // Older states carry the complete sample RAM
+        saveStateGetBuffer(state, "ram", ram, ramSize);
+        memset(ramDirty, 1, ramPages);
+    }
 
     for (int i = 0; i < 24; i++) {
         char tag[32];
@@ -1018,7 +1058,9 @@ void YMF278::saveState()
     saveStateSet(state, "BUSY_Time",         BUSY_Time);
 
     saveStateSetBuffer(state, "regs", regs, sizeof(regs));
-    saveStateSetBuffer(state, "ram", ram, ramSize);
+    saveStateSet(state, "ramPageBits", RAM_PAGE_BITS);
+    saveStateSetBuffer(state, "ramDirty", ramDirty, ramPages);
+    saveRamPages(state);
 
     for (int i = 0; i < 24; i++) {
         char tag[32];
@@ -128,11 +128,19 @@ class YMF278 : public SoundDevice
 		void checkMute();
 		bool anyActive();
 		void keyOnHelper(YMF278Slot& slot);
+		void loadRamPages(struct SaveState* state);
+		void saveRamPages(struct SaveState* state);
 
 		int buffer[AUDIO_STEREO_BUFFER_SIZE];
-		UINT8* rom;
+		UINT8* rom;	// Not owned, may be a shared read-only mapping
 		UINT8* ram;
 
+		// Sample RAM pages written since power on. Only those are
+		// stored in save states.
+		static const int RAM_PAGE_BITS = 12;
+		UINT8* ramDirty;
+		int ramPages;
+
         int oplOversampling;
 		DoubleT freqbase;
 
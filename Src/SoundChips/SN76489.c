@@ -124,8 +124,14 @@ void sn76489LoadState(SN76489* sn76489)
 
         sprintf(tag, "toneFlipFlop%d", i);
         sn76489->toneFlipFlop[i] = saveStateGet(state, tag, 0);
+
+        sn76489->toneInterpol[i] = 0;
     }
 
+    // Saving must not disturb the running chip, the sub-sample state
+    // is reset when the state is loaded instead
+    sn76489->clock = 0;
+
     saveStateClose(state);
 }
 
@@ -154,12 +160,8 @@ void sn76489SaveState(SN76489* sn76489)
 
         sprintf(tag, "toneFlipFlop%d", i);
         saveStateSet(state, tag, sn76489->toneFlipFlop[i]);
-        
-        sn76489->toneInterpol[i] = 0;
     }
 
-    sn76489->clock = 0;
-
     saveStateClose(state);
 }
 
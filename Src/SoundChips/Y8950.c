@@ -350,6 +350,7 @@ void y8950SetSampleRate(void* ref, UInt32 rate)
 {
     Y8950* y8950 = (Y8950*)ref;
     y8950->rate = rate;
+    OPLSetOversampling(y8950->opl, mixerGetChannelOversampling(y8950->mixer, y8950->handle, boardGetY8950Oversampling()));
 }
 
 Y8950* y8950Create(Mixer* mixer)
@@ -368,13 +369,12 @@ Y8950* y8950Create(Mixer* mixer)
     y8950->ykIo = ykIoCreate();
 
     y8950->handle = mixerRegisterChannel(mixer, MIXER_CHANNEL_MSXAUDIO, 0, y8950Sync, y8950SetSampleRate, y8950);
+    mixerSetChannelNativeRate(mixer, y8950->handle, SAMPLERATE);
 
     y8950->opl = OPLCreate(OPL_TYPE_Y8950, FREQUENCY, SAMPLERATE, 256, y8950);
-    OPLSetOversampling(y8950->opl, boardGetY8950Oversampling());
+    y8950SetSampleRate(y8950, mixerGetChannelSampleRate(mixer, y8950->handle));
     OPLResetChip(y8950->opl);
 
-	y8950->rate = mixerGetSampleRate(mixer);
-
     return y8950;
 }
 
@@ -199,6 +199,16 @@ static Int32* ym2151Sync(void* ref, UInt32 count)
     YM2151* ym2151 = (YM2151*)ref;
     UInt32 i;
 
+    if (ym2151->rate >= SAMPLERATE) {
+        for (i = 0; i < count; i++) {
+            Int16 sl, sr;
+            YM2151UpdateOne(ym2151->opl, &sl, &sr, 1);
+            ym2151->buffer[2*i+0] = 11*(Int32)sl;
+            ym2151->buffer[2*i+1] = 11*(Int32)sr;
+        }
+        return ym2151->buffer;
+    }
+
     for (i = 0; i < count; i++) {
         Int16 sl, sr;
         ym2151->off -= SAMPLERATE - ym2151->rate;
@@ -319,10 +329,11 @@ YM2151* ym2151Create(Mixer* mixer)
     ym2151->timer2 = boardTimerCreate(onTimeout2, ym2151);
 
     ym2151->handle = mixerRegisterChannel(mixer, MIXER_CHANNEL_YAMAHA_SFG, 1, ym2151Sync, ym2151SetSampleRate, ym2151);
+    mixerSetChannelNativeRate(mixer, ym2151->handle, SAMPLERATE);
 
     ym2151->opl = YM2151Create(ym2151, FREQUENCY, SAMPLERATE);
     
-    ym2151->rate = mixerGetSampleRate(mixer);
+    ym2151->rate = mixerGetChannelSampleRate(mixer, ym2151->handle);
 
     ym2151Reset(ym2151);
 
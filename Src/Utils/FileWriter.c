@@ -0,0 +1,352 @@
+/*****************************************************************************
+** File: FileWriter.c
+**
+** More info: http://www.bluemsx.com
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+**
+******************************************************************************
+*/
+#include "FileWriter.h"
+#include "ArchThread.h"
+#include "ArchEvent.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#if defined(_WIN32) && !defined(_XBOX)
+#include <windows.h>
+#endif
+
+// PacketFileSystem.h Need to be included after all other includes
+#include "PacketFileSystem.h"
+
+// Writes are queued in order and done by a single worker thread, so writes
+// to the same file are applied in the order they were made. Without threads
+// the writes are done immediately by the caller.
+
+typedef struct FileWriterJob {
+    struct FileWriterJob* next;
+    char   fileName[512];
+    int    offset;
+    int    length;
+    UInt8* data;
+} FileWriterJob;
+
+static FileWriterJob* jobHead;
+static FileWriterJob* jobTail;
+static FileWriterJob* jobActive;
+static void* writerThread;
+static void* writerLock;
+static void* writerWork;
+static void* writerDone;
+static int   writerStop;
+
+// Consecutive patches of the same file reuse the open file
+static FILE* patchFile;
+static char  patchFileName[512];
+
+static void fileWriterClosePatchFile()
+{
+    if (patchFile != NULL) {
+        fclose(patchFile);
+        patchFile = NULL;
+    }
+}
+
+// Replaces a file in one step so there is always a complete copy of it
+// on disk. rename doesn't replace an existing file on Windows.
+static int fileWriterReplace(const char* from, const char* to)
+{
+#if defined(_WIN32) && !defined(_XBOX)
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+#ifdef _WIN32
+    remove(to);
+#endif
+    return rename(from, to) == 0;
+#endif
+}
+
+static void fileWriterRun(FileWriterJob* job)
+{
+    FILE* file;
+
+    if (patchFile != NULL && (job->offset < 0 || strcmp(patchFileName, job->fileName) != 0)) {
+        fileWriterClosePatchFile();
+    }
+
+    if (job->offset >= 0) {
+        if (patchFile == NULL) {
+            patchFile = fopen(job->fileName, "r+b");
+            strcpy(patchFileName, job->fileName);
+        }
+        if (patchFile != NULL) {
+            if (0 == fseek(patchFile, job->offset, SEEK_SET)) {
+                fwrite(job->data, 1, job->length, patchFile);
+            }
+            // Readers may access the file as soon as the job is done
+            fflush(patchFile);
+        }
+    }
+    else {
+        char tmpName[520];
+        int ok;
+
+        sprintf(tmpName, "%s.tmp", job->fileName);
+        file = fopen(tmpName, "wb");
+        if (file == NULL) {
+            return;
+        }
+
+        ok = fwrite(job->data, 1, job->length, file) == (size_t)job->length;
+        if (fclose(file) != 0) {
+            ok = 0;
+        }
+
+        if (ok) {
+            ok = fileWriterReplace(tmpName, job->fileName);
+        }
+        if (!ok) {
+            remove(tmpName);
+        }
+    }
+}
+
+static void fileWriterJobDestroy(FileWriterJob* job)
+{
+    free(job->data);
+    free(job);
+}
+
+static void fileWriterThread()
+{
+    for (;;) {
+        FileWriterJob* job;
+
+        archSemaphoreWait(writerLock, -1);
+        job = jobHead;
+        if (job != NULL) {
+            jobHead = job->next;
+            if (jobHead == NULL) {
+                jobTail = NULL;
+            }
+        }
+        jobActive = job;
+        if (job == NULL && writerStop) {
+            archSemaphoreSignal(writerLock);
+            return;
+        }
+        archSemaphoreSignal(writerLock);
+
+        if (job == NULL) {
+            archEventWait(writerWork, -1);
+            continue;
+        }
+
+        fileWriterRun(job);
+
+        archSemaphoreWait(writerLock, -1);
+        if (jobHead == NULL) {
+            fileWriterClosePatchFile();
+        }
+        jobActive = NULL;
+        archSemaphoreSignal(writerLock);
+
+        fileWriterJobDestroy(job);
+        archEventSet(writerDone);
+    }
+}
+
+static int fileWriterStart()
+{
+    if (writerThread != NULL) {
+        return 1;
+    }
+
+    writerLock = archSemaphoreCreate(1);
+    writerWork = archEventCreate(0);
+    writerDone = archEventCreate(0);
+    writerStop = 0;
+
+    writerThread = archThreadCreate(fileWriterThread, THREAD_PRIO_NORMAL);
+    if (writerThread == NULL) {
+        archSemaphoreDestroy(writerLock);
+        archEventDestroy(writerWork);
+        archEventDestroy(writerDone);
+        writerLock = NULL;
+        writerWork = NULL;
+        writerDone = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+static void fileWriterQueue(FileWriterJob* job)
+{
+    FileWriterJob* last = NULL;
+    FileWriterJob* j;
+
+    if (!fileWriterStart()) {
+        fileWriterRun(job);
+        fileWriterClosePatchFile();
+        fileWriterJobDestroy(job);
+        return;
+    }
+
+    archSemaphoreWait(writerLock, -1);
+
+    // A full save can replace a pending save of the same file as long as
+    // nothing else was queued for the file after it
+    if (job->offset < 0) {
+        for (j = jobHead; j != NULL; j = j->next) {
+            if (strcmp(j->fileName, job->fileName) == 0) {
+                last = j;
+            }
+        }
+    }
+
+    if (last != NULL && last->offset < 0) {
+        free(last->data);
+        last->data   = job->data;
+        last->length = job->length;
+        free(job);
+    }
+    else {
+        job->next = NULL;
+        if (jobTail != NULL) {
+            jobTail->next = job;
+        }
+        else {
+            jobHead = job;
+        }
+        jobTail = job;
+    }
+
+    archSemaphoreSignal(writerLock);
+    archEventSet(writerWork);
+}
+
+static FileWriterJob* fileWriterJobCreate(const char* fileName, int offset, int length)
+{
+    FileWriterJob* job = (FileWriterJob*)calloc(1, sizeof(FileWriterJob));
+
+    strncpy(job->fileName, fileName, sizeof(job->fileName) - 1);
+    job->offset = offset;
+    job->length = length;
+    job->data   = (UInt8*)malloc(length > 0 ? length : 1);
+
+    return job;
+}
+
+void fileWriterSave(const char* fileName, const void* header, int headerLength,
+                    const void* data, int length)
+{
+    FileWriterJob* job;
+
+    if (headerLength < 0) {
+        headerLength = 0;
+    }
+
+    job = fileWriterJobCreate(fileName, -1, headerLength + length);
+    if (headerLength > 0) {
+        memcpy(job->data, header, headerLength);
+    }
+    memcpy(job->data + headerLength, data, length);
+
+    fileWriterQueue(job);
+}
+
+void fileWriterPatch(const char* fileName, int offset, const void* data, int length)
+{
+    FileWriterJob* job = fileWriterJobCreate(fileName, offset, length);
+
+    memcpy(job->data, data, length);
+
+    fileWriterQueue(job);
+}
+
+// A negative length matches any part of the file
+static int fileWriterJobMatches(FileWriterJob* job, const char* fileName, int offset, int length)
+{
+    if (job == NULL) {
+        return 0;
+    }
+    if (fileName != NULL && strcmp(job->fileName, fileName) != 0) {
+        return 0;
+    }
+    if (length < 0 || job->offset < 0) {
+        return 1;
+    }
+    return job->offset < offset + length && offset < job->offset + job->length;
+}
+
+static int fileWriterPending(const char* fileName, int offset, int length)
+{
+    FileWriterJob* job;
+    int pending;
+
+    archSemaphoreWait(writerLock, -1);
+    pending = fileWriterJobMatches(jobActive, fileName, offset, length);
+    for (job = jobHead; job != NULL && !pending; job = job->next) {
+        pending = fileWriterJobMatches(job, fileName, offset, length);
+    }
+    archSemaphoreSignal(writerLock);
+
+    return pending;
+}
+
+void fileWriterWaitRange(const char* fileName, int offset, int length)
+{
+    if (writerThread == NULL) {
+        return;
+    }
+
+    while (fileWriterPending(fileName, offset, length)) {
+        archEventWait(writerDone, -1);
+    }
+}
+
+void fileWriterWait(const char* fileName)
+{
+    fileWriterWaitRange(fileName, 0, -1);
+}
+
+void fileWriterFlush()
+{
+    fileWriterWaitRange(NULL, 0, -1);
+}
+
+void fileWriterShutdown()
+{
+    if (writerThread == NULL) {
+        return;
+    }
+
+    archSemaphoreWait(writerLock, -1);
+    writerStop = 1;
+    archSemaphoreSignal(writerLock);
+    archEventSet(writerWork);
+
+    // The thread finishes the queue before it exits
+    archThreadDestroy(writerThread);
+    writerThread = NULL;
+
+    archSemaphoreDestroy(writerLock);
+    archEventDestroy(writerWork);
+    archEventDestroy(writerDone);
+    writerLock = NULL;
+    writerWork = NULL;
+    writerDone = NULL;
+}
@@ -0,0 +1,51 @@
+/*****************************************************************************
+** File: FileWriter.h
+**
+** More info: http://www.bluemsx.com
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+**
+******************************************************************************
+*/
+#ifndef FILE_WRITER_H
+#define FILE_WRITER_H
+
+#include "MsxTypes.h"
+
+// Background writer for save data. The data is copied when a write is
+// queued, so the caller may modify or free its buffer right away.
+
+// Replaces the whole file. The new contents are written to a temporary
+// file that is renamed over the old one. A queued save of the same file
+// that hasn't started yet is replaced.
+void fileWriterSave(const char* fileName, const void* header, int headerLength,
+                    const void* data, int length);
+
+// Writes data at an offset in an existing file.
+void fileWriterPatch(const char* fileName, int offset, const void* data, int length);
+
+// Waits until all queued writes to the file are done.
+void fileWriterWait(const char* fileName);
+
+// Waits until the queued writes that touch a part of the file are done.
+void fileWriterWaitRange(const char* fileName, int offset, int length);
+
+// Waits until all queued writes are done.
+void fileWriterFlush();
+
+// Flushes and stops the writer thread. It is restarted by the next write.
+void fileWriterShutdown();
+
+#endif
@@ -0,0 +1,167 @@
+/*****************************************************************************
+** File: FrameStats.c
+**
+** More info: http://www.bluemsx.com
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+**
+******************************************************************************
+*/
+#include "FrameStats.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef struct {
+    UInt32 phaseTime[FRAME_PHASE_COUNT];
+    UInt32 samples;
+    int    underrun;
+} FrameRecord;
+
+static FrameRecord* records;
+static UInt32*      sorted;
+static int          maxRecords;
+static int          first;
+static int          count;
+
+static const char* phaseNames[FRAME_PHASE_COUNT] = { "emulation", "mixer", "video" };
+
+void frameStatsReset(int maxFrames)
+{
+    if (maxFrames != maxRecords) {
+        frameStatsDestroy();
+        if (maxFrames > 0) {
+            records = (FrameRecord*)malloc(maxFrames * sizeof(FrameRecord));
+            sorted  = (UInt32*)malloc(maxFrames * sizeof(UInt32));
+            maxRecords = maxFrames;
+        }
+    }
+    first = 0;
+    count = 0;
+}
+
+void frameStatsDestroy()
+{
+    free(records);
+    free(sorted);
+    records    = NULL;
+    sorted     = NULL;
+    maxRecords = 0;
+    first      = 0;
+    count      = 0;
+}
+
+void frameStatsAdd(const UInt32* phaseTime, UInt32 samples, int underrun)
+{
+    FrameRecord* record;
+    int i;
+
+    if (maxRecords == 0) {
+        return;
+    }
+
+    if (count == maxRecords) {
+        first = (first + 1) % maxRecords;
+        count--;
+    }
+
+    record = &records[(first + count) % maxRecords];
+    for (i = 0; i < FRAME_PHASE_COUNT; i++) {
+        record->phaseTime[i] = phaseTime[i];
+    }
+    record->samples  = samples;
+    record->underrun = underrun;
+    count++;
+}
+
+int frameStatsGetCount()
+{
+    return count;
+}
+
+static int compareTime(const void* a, const void* b)
+{
+    UInt32 ta = *(const UInt32*)a;
+    UInt32 tb = *(const UInt32*)b;
+
+    return ta < tb ? -1 : ta > tb ? 1 : 0;
+}
+
+// Nearest rank percentile of the sorted frame times in milliseconds
+static double percentile(int p)
+{
+    int rank = (p * count + 99) / 100;
+
+    return sorted[rank > 0 ? rank - 1 : 0] / 1000.0;
+}
+
+void frameStatsReport(FrameStatsPrint print, double expectedSamples)
+{
+    double phaseSum[FRAME_PHASE_COUNT] = { 0 };
+    double totalSum = 0;
+    double sampleSum = 0;
+    UInt32 minSamples = ~0;
+    UInt32 maxSamples = 0;
+    int shortFrames = 0;
+    int underruns = 0;
+    char line[160];
+    int i;
+    int j;
+
+    if (count == 0) {
+        return;
+    }
+
+    for (i = 0; i < count; i++) {
+        FrameRecord* record = &records[(first + i) % maxRecords];
+        UInt32 total = 0;
+
+        for (j = 0; j < FRAME_PHASE_COUNT; j++) {
+            phaseSum[j] += record->phaseTime[j];
+            total += record->phaseTime[j];
+        }
+        sorted[i] = total;
+        totalSum += total;
+
+        sampleSum += record->samples;
+        if (record->samples < minSamples) minSamples = record->samples;
+        if (record->samples > maxSamples) maxSamples = record->samples;
+
+        // The sample count of a frame varies by one with the rate fraction
+        if (record->samples + 1 < expectedSamples) {
+            shortFrames++;
+        }
+        if (record->underrun) {
+            underruns++;
+        }
+    }
+
+    qsort(sorted, count, sizeof(UInt32), compareTime);
+
+    sprintf(line, "Frame time over %d frames: p50 %.2f ms, p95 %.2f ms, p99 %.2f ms, max %.2f ms",
+            count, percentile(50), percentile(95), percentile(99), sorted[count - 1] / 1000.0);
+    print(line);
+
+    sprintf(line, "  Split:");
+    for (j = 0; j < FRAME_PHASE_COUNT; j++) {
+        sprintf(line + strlen(line), " %s %.2f ms (%.0f%%)", phaseNames[j],
+                phaseSum[j] / count / 1000.0, totalSum > 0 ? 100.0 * phaseSum[j] / totalSum : 0.0);
+    }
+    print(line);
+
+    sprintf(line, "  Audio: %.1f samples per frame (expected %.1f, min %u, max %u), %d short frames, %d underruns",
+            sampleSum / count, expectedSamples, (unsigned)minSamples, (unsigned)maxSamples, shortFrames, underruns);
+    print(line);
+}
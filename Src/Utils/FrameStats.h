@@ -0,0 +1,55 @@
+/*****************************************************************************
+** File: FrameStats.h
+**
+** More info: http://www.bluemsx.com
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+**
+******************************************************************************
+*/
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+#include "MsxTypes.h"
+
+// Rolling frame time and audio statistics. The frontend adds one record
+// per frame and reports the statistics of the recorded frames.
+
+typedef enum {
+    FRAME_PHASE_EMULATION,      // CPU and devices, including line rendering
+    FRAME_PHASE_MIXER,          // Mixing and audio output
+    FRAME_PHASE_VIDEO,          // Frame output
+    FRAME_PHASE_COUNT
+} FramePhase;
+
+typedef void (*FrameStatsPrint)(const char* line);
+
+// Clears the recorded frames. Up to maxFrames frames are kept, older
+// frames are dropped.
+void frameStatsReset(int maxFrames);
+void frameStatsDestroy();
+
+// Adds a frame. The phase times are in microseconds, samples is the number
+// of audio frames produced and underrun is set if the frontend reported
+// that its audio buffer was about to run out.
+void frameStatsAdd(const UInt32* phaseTime, UInt32 samples, int underrun);
+
+int frameStatsGetCount();
+
+// Prints the frame time percentiles, the time split between the phases
+// and the produced audio compared to the expected samples per frame.
+void frameStatsReport(FrameStatsPrint print, double expectedSamples);
+
+#endif
@@ -10,8 +10,40 @@
 // PacketFileSystem.h Need to be included after all other includes
 #include "PacketFileSystem.h"
 
+// The file buffer is indexed once after it is loaded or rewritten. Every
+// line is recorded, and section headers and keys are hashed so lookups
+// don't need to rescan the file. Sections are keyed on their header line
+// and keys on the header line index of their section, so only the first
+// occurrence of a section or a key within it is found, like a linear scan.
+// Entries are matched on a prefix of the line, so a key that an earlier
+// line of its section starts with is marked shadowed and is only found by
+// scanning the section.
+
+typedef struct
+{
+    int offset;
+    int length;
+    int keyLength;
+    int valueOffset;
+} IniLine;
+
+typedef struct
+{
+    unsigned int hash;
+    int section;
+    int line;
+    int next;
+    int shadowed;
+} IniKey;
+
 struct IniFile
 {
+    IniLine *lines;
+    int   lineCount;
+    IniKey *keys;
+    int   keyCount;
+    int  *buckets;
+    int   bucketMask;
     char *iniBuffer;
     char *iniPtr;
     char *iniEnd;
@@ -134,6 +166,246 @@ static int readFile(IniFile *iniFile)
     return success;
 }
 
+static unsigned int hashString(unsigned int hash, const char *str, int length)
+{
+    while (length--) {
+        hash = (hash ^ (unsigned char)*str++) * 16777619;
+    }
+    return hash;
+}
+
+static unsigned int hashKey(int section, const char *key, int length)
+{
+    return hashString(2166136261u ^ (unsigned int)section, key, length);
+}
+
+static void destroyIndex(IniFile *iniFile)
+{
+    free(iniFile->lines);
+    free(iniFile->keys);
+    free(iniFile->buckets);
+    iniFile->lines = NULL;
+    iniFile->keys = NULL;
+    iniFile->buckets = NULL;
+    iniFile->lineCount = 0;
+    iniFile->keyCount = 0;
+    iniFile->bucketMask = 0;
+}
+
+static int lookupKey(IniFile *iniFile, int section, unsigned int hash, const char *key, int length)
+{
+    int index;
+
+    if (iniFile->buckets == NULL) {
+        return -1;
+    }
+
+    for (index = iniFile->buckets[hash & iniFile->bucketMask]; index >= 0; index = iniFile->keys[index].next) {
+        IniKey *k = iniFile->keys + index;
+        IniLine *line = iniFile->lines + k->line;
+        int nameLength = k->section < 0 ? line->length : line->keyLength;
+
+        if (k->hash == hash && k->section == section && 
+            nameLength == length && memcmp(iniFile->iniBuffer + line->offset, key, length) == 0) 
+        {
+            return index;
+        }
+    }
+
+    return -1;
+}
+
+static int findKey(IniFile *iniFile, int section, const char *key, int length)
+{
+    int index = lookupKey(iniFile, section, hashKey(section, key, length), key, length);
+
+    return index >= 0 ? iniFile->keys[index].line : -1;
+}
+
+static void addKey(IniFile *iniFile, int section, int lineIndex)
+{
+    IniLine *line = iniFile->lines + lineIndex;
+    const char *name = iniFile->iniBuffer + line->offset;
+    int length = section < 0 ? line->length : line->keyLength;
+    IniKey *k;
+
+    if (findKey(iniFile, section, name, length) >= 0) {
+        return;
+    }
+
+    k = iniFile->keys + iniFile->keyCount;
+    k->hash     = hashKey(section, name, length);
+    k->section  = section;
+    k->line     = lineIndex;
+    k->shadowed = 0;
+    k->next     = iniFile->buckets[k->hash & iniFile->bucketMask];
+    iniFile->buckets[k->hash & iniFile->bucketMask] = iniFile->keyCount++;
+}
+
+static void createIndex(IniFile *iniFile)
+{
+    char *ptr = iniFile->iniBuffer;
+    char *end = iniFile->iniEnd;
+    int maxLines = 0;
+    int section = -1;
+    int buckets = 16;
+    int i;
+
+    destroyIndex(iniFile);
+
+    if (ptr == NULL) {
+        return;
+    }
+
+    for (; ptr != end; ptr++) {
+        maxLines += *ptr == '\n';
+    }
+    while (buckets < 2 * maxLines) {
+        buckets *= 2;
+    }
+
+    iniFile->lines = malloc((maxLines + 1) * sizeof(IniLine));
+    iniFile->keys = malloc((maxLines + 1) * sizeof(IniKey));
+    iniFile->buckets = malloc(buckets * sizeof(int));
+    iniFile->bucketMask = buckets - 1;
+    for (i = 0; i < buckets; i++) {
+        iniFile->buckets[i] = -1;
+    }
+
+    // Lines that are not terminated by a newline are not read
+    for (ptr = iniFile->iniBuffer; ptr != end; ) {
+        char *eol = memchr(ptr, '\n', end - ptr);
+        IniLine *line = iniFile->lines + iniFile->lineCount;
+        char *eq;
+        char *c;
+
+        if (eol == NULL) {
+            break;
+        }
+
+        line->offset = ptr - iniFile->iniBuffer;
+        line->length = eol - ptr;
+        line->keyLength = -1;
+        line->valueOffset = -1;
+
+        eq = memchr(ptr, '=', line->length);
+        if (eq != NULL) {
+            line->keyLength = eq - ptr;
+            for (c = eol - 1; *c != '='; c--);
+            line->valueOffset = c + 1 - iniFile->iniBuffer;
+        }
+
+        if (*ptr == '[') {
+            section = iniFile->lineCount;
+            addKey(iniFile, -1, section);
+        }
+        else if (section >= 0 && eq != NULL) {
+            addKey(iniFile, section, iniFile->lineCount);
+        }
+
+        iniFile->lineCount++;
+        ptr = eol + 1;
+    }
+
+    // Every prefix of a line up to its '=' is looked up in its section,
+    // keys found on a later line are shadowed by this one
+    section = -1;
+    for (i = 0; i < iniFile->lineCount; i++) {
+        IniLine *line = iniFile->lines + i;
+        const char *text = iniFile->iniBuffer + line->offset;
+        int length = line->keyLength >= 0 ? line->keyLength : line->length;
+        unsigned int hash;
+        int p;
+
+        if (line->length > 0 && text[0] == '[') {
+            section = i;
+            continue;
+        }
+        if (section < 0) {
+            continue;
+        }
+
+        hash = hashKey(section, text, 0);
+        for (p = 0; p <= length; p++) {
+            int index = lookupKey(iniFile, section, hash, text, p);
+            if (index >= 0 && iniFile->keys[index].line > i) {
+                iniFile->keys[index].shadowed = 1;
+            }
+            if (p < length) {
+                hash = hashString(hash, text + p, 1);
+            }
+        }
+    }
+}
+
+static int findSection(IniFile *iniFile, const char *section)
+{
+    char t_section[MAX_LINE_LENGTH];
+
+    sprintf(t_section, "[%s]", section);
+    return findKey(iniFile, -1, t_section, strlen(t_section));
+}
+
+// Returns the first line in the section that starts with the entry name if
+// it has a value, or -1. Keys that no earlier line starts with are looked up
+// in the index, other entries fall back to scanning the section.
+static int findEntry(IniFile *iniFile, const char *section, const char *entry)
+{
+    int sectionLine = findSection(iniFile, section);
+    int len = strlen(entry);
+    int i;
+
+    if (sectionLine < 0) {
+        return -1;
+    }
+
+    i = lookupKey(iniFile, sectionLine, hashKey(sectionLine, entry, len), entry, len);
+    if (i >= 0 && !iniFile->keys[i].shadowed) {
+        return iniFile->keys[i].line;
+    }
+
+    for (i = sectionLine + 1; i < iniFile->lineCount; i++) {
+        IniLine *line = iniFile->lines + i;
+        const char *text = iniFile->iniBuffer + line->offset;
+
+        if (line->length > 0 && text[0] == '[') {
+            break;
+        }
+        if (line->length >= len && strncmp(text, entry, len) == 0) {
+            return line->valueOffset >= 0 ? i : -1;
+        }
+    }
+
+    return -1;
+}
+
+static int copyValue(IniFile *iniFile, int lineIndex, char *buffer, int bufferLen)
+{
+    IniLine *line = iniFile->lines + lineIndex;
+    int length = line->offset + line->length - line->valueOffset;
+
+    if (length > bufferLen - 1) {
+        length = bufferLen - 1;
+    }
+    memcpy(buffer, iniFile->iniBuffer + line->valueOffset, length);
+    buffer[length] = '\0';
+
+    return length;
+}
+
+static void stripCarriageReturns(IniFile *iniFile)
+{
+    char *src = iniFile->iniBuffer;
+    char *dst = iniFile->iniBuffer;
+
+    for (; src != iniFile->iniEnd; src++) {
+        if (*src != '\r') {
+            *dst++ = *src;
+        }
+    }
+    iniFile->iniEnd = dst;
+}
+
 static int readLine(IniFile *iniFile, char *line)
 {   
     int i = 0; 
@@ -174,6 +446,8 @@ static void destroyWriteBuffer(IniFile *iniFile)
     iniFile->iniBuffer = iniFile->wrtBuffer;
     iniFile->iniPtr = iniFile->iniBuffer;
     iniFile->iniEnd = iniFile->iniBuffer + iniFile->wrtOffset;
+
+    createIndex(iniFile);
 }
 
 static void writeLine(IniFile *iniFile, const char* line)
@@ -200,6 +474,14 @@ static void writeFile(IniFile *iniFile, const char* filename)
     fclose(f);
 }
 
+static void prepareBuffer(IniFile *iniFile)
+{
+    if (iniFile->iniBuffer != NULL) {
+        stripCarriageReturns(iniFile);
+    }
+    createIndex(iniFile);
+}
+
 IniFile *iniFileOpen(const char *filename)
 {
     IniFile *iniFile = (IniFile *)malloc(sizeof(IniFile));
@@ -210,12 +492,17 @@ IniFile *iniFileOpen(const char *filename)
         
         iniFile->modified = 0;
         
+        iniFile->lines = NULL;
+        iniFile->keys = NULL;
+        iniFile->buckets = NULL;
+        
         iniFile->iniPtr = NULL;
         iniFile->iniEnd = NULL;
         iniFile->iniBuffer = NULL;
         
         strcpy(iniFile->iniFilename, filename);
         readFile(iniFile);
+        prepareBuffer(iniFile);
     }
     
     return iniFile;
@@ -230,6 +517,10 @@ IniFile *iniFileOpenZipped(const char *zipFile, const char *iniFilename)
         iniFile->isZipped = 1;
         iniFile->modified = 0;
         
+        iniFile->lines = NULL;
+        iniFile->keys = NULL;
+        iniFile->buckets = NULL;
+        
         iniFile->iniPtr = NULL;
         iniFile->iniEnd = NULL;
         iniFile->iniBuffer = NULL;
@@ -238,6 +529,7 @@ IniFile *iniFileOpenZipped(const char *zipFile, const char *iniFilename)
         strcpy(iniFile->zipFile, zipFile);
         
         readFile(iniFile);
+        prepareBuffer(iniFile);
     }
     
     return iniFile;
@@ -245,6 +537,8 @@ IniFile *iniFileOpenZipped(const char *zipFile, const char *iniFilename)
 
 int iniFileClose(IniFile *iniFile)
 {
+    destroyIndex(iniFile);
+
     if (iniFile->iniBuffer == NULL) {
         return 0;
     }
@@ -269,48 +563,28 @@ int iniFileGetInt(IniFile *iniFile,
                   char* entry, 
                   int   def) 
 {   
-
-    char buff[MAX_LINE_LENGTH]; 
-    char *ep; 
-    char t_section[MAX_LINE_LENGTH]; 
-    char value[6]; 
-    int len = strlen(entry); 
+    char value[16]; 
+    const char *ep;
+    int line;
     int i; 
-    
-    rewindBuffer(iniFile);
-
-    sprintf(t_section, "[%s]", section);
-
-    do {   
-        if (readLine(iniFile, buff) < 0) {
-            return def; 
-        } 
-    } while(strcmp(buff, t_section)); 
-
-    do {   
-        if (readLine(iniFile, buff) < 0 || buff[0] == '[') {
-            return def; 
-        } 
-    } while(strncmp(buff, entry, len)); 
 
-    ep = strrchr(buff, '=');
-    if (ep == NULL) {
+    line = findEntry(iniFile, section, entry);
+    if (line < 0) {
         return def;
     }
-    ep++;
-    if (!strlen(ep)) {
+
+    ep = iniFile->iniBuffer + iniFile->lines[line].valueOffset;
+    if (*ep == '\n') {
         return def; 
     }
 
-    for (i = 0; isdigit(ep[i]); i++) {
+    for (i = 0; i < (int)sizeof(value) - 1 && isdigit(ep[i]); i++) {
         value[i] = ep[i]; 
     }
 
     value[i] = '\0'; 
     
     return atoi(value); 
-
-
 } 
 
 
@@ -321,41 +595,15 @@ int iniFileGetString(IniFile *iniFile,
                      char* buffer, 
                      int   bufferLen) 
 {   
-    char def[MAX_LINE_LENGTH];
-    char buff[MAX_LINE_LENGTH]; 
-    char *ep; 
-    char t_section[MAX_LINE_LENGTH]; 
-    int len = strlen(entry); 
-
-    rewindBuffer(iniFile);
-
-    strcpy(def, defVal);
-
-    sprintf(t_section, "[%s]", section);
-     
-    do {   
-        if (readLine(iniFile, buff) < 0) {
-            strncpy(buffer, def, bufferLen); 
-            buffer[bufferLen - 1] = '\0';
-            return strlen(buffer); 
-        } 
-    } while (strcmp(buff, t_section)); 
-
-    do {   
-        if (readLine(iniFile, buff) < 0 || buff[0] == '[') {
-            strncpy(buffer, def, bufferLen);   
-            buffer[bufferLen - 1] = '\0';  
-            return strlen(buffer); 
-        } 
-    } while (strncmp(buff, entry, len)); 
-
-    ep = strrchr(buff, '=');
-    ep++; 
+    int line = findEntry(iniFile, section, entry);
 
-    strncpy(buffer, ep, bufferLen); 
-    buffer[bufferLen - 1] = '\0'; 
+    if (line < 0) {
+        strncpy(buffer, defVal, bufferLen); 
+        buffer[bufferLen - 1] = '\0';
+        return strlen(buffer); 
+    }
 
-    return strlen(buffer); 
+    return copyValue(iniFile, line, buffer, bufferLen);
 } 
 
 int iniFileGetSection(IniFile *iniFile,
@@ -363,27 +611,26 @@ int iniFileGetSection(IniFile *iniFile,
                       char* buffer, 
                       int   bufferLen)
 {
-    char buff[MAX_LINE_LENGTH]; 
-    char t_section[MAX_LINE_LENGTH]; 
     int offset = 0;
-    int len;
+    int i = findSection(iniFile, section);
 
-    rewindBuffer(iniFile);
-
-    sprintf(t_section, "[%s]", section);
-
-    do {   
-        if (readLine(iniFile, buff) < 0) {
-            buffer[offset++] = '\0';
-            buffer[offset++] = '\0';
-            return strlen(buffer); 
-        } 
-    } while (strcmp(buff, t_section)); 
+    if (i < 0) {
+        buffer[offset++] = '\0';
+        buffer[offset++] = '\0';
+        return strlen(buffer); 
+    }
     
-    while ((len = readLine(iniFile, buff)) >= 0 && buff[0] != '[') {
-        if (offset + len + 2 < bufferLen) {
-            strcpy(buffer + offset, buff);
-            offset += len + 1;
+    for (i++; i < iniFile->lineCount; i++) {
+        IniLine *line = iniFile->lines + i;
+        const char *text = iniFile->iniBuffer + line->offset;
+
+        if (line->length > 0 && text[0] == '[') {
+            break;
+        }
+        if (offset + line->length + 2 < bufferLen) {
+            memcpy(buffer + offset, text, line->length);
+            buffer[offset + line->length] = '\0';
+            offset += line->length + 1;
         }
     }
 
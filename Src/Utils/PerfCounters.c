@@ -0,0 +1,144 @@
+/*****************************************************************************
+** File: PerfCounters.c
+**
+** More info: http://www.bluemsx.com
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+**
+******************************************************************************
+*/
+#include "PerfCounters.h"
+#include <stdio.h>
+#include <string.h>
+
+#define COUNTER_COUNT (sizeof(PerfCounters) / sizeof(UInt32))
+
+PerfCounters perfCounters;
+
+static PerfCounters frameCounters;
+static PerfCounters totalCounters;
+static UInt32       frameCount;
+
+static const char* vdpCommandNames[16] = {
+    "ABRT", "NOOP", "NOOP", "NOOP", "POINT", "PSET", "SRCH", "LINE",
+    "LMMV", "LMMM", "LMCM", "LMMC", "HMMV", "HMMM", "YMMM", "HMMC"
+};
+
+void perfCountersReset()
+{
+    memset(&perfCounters, 0, sizeof(perfCounters));
+    memset(&frameCounters, 0, sizeof(frameCounters));
+    memset(&totalCounters, 0, sizeof(totalCounters));
+    frameCount = 0;
+}
+
+void perfCountersEndFrame()
+{
+    const UInt32* src = (const UInt32*)&perfCounters;
+    UInt32* dst = (UInt32*)&totalCounters;
+    unsigned i;
+
+    for (i = 0; i < COUNTER_COUNT; i++) {
+        dst[i] += src[i];
+    }
+    frameCounters = perfCounters;
+    memset(&perfCounters, 0, sizeof(perfCounters));
+    frameCount++;
+}
+
+const PerfCounters* perfCountersGetFrame()
+{
+    return &frameCounters;
+}
+
+const PerfCounters* perfCountersGetTotal(UInt32* frames)
+{
+    if (frames != NULL) {
+        *frames = frameCount;
+    }
+    return &totalCounters;
+}
+
+// Appends to a line as long as it fits
+static void appendLine(char* line, const char* text)
+{
+    size_t length = strlen(line);
+
+    if (length + strlen(text) < 128) {
+        strcpy(line + length, text);
+    }
+}
+
+void perfCountersReport(PerfCountersPrint print)
+{
+    PerfCounters* t = &totalCounters;
+    double frames = frameCount > 0 ? frameCount : 1;
+    char line[128];
+    char text[64];
+    int used[256];
+    int i;
+    int j;
+
+    sprintf(line, "Hot path counters over %u frames, per frame:", (unsigned)frameCount);
+    print(line);
+
+    // The eight busiest I/O ports
+    memset(used, 0, sizeof(used));
+    strcpy(line, "  I/O ports:");
+    for (j = 0; j < 8; j++) {
+        int port = -1;
+        for (i = 0; i < 256; i++) {
+            if (!used[i] && t->ioRead[i] + t->ioWrite[i] > 0 &&
+                (port < 0 || t->ioRead[i] + t->ioWrite[i] > t->ioRead[port] + t->ioWrite[port]))
+            {
+                port = i;
+            }
+        }
+        if (port < 0) {
+            break;
+        }
+        used[port] = 1;
+        sprintf(text, " %.2x:%.1fr/%.1fw", port, t->ioRead[port] / frames, t->ioWrite[port] / frames);
+        appendLine(line, text);
+    }
+    print(line);
+
+    sprintf(line, "  Slot switches: %.1f primary, %.1f secondary",
+            t->primarySlotSwitches / frames, t->secondarySlotSwitches / frames);
+    print(line);
+
+    strcpy(line, "  Bank switches:");
+    for (i = 0; i < 4; i++) {
+        for (j = 0; j < 4; j++) {
+            if (t->pageMaps[i][j] > 0) {
+                sprintf(text, " %d-%d:%.1f", i, j, t->pageMaps[i][j] / frames);
+                appendLine(line, text);
+            }
+        }
+    }
+    print(line);
+
+    sprintf(line, "  VRAM: %.1f reads, %.1f writes", t->vramReads / frames, t->vramWrites / frames);
+    print(line);
+
+    strcpy(line, "  VDP commands:");
+    for (i = 0; i < 16; i++) {
+        if (t->vdpCommands[i] > 0) {
+            sprintf(text, " %s:%.2f", vdpCommandNames[i], t->vdpCommands[i] / frames);
+            appendLine(line, text);
+        }
+    }
+    print(line);
+}
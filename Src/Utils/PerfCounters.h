@@ -0,0 +1,58 @@
+/*****************************************************************************
+** File: PerfCounters.h
+**
+** More info: http://www.bluemsx.com
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+**
+******************************************************************************
+*/
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include "MsxTypes.h"
+
+// Counters for the emulation hot paths. The devices increment the counters
+// of the current frame directly; perfCountersEndFrame closes the frame and
+// adds it to the totals.
+
+typedef struct {
+    UInt32 ioRead[256];
+    UInt32 ioWrite[256];
+    UInt32 primarySlotSwitches;
+    UInt32 secondarySlotSwitches;
+    UInt32 pageMaps[4][4];      // Mapper bank switches per slot and subslot
+    UInt32 vramReads;
+    UInt32 vramWrites;
+    UInt32 vdpCommands[16];     // Started VDP commands per command code
+} PerfCounters;
+
+extern PerfCounters perfCounters;
+
+typedef void (*PerfCountersPrint)(const char* line);
+
+void perfCountersReset();
+void perfCountersEndFrame();
+
+// Returns the counters of the last completed frame.
+const PerfCounters* perfCountersGetFrame();
+
+// Returns the counters summed over all frames since the last reset.
+const PerfCounters* perfCountersGetTotal(UInt32* frames);
+
+// Prints a summary of the totals as per frame averages, one line per call.
+void perfCountersReport(PerfCountersPrint print);
+
+#endif
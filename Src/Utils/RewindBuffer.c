@@ -0,0 +1,344 @@
+/*****************************************************************************
+** File: RewindBuffer.c
+**
+** More info: http://www.bluemsx.com
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+**
+******************************************************************************
+*/
+#include "RewindBuffer.h"
+#include <stdlib.h>
+#include <string.h>
+
+// The newest snapshot is kept uncompressed and works as the key frame.
+// Every older snapshot is stored as the XOR of itself and the snapshot
+// after it, so stepping back is one XOR pass over the key frame and the
+// oldest deltas can be dropped without touching the rest of the chain.
+//
+// Consecutive snapshots mostly differ in a few places, so the deltas are
+// encoded as runs of zero bytes and literal bytes. Each delta starts with
+// the size of the older snapshot, all counts are 7 bit varints.
+//
+// Deltas are stored back to back in a byte ring that is allocated once.
+// A delta never wraps; if it doesn't fit at the end it is placed at the
+// start of the ring.
+
+typedef struct {
+    int offset;
+    int length;
+} RewindEntry;
+
+struct RewindBuffer {
+    UInt8* ring;
+    int    ringSize;
+
+    RewindEntry* entries;
+    int    maxEntries;
+    int    first;
+    int    count;
+
+    UInt8* current;
+    int    currentSize;
+    int    currentCapacity;
+    int    hasCurrent;
+
+    UInt8* output;
+    int    outputCapacity;
+
+    UInt8* delta;
+    UInt8* encoded;
+    int    scratchCapacity;
+};
+
+static void growBuffer(UInt8** buffer, int* capacity, int size)
+{
+    if (size > *capacity) {
+        *buffer = realloc(*buffer, size);
+        memset(*buffer + *capacity, 0, size - *capacity);
+        *capacity = size;
+    }
+}
+
+static UInt8* putVarint(UInt8* dst, UInt32 value)
+{
+    while (value >= 0x80) {
+        *dst++ = (UInt8)(value | 0x80);
+        value >>= 7;
+    }
+    *dst++ = (UInt8)value;
+    return dst;
+}
+
+static const UInt8* getVarint(const UInt8* src, UInt32* value)
+{
+    int shift = 0;
+
+    *value = 0;
+    do {
+        *value |= (UInt32)(*src & 0x7f) << shift;
+        shift += 7;
+    } while (*src++ & 0x80);
+
+    return src;
+}
+
+static int zeroRun(const UInt8* data, int pos, int size)
+{
+    int start = pos;
+
+    while (pos + 8 <= size) {
+        UInt64 word;
+        memcpy(&word, data + pos, 8);
+        if (word != 0) {
+            break;
+        }
+        pos += 8;
+    }
+    while (pos < size && data[pos] == 0) {
+        pos++;
+    }
+    return pos - start;
+}
+
+// Encodes the XOR of the two snapshots. The current snapshot buffer is
+// zero beyond its size, so only the new state needs bounds checks.
+static int rewindEncode(RewindBuffer* rb, const UInt8* state, int size)
+{
+    const UInt8* cur = rb->current;
+    int length = size > rb->currentSize ? size : rb->currentSize;
+    int common = size < rb->currentSize ? size : rb->currentSize;
+    UInt8* dst = rb->encoded;
+    int pos = 0;
+    int i;
+
+    for (i = 0; i < common; i++) {
+        rb->delta[i] = cur[i] ^ state[i];
+    }
+    if (size > common) {
+        memcpy(rb->delta + common, state + common, size - common);
+    }
+    else {
+        memcpy(rb->delta + common, cur + common, length - common);
+    }
+
+    dst = putVarint(dst, rb->currentSize);
+
+    while (pos < length) {
+        int zeros = zeroRun(rb->delta, pos, length);
+        int literals = 0;
+
+        pos += zeros;
+
+        // Single zero bytes are cheaper as literals than as a new token
+        while (pos + literals < length) {
+            if (rb->delta[pos + literals] == 0 && zeroRun(rb->delta, pos + literals, length) > 2) {
+                break;
+            }
+            literals++;
+        }
+
+        dst = putVarint(dst, zeros);
+        dst = putVarint(dst, literals);
+        memcpy(dst, rb->delta + pos, literals);
+        dst += literals;
+        pos += literals;
+    }
+
+    return dst - rb->encoded;
+}
+
+static void rewindDecode(RewindBuffer* rb, const UInt8* src, int length)
+{
+    const UInt8* end = src + length;
+    UInt8* dst;
+    UInt32 size;
+
+    src = getVarint(src, &size);
+    growBuffer(&rb->current, &rb->currentCapacity, size);
+
+    dst = rb->current;
+    while (src < end) {
+        UInt32 zeros;
+        UInt32 literals;
+
+        src = getVarint(src, &zeros);
+        src = getVarint(src, &literals);
+        dst += zeros;
+        while (literals--) {
+            *dst++ ^= *src++;
+        }
+    }
+
+    // Keep the buffer zero beyond the snapshot
+    if ((int)size < rb->currentSize) {
+        memset(rb->current + size, 0, rb->currentSize - size);
+    }
+    rb->currentSize = size;
+}
+
+static void rewindDropOldest(RewindBuffer* rb)
+{
+    rb->first = (rb->first + 1) % rb->maxEntries;
+    rb->count--;
+}
+
+static RewindEntry* rewindNewest(RewindBuffer* rb)
+{
+    return rb->entries + (rb->first + rb->count - 1) % rb->maxEntries;
+}
+
+static void rewindStore(RewindBuffer* rb, int length)
+{
+    RewindEntry* entry;
+    int pos = 0;
+
+    if (length > rb->ringSize) {
+        rb->count = 0;
+        return;
+    }
+
+    if (rb->count > 0) {
+        entry = rewindNewest(rb);
+        pos = entry->offset + entry->length;
+        if (pos + length > rb->ringSize) {
+            // The deltas between the newest one and the end of the ring
+            // are the oldest ones, they go before any at the start
+            while (rb->count > 0 && rb->entries[rb->first].offset >= pos) {
+                rewindDropOldest(rb);
+            }
+            pos = 0;
+        }
+    }
+
+    // Deltas after the newest one in the ring are the oldest ones
+    while (rb->count > 0) {
+        RewindEntry* oldest = rb->entries + rb->first;
+        if (oldest->offset >= pos + length || oldest->offset + oldest->length <= pos) {
+            break;
+        }
+        rewindDropOldest(rb);
+    }
+
+    if (rb->count == rb->maxEntries) {
+        rewindDropOldest(rb);
+    }
+
+    entry = rb->entries + (rb->first + rb->count) % rb->maxEntries;
+    entry->offset = pos;
+    entry->length = length;
+    memcpy(rb->ring + pos, rb->encoded, length);
+    rb->count++;
+}
+
+RewindBuffer* rewindBufferCreate(int ringSize, int maxStates)
+{
+    RewindBuffer* rb = (RewindBuffer*)calloc(1, sizeof(RewindBuffer));
+
+    rb->ringSize   = ringSize;
+    rb->ring       = malloc(ringSize);
+    rb->maxEntries = maxStates > 1 ? maxStates - 1 : 1;
+    rb->entries    = (RewindEntry*)malloc(rb->maxEntries * sizeof(RewindEntry));
+
+    return rb;
+}
+
+void rewindBufferDestroy(RewindBuffer* rb)
+{
+    free(rb->ring);
+    free(rb->entries);
+    free(rb->current);
+    free(rb->output);
+    free(rb->delta);
+    free(rb->encoded);
+    free(rb);
+}
+
+void rewindBufferClear(RewindBuffer* rb)
+{
+    rb->first = 0;
+    rb->count = 0;
+    rb->hasCurrent = 0;
+    if (rb->current != NULL) {
+        memset(rb->current, 0, rb->currentSize);
+    }
+    rb->currentSize = 0;
+}
+
+void rewindBufferPush(RewindBuffer* rb, const void* state, int size)
+{
+    if (rb->hasCurrent) {
+        int length = size > rb->currentSize ? size : rb->currentSize;
+
+        // The encoding never grows the data by more than a token for
+        // every few bytes
+        if (2 * length + 16 > rb->scratchCapacity) {
+            rb->scratchCapacity = 2 * length + 16;
+            rb->delta   = realloc(rb->delta, rb->scratchCapacity);
+            rb->encoded = realloc(rb->encoded, rb->scratchCapacity);
+        }
+
+        rewindStore(rb, rewindEncode(rb, (const UInt8*)state, size));
+    }
+
+    growBuffer(&rb->current, &rb->currentCapacity, size);
+    memcpy(rb->current, state, size);
+    if (size < rb->currentSize) {
+        memset(rb->current + size, 0, rb->currentSize - size);
+    }
+    rb->currentSize = size;
+    rb->hasCurrent  = 1;
+}
+
+const void* rewindBufferPop(RewindBuffer* rb, int* size)
+{
+    RewindEntry* entry;
+
+    if (!rb->hasCurrent) {
+        *size = 0;
+        return NULL;
+    }
+
+    growBuffer(&rb->output, &rb->outputCapacity, rb->currentSize);
+    memcpy(rb->output, rb->current, rb->currentSize);
+    *size = rb->currentSize;
+
+    if (rb->count == 0) {
+        rewindBufferClear(rb);
+        return rb->output;
+    }
+
+    entry = rewindNewest(rb);
+    rewindDecode(rb, rb->ring + entry->offset, entry->length);
+    rb->count--;
+
+    return rb->output;
+}
+
+int rewindBufferGetCount(RewindBuffer* rb)
+{
+    return rb->hasCurrent ? rb->count + 1 : 0;
+}
+
+int rewindBufferGetUsage(RewindBuffer* rb)
+{
+    int usage = 0;
+    int i;
+
+    for (i = 0; i < rb->count; i++) {
+        usage += rb->entries[(rb->first + i) % rb->maxEntries].length;
+    }
+    return usage;
+}
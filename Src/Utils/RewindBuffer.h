@@ -0,0 +1,49 @@
+/*****************************************************************************
+** File: RewindBuffer.h
+**
+** More info: http://www.bluemsx.com
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+**
+******************************************************************************
+*/
+#ifndef REWIND_BUFFER_H
+#define REWIND_BUFFER_H
+
+#include "MsxTypes.h"
+
+typedef struct RewindBuffer RewindBuffer;
+
+// Creates a rewind buffer holding up to maxStates snapshots in a ring of
+// ringSize bytes. The oldest snapshots are dropped when either is full.
+RewindBuffer* rewindBufferCreate(int ringSize, int maxStates);
+void rewindBufferDestroy(RewindBuffer* rb);
+
+void rewindBufferClear(RewindBuffer* rb);
+
+// Adds a snapshot. The data is copied.
+void rewindBufferPush(RewindBuffer* rb, const void* state, int size);
+
+// Removes the newest snapshot and returns it. The returned buffer is valid
+// until the next call to the rewind buffer.
+const void* rewindBufferPop(RewindBuffer* rb, int* size);
+
+int rewindBufferGetCount(RewindBuffer* rb);
+
+// Returns the number of bytes used in the ring, not counting the newest
+// snapshot which is kept uncompressed.
+int rewindBufferGetUsage(RewindBuffer* rb);
+
+#endif
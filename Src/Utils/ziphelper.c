@@ -30,7 +30,6 @@
 #include "zip.h"
 #include "unzip.h"
 #include "ctype.h"
-#include "ZipFromMem.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -59,18 +58,28 @@ static void toLower(char* str) {
 
 #define MAX_FILES_IN_ZIP 64
 
+// The file contents of a memory zip file are stored back to back in an
+// arena owned by the zip file. Saving a new snapshot resets the arena
+// instead of freeing it, so once it has grown to fit a snapshot no more
+// allocations are needed and each file ends up in the same place as in
+// the previous snapshot.
+
 typedef struct 
 {
     char  filename[32];
     int   size;
+    int   offset;
     char* buffer;
 } MemFile;
 
 typedef struct 
 {
     char    zipName[32];
-    MemFile* memFiles[MAX_FILES_IN_ZIP];
+    MemFile memFiles[MAX_FILES_IN_ZIP];
     int     count;
+    char*   arena;
+    int     arenaSize;
+    int     arenaUsed;
 } MemZipFile;
 
 static MemZipFile** memZipFiles = NULL;
@@ -94,16 +103,17 @@ void memZipFileDestroy(MemZipFile* memZipFile)
         }
     }
 
-    // Delete file contents
-    for (i = 0; i < memZipFile->count; i++)
+    free(memZipFile->arena);
+    free(memZipFile);
+}
+
+void memZipFileReset(MemZipFile* memZipFile)
+{
+    if (memZipFile != NULL)
     {
-        if (memZipFile->memFiles[i]->buffer != NULL)
-        {
-            free(memZipFile->memFiles[i]->buffer);
-        }
-        free(memZipFile->memFiles[i]);
+        memZipFile->count     = 0;
+        memZipFile->arenaUsed = 0;
     }
-    free(memZipFile);
 }
 
 void memZipFileSystemCreate(int maxFiles)
@@ -152,15 +162,49 @@ MemZipFile* memZipFileCreate(const char* zipName)
     {
         if (memZipFiles[i] == NULL)
         {
-            memZipFiles[i] = (MemZipFile*)malloc(sizeof(MemZipFile));
+            memZipFiles[i] = (MemZipFile*)calloc(1, sizeof(MemZipFile));
             strcpy(memZipFiles[i]->zipName, zipName);
-            memZipFiles[i]->count = 0;
             return memZipFiles[i];
         }
     }
     return NULL;
 }
 
+static char* memZipFileAlloc(MemZipFile* memZipFile, int size)
+{
+    char* buffer;
+
+    // Keep the file contents 8 byte aligned
+    size = (size + 7) & ~7;
+
+    if (memZipFile->arenaUsed + size > memZipFile->arenaSize)
+    {
+        int arenaSize = 2 * memZipFile->arenaSize;
+        char* arena;
+        int i;
+
+        if (arenaSize < memZipFile->arenaUsed + size)
+            arenaSize = memZipFile->arenaUsed + size;
+        if (arenaSize < 0x10000)
+            arenaSize = 0x10000;
+
+        arena = (char*)realloc(memZipFile->arena, arenaSize);
+        if (arena == NULL)
+            return NULL;
+
+        memZipFile->arena     = arena;
+        memZipFile->arenaSize = arenaSize;
+
+        for (i = 0; i < memZipFile->count; i++)
+            memZipFile->memFiles[i].buffer = arena + memZipFile->memFiles[i].offset;
+    }
+
+    buffer = memZipFile->arena + memZipFile->arenaUsed;
+    memZipFile->arenaUsed += size;
+
+    return buffer;
+}
+
 MemFile* memFileFindInZip(MemZipFile* memZipFile, const char* filename)
 {
     if (memZipFile != NULL)
@@ -168,9 +212,9 @@ MemFile* memFileFindInZip(MemZipFile* memZipFile, const char* filename)
         int i;
         for (i = 0; i < memZipFile->count; i++)
         {
-            if (strcmp(memZipFile->memFiles[i]->filename, filename) == 0)
+            if (strcmp(memZipFile->memFiles[i].filename, filename) == 0)
             {
-                return memZipFile->memFiles[i];
+                return &memZipFile->memFiles[i];
             }
         }
     }
@@ -195,26 +239,105 @@ int memFileSave(const char* zipName, const char* filename, int append, void* buf
 {
     MemZipFile* memZipFile = memZipFileFind(zipName);
     MemFile* memFile;
+    char* data;
 
     if (!append)
-    {
-        memZipFileDestroy(memZipFile);
-        memZipFile = NULL;
-    }
+        memZipFileReset(memZipFile);
 
     if (!memZipFile)
         memZipFile = memZipFileCreate(zipName);
 
     if (memZipFile == NULL || memZipFile->count == MAX_FILES_IN_ZIP)
         return 0;
-    
-    memFile         = (MemFile*)malloc(sizeof(MemFile));
-    memFile->buffer = (char*)malloc(size);
-    memcpy(memFile->buffer, buffer, size);
+
+    data = memZipFileAlloc(memZipFile, size);
+    if (data == NULL)
+        return 0;
+
+    memcpy(data, buffer, size);
+
+    memFile         = &memZipFile->memFiles[memZipFile->count++];
+    memFile->buffer = data;
+    memFile->offset = data - memZipFile->arena;
     memFile->size   = size;
     strcpy(memFile->filename, filename);
 
-    memZipFile->memFiles[memZipFile->count++] = memFile;
+    return 1;
+}
+
+// The flattened format is the file count followed by the name, size and
+// contents of each file
+int memZipFileSerialize(const char* zipName, void* buffer, int bufferSize)
+{
+    MemZipFile* memZipFile = memZipFileFind(zipName);
+    char* dst = (char*)buffer;
+    int size = sizeof(int);
+    int i;
+
+    if (memZipFile == NULL)
+        return 0;
+
+    for (i = 0; i < memZipFile->count; i++)
+        size += sizeof(memZipFile->memFiles[i].filename) + sizeof(int) + memZipFile->memFiles[i].size;
+
+    if (size > bufferSize)
+        return size;
+
+    memcpy(dst, &memZipFile->count, sizeof(int));
+    dst += sizeof(int);
+
+    for (i = 0; i < memZipFile->count; i++)
+    {
+        MemFile* memFile = &memZipFile->memFiles[i];
+
+        memcpy(dst, memFile->filename, sizeof(memFile->filename));
+        dst += sizeof(memFile->filename);
+        memcpy(dst, &memFile->size, sizeof(int));
+        dst += sizeof(int);
+        memcpy(dst, memFile->buffer, memFile->size);
+        dst += memFile->size;
+    }
+
+    return size;
+}
+
+int memZipFileDeserialize(const char* zipName, const void* buffer, int size)
+{
+    const char* src = (const char*)buffer;
+    const char* end = src + size;
+    int count;
+    int i;
+
+    if (size < (int)sizeof(int))
+        return 0;
+
+    memcpy(&count, src, sizeof(int));
+    src += sizeof(int);
+
+    // The loaded files replace all current ones, also when there are none
+    memZipFileReset(memZipFileFind(zipName));
+
+    for (i = 0; i < count; i++)
+    {
+        char filename[32];
+        int fileSize;
+
+        if (end - src < (int)(sizeof(filename) + sizeof(int)))
+            return 0;
+
+        memcpy(filename, src, sizeof(filename));
+        filename[sizeof(filename) - 1] = 0;
+        src += sizeof(filename);
+        memcpy(&fileSize, src, sizeof(int));
+        src += sizeof(int);
+
+        if (fileSize < 0 || end - src < fileSize)
+            return 0;
+
+        if (!memFileSave(zipName, filename, 1, (void*)src, fileSize))
+            return 0;
+        src += fileSize;
+    }
 
     return 1;
 }
@@ -402,6 +525,247 @@ int memFileSave(const char* zipName, const char* filename, int append, void* buf
 
 #endif
 
+/******************************************************************************
+*** Description
+***     Cache of opened zip files. Each archive keeps its unzip handle open
+***     and a hash index of the entry names in the central directory, so
+***     loading several files from one zip does not rescan the directory.
+***     Archives are keyed by path, size and modification time and the
+***     least recently used one is closed when the cache is full.
+***
+******************************************************************************/
+
+#define ZIP_CACHE_SIZE 4
+
+typedef struct {
+    const char*  name;
+    unsigned int hash;
+    int          next;
+    unz_file_pos pos;
+} ZipEntry;
+
+typedef struct {
+    char         zipName[512];
+    time_t       mtime;
+    long         fileSize;
+    unzFile      zip;
+    ZipEntry*    entries;
+    int          count;
+    int*         buckets;
+    int          bucketCount;
+    char*        names;
+    unsigned int lastUse;
+} ZipArchive;
+
+static ZipArchive zipArchives[ZIP_CACHE_SIZE];
+static unsigned int zipArchiveClock;
+
+// Hashes the lower case name so both case sensitive and case insensitive
+// lookups can use the same index.
+static unsigned int zipNameHash(const char* name)
+{
+    unsigned int hash = 2166136261u;
+
+    while (*name) {
+        hash ^= (unsigned char)tolower((unsigned char)*name++);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static int zipNameEqual(const char* a, const char* b)
+{
+#ifdef __APPLE__
+    // Most OS X installs are on a case-insensitive FS
+    while (*a && tolower((unsigned char)*a) == tolower((unsigned char)*b)) {
+        a++;
+        b++;
+    }
+    return tolower((unsigned char)*a) == tolower((unsigned char)*b);
+#else
+    return strcmp(a, b) == 0;
+#endif
+}
+
+static void zipArchiveClose(ZipArchive* archive)
+{
+    if (archive->zip != NULL) {
+        unzClose(archive->zip);
+    }
+    free(archive->entries);
+    free(archive->buckets);
+    free(archive->names);
+    memset(archive, 0, sizeof(ZipArchive));
+}
+
+static int zipArchiveIndex(ZipArchive* archive)
+{
+    unz_global_info globalInfo;
+    unz_file_info info;
+    int namesSize = 0;
+    int namesUsed = 0;
+    int status;
+    int i;
+
+    if (unzGetGlobalInfo(archive->zip, &globalInfo) != UNZ_OK) {
+        return 0;
+    }
+
+    archive->entries = (ZipEntry*)calloc(globalInfo.number_entry + 1, sizeof(ZipEntry));
+
+    status = unzGoToFirstFile(archive->zip);
+    while (status == UNZ_OK && archive->count < (int)globalInfo.number_entry) {
+        ZipEntry* entry = archive->entries + archive->count;
+        char* name;
+        int len;
+
+        if (unzGetCurrentFileInfo(archive->zip, &info, NULL, 0, NULL, 0, NULL, 0) != UNZ_OK) {
+            return 0;
+        }
+
+        // Names are stored at full length, a truncated name could match
+        // the wrong entry
+        len = (int)info.size_filename + 1;
+        if (namesUsed + len > namesSize) {
+            namesSize = 2 * namesSize + len + 256;
+            archive->names = (char*)realloc(archive->names, namesSize);
+        }
+        name = archive->names + namesUsed;
+
+        if (unzGetCurrentFileInfo(archive->zip, NULL, name, len, NULL, 0, NULL, 0) != UNZ_OK ||
+            unzGetFilePos(archive->zip, &entry->pos) != UNZ_OK)
+        {
+            return 0;
+        }
+
+        // Store offsets until the pool stops moving
+        entry->name = (const char*)(size_t)namesUsed;
+        entry->hash = zipNameHash(name);
+        namesUsed  += len;
+        archive->count++;
+
+        status = unzGoToNextFile(archive->zip);
+    }
+
+    if (status != UNZ_OK && status != UNZ_END_OF_LIST_OF_FILE) {
+        return 0;
+    }
+
+    archive->bucketCount = 16;
+    while (archive->bucketCount < 2 * archive->count) {
+        archive->bucketCount *= 2;
+    }
+    archive->buckets = (int*)malloc(archive->bucketCount * sizeof(int));
+    for (i = 0; i < archive->bucketCount; i++) {
+        archive->buckets[i] = -1;
+    }
+
+    for (i = 0; i < archive->count; i++) {
+        ZipEntry* entry = archive->entries + i;
+        int bucket = entry->hash & (archive->bucketCount - 1);
+
+        entry->name = archive->names + (size_t)entry->name;
+        entry->next = archive->buckets[bucket];
+        archive->buckets[bucket] = i;
+    }
+
+    return 1;
+}
+
+static ZipArchive* zipArchiveOpen(const char* zipName)
+{
+    ZipArchive* archive = NULL;
+    struct stat s;
+    int i;
+
+    if (strlen(zipName) >= sizeof(archive->zipName) || stat(zipName, &s) != 0) {
+        return NULL;
+    }
+
+    for (i = 0; i < ZIP_CACHE_SIZE; i++) {
+        if (zipArchives[i].zip != NULL && strcmp(zipArchives[i].zipName, zipName) == 0) {
+            archive = zipArchives + i;
+            if (archive->mtime == s.st_mtime && archive->fileSize == (long)s.st_size) {
+                archive->lastUse = ++zipArchiveClock;
+                return archive;
+            }
+            zipArchiveClose(archive);
+            break;
+        }
+    }
+
+    if (archive == NULL) {
+        archive = zipArchives;
+        for (i = 1; i < ZIP_CACHE_SIZE; i++) {
+            if (zipArchives[i].lastUse < archive->lastUse) {
+                archive = zipArchives + i;
+            }
+        }
+        zipArchiveClose(archive);
+    }
+
+    archive->zip = unzOpen(zipName);
+    if (archive->zip == NULL) {
+        return NULL;
+    }
+
+    if (!zipArchiveIndex(archive)) {
+        zipArchiveClose(archive);
+        return NULL;
+    }
+
+    strcpy(archive->zipName, zipName);
+    archive->mtime    = s.st_mtime;
+    archive->fileSize = (long)s.st_size;
+    archive->lastUse  = ++zipArchiveClock;
+
+    return archive;
+}
+
+static void zipArchiveInvalidate(const char* zipName)
+{
+    int i;
+
+    for (i = 0; i < ZIP_CACHE_SIZE; i++) {
+        if (zipArchives[i].zip != NULL && strcmp(zipArchives[i].zipName, zipName) == 0) {
+            zipArchiveClose(zipArchives + i);
+        }
+    }
+}
+
+static ZipEntry* zipArchiveFind(ZipArchive* archive, const char* fileName)
+{
+    unsigned int hash = zipNameHash(fileName);
+    int i;
+
+    for (i = archive->buckets[hash & (archive->bucketCount - 1)]; i >= 0; i = archive->entries[i].next) {
+        ZipEntry* entry = archive->entries + i;
+        if (entry->hash == hash && zipNameEqual(entry->name, fileName)) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// A file name starting with '*' means the zip name with the extension of
+// the file name. Returns NULL if that name doesn't fit the buffer.
+static const char* zipResolveName(const char* zipName, const char* fileName, char* name, size_t nameSize)
+{
+    if (fileName[0] == '*') {
+        size_t zipName_len  = strlen(zipName);
+        size_t fileName_len = strlen(fileName);
+        if (zipName_len >= nameSize) {
+            return NULL;
+        }
+        strcpy(name, zipName);
+        name[zipName_len - 3] = fileName[fileName_len - 3];
+        name[zipName_len - 2] = fileName[fileName_len - 2];
+        name[zipName_len - 1] = fileName[fileName_len - 1];
+        return name;
+    }
+    return fileName;
+}
+
 /******************************************************************************
 *** Description
 ***     Load a file in a zip file into memory.
@@ -417,112 +781,200 @@ int memFileSave(const char* zipName, const char* filename, int append, void* buf
 ***
 *******************************************************************************
 */
-void* _zipLoadFile(const char* zipName, const char* fileName, int* size, zlib_filefunc_def* filefunc)
+void* zipLoadFile(const char* zipName, const char* fileName, int* size)
 {
     void* buf;
-    char name[256];
-    unzFile zip;
+    char buffer[512];
+    const char* name;
+    ZipArchive* archive;
+    ZipEntry* entry;
     unz_file_info info;
-    size_t zipName_len;
-    size_t fileName_len = strlen(fileName);
+    int read;
+
+    if (strncmp(zipName, "mem", 3) == 0) {
+        return memFileLoad(zipName, fileName, size);
+    }
 
     *size = 0;
 
-    if (fileName[0] == '*') {
-        strcpy(name, zipName);
-        zipName_len = strlen(zipName);
-        name[zipName_len - 3] = fileName[fileName_len - 3];
-        name[zipName_len - 2] = fileName[fileName_len - 2];
-        name[zipName_len - 1] = fileName[fileName_len - 1];
-    }
-    else
-        strcpy(name, fileName);
+    name = zipResolveName(zipName, fileName, buffer, sizeof(buffer));
+    if (name == NULL)
+        return NULL;
 
-    if (!(zip = unzOpen2(zipName, filefunc)))
+    archive = zipArchiveOpen(zipName);
+    if (archive == NULL)
         return NULL;
 
-#ifdef __APPLE__
-    // Most OS X installs are on a case-insensitive FS
-    if (unzLocateFile(zip, name, 2) == UNZ_END_OF_LIST_OF_FILE) {
-#else
-    if (unzLocateFile(zip, name, 1) == UNZ_END_OF_LIST_OF_FILE) {
-#endif
-        unzClose(zip);
+    entry = zipArchiveFind(archive, name);
+    if (entry == NULL)
         return NULL;
-    }
 
-    if (unzOpenCurrentFile(zip) != UNZ_OK)
+    if (unzGoToFilePos(archive->zip, &entry->pos) != UNZ_OK ||
+        unzOpenCurrentFile(archive->zip) != UNZ_OK)
+    {
+        // The handle is in an unknown state, reopen it next time
+        zipArchiveClose(archive);
         return NULL;
+    }
 
-    unzGetCurrentFileInfo(zip,&info,NULL,0,NULL,0,NULL,0);
+    unzGetCurrentFileInfo(archive->zip, &info, NULL, 0, NULL, 0, NULL, 0);
 
     buf = malloc(info.uncompressed_size);
     *size = info.uncompressed_size;
 
     if (!buf) {
-        unzCloseCurrentFile(zip);
-        unzClose(zip);
+        unzCloseCurrentFile(archive->zip);
         return NULL;
     }
 
-    unzReadCurrentFile(zip, buf, info.uncompressed_size);
-    unzCloseCurrentFile(zip);
-    unzClose(zip);
+    // Closing the file checks the crc of the data that was read
+    read = unzReadCurrentFile(archive->zip, buf, info.uncompressed_size);
+    if (unzCloseCurrentFile(archive->zip) != UNZ_OK || read != (int)info.uncompressed_size) {
+        free(buf);
+        return NULL;
+    }
 
     return buf;
 }
 
-
 /******************************************************************************
 *** Description
-***     Read cache to speed-up reading multiple files from one zip.
+***     Incremental decompression of a file in a zip. Large disk and tape
+***     images are inflated on demand as the emulation reaches them
+***     instead of all at once when they are inserted.
 ***
 ******************************************************************************/
 
-static char *cacheData = NULL, cacheFile[512];
-static zlib_filefunc_def cacheFilefunc;
+#define ZIP_STREAM_CHUNK 0x10000
 
-void* zipLoadFile(const char* zipName, const char* fileName, int* size)
+struct ZipStream {
+    unzFile zip;
+    int     size;
+    int     filled;
+    int     error;
+    int     closed;
+};
+
+ZipStream* zipStreamOpen(const char* zipName, const char* fileName, int* size)
 {
+    char buffer[512];
+    const char* name;
+    ZipArchive* archive;
+    ZipEntry* entry;
+    ZipStream* stream;
+    unz_file_info info;
+    unzFile zip;
+
     if (strncmp(zipName, "mem", 3) == 0) {
-        return memFileLoad(zipName, fileName, size);
+        return NULL;
     }
-    if( cacheData != NULL && *cacheFile != '\0' && 0==strcmp(cacheFile, zipName) ) {
-        return _zipLoadFile(cacheData, fileName, size, &cacheFilefunc);
-    }else{
-        return _zipLoadFile(zipName, fileName, size, NULL);
+
+    name = zipResolveName(zipName, fileName, buffer, sizeof(buffer));
+    if (name == NULL)
+        return NULL;
+
+    archive = zipArchiveOpen(zipName);
+    if (archive == NULL)
+        return NULL;
+
+    entry = zipArchiveFind(archive, name);
+    if (entry == NULL)
+        return NULL;
+
+    // The stream keeps a file open so it can't share the cached handle
+    zip = unzOpen(zipName);
+    if (zip == NULL)
+        return NULL;
+
+    if (unzGoToFilePos(zip, &entry->pos) != UNZ_OK ||
+        unzOpenCurrentFile(zip) != UNZ_OK)
+    {
+        unzClose(zip);
+        return NULL;
     }
+
+    unzGetCurrentFileInfo(zip, &info, NULL, 0, NULL, 0, NULL, 0);
+
+    stream = (ZipStream*)calloc(1, sizeof(ZipStream));
+    stream->zip  = zip;
+    stream->size = (int)info.uncompressed_size;
+
+    *size = stream->size;
+    return stream;
 }
 
-void zipCacheReadOnlyZip(const char* zipName)
+int zipStreamFill(ZipStream* stream, void* buffer, int end)
 {
-    if (zipName != NULL && strncmp(zipName, "mem", 3) == 0) {
+    int target;
+
+    if (end > stream->size) {
+        end = stream->size;
+    }
+    if (stream->filled >= end) {
+        return stream->filled;
+    }
+    if (stream->error) {
+        return -1;
+    }
+
+    // Inflate whole chunks to keep the number of calls down
+    target = (end + ZIP_STREAM_CHUNK - 1) & ~(ZIP_STREAM_CHUNK - 1);
+    if (target > stream->size) {
+        target = stream->size;
+    }
+
+    while (stream->filled < target) {
+        int rv = unzReadCurrentFile(stream->zip, (char*)buffer + stream->filled,
+                                    target - stream->filled);
+        if (rv <= 0) {
+            // Truncated or corrupt data, the rest of the file can't be read
+            stream->error = 1;
+            return stream->filled >= end ? stream->filled : -1;
+        }
+        stream->filled += rv;
+    }
+
+    if (stream->filled == stream->size) {
+        // The crc is checked when the file is closed. If it doesn't match
+        // none of the data can be trusted.
+        stream->closed = 1;
+        if (unzCloseCurrentFile(stream->zip) != UNZ_OK) {
+            stream->error  = 1;
+            stream->filled = 0;
+            return -1;
+        }
+    }
+
+    return stream->filled;
+}
+
+void zipStreamClose(ZipStream* stream)
+{
+    if (stream == NULL) {
         return;
     }
+    if (!stream->closed) {
+        unzCloseCurrentFile(stream->zip);
+    }
+    unzClose(stream->zip);
+    free(stream);
+}
 
-    *cacheFile = '\0';
-    if( cacheData != NULL ) {
-        free(cacheData);
-        cacheData = NULL;
-        free_fopen_memfunc(&cacheFilefunc);
-    }
-    if( zipName != NULL ) {
-        FILE *file;
-        file = fopen(zipName, "rb");
-        if( file != NULL ) {
-            unsigned int filesize;
-            fseek(file, 0, SEEK_END);
-            filesize = ftell(file);
-            fill_fopen_memfunc(&cacheFilefunc, filesize);
-            fseek(file, 0, SEEK_SET);
-            cacheData = (char*)malloc(filesize);
-            if( cacheData != NULL ) {
-                size_t size = fread(cacheData, 1, filesize, file);
-                if( size == filesize )
-                    strcpy(cacheFile, zipName);
-            }
-            fclose(file);
+// Opens and indexes a zip that is about to be read from several times.
+// Passing NULL closes all cached archives.
+void zipCacheReadOnlyZip(const char* zipName)
+{
+    int i;
+
+    if (zipName == NULL) {
+        for (i = 0; i < ZIP_CACHE_SIZE; i++) {
+            zipArchiveClose(zipArchives + i);
         }
+        return;
+    }
+
+    if (strncmp(zipName, "mem", 3) != 0) {
+        zipArchiveOpen(zipName);
     }
 }
 
@@ -549,6 +1001,8 @@ int zipSaveFile(const char* zipName, const char* fileName, int append, void* buf
         return memFileSave(zipName, fileName, append, buffer, size);
     }
 
+    zipArchiveInvalidate(zipName);
+
     zip = zipOpen(zipName, append ? 2 : 0);
     if (zip == NULL) {
         return 0;
@@ -571,37 +1025,27 @@ int zipSaveFile(const char* zipName, const char* fileName, int append, void* buf
 int zipHasFileType(char* zipName, char* ext) {
     char tempName[256];
     char extension[8];
-    unzFile zip;
-    unz_file_info info;
-    int found = 0;
-    int status;
+    ZipArchive* archive;
+    int i;
 
-    zip = unzOpen(zipName);
-    if (!zip) {
+    archive = zipArchiveOpen(zipName);
+    if (!archive) {
         return 0;
     }
 
     strcpy(extension, ext);
     toLower(extension);
 
-    status = unzGoToFirstFile(zip);
-    unzGetCurrentFileInfo(zip,&info,tempName,256,NULL,0,NULL,0);
-
-    while (status == UNZ_OK) {
-        unzGetCurrentFileInfo(zip, &info, tempName, 256, NULL, 0, NULL, 0);
+    for (i = 0; i < archive->count; i++) {
+        strcpy(tempName, archive->entries[i].name);
 
         toLower(tempName);
         if (strstr(tempName, extension) != NULL) {
-            found = 1;
-            break;
+            return 1;
         }
-
-        status = unzGoToNextFile(zip);
     }
 
-    unzClose(zip);
-
-    return found;
+    return 0;
 }
 
 /******************************************************************************
@@ -620,36 +1064,19 @@ int zipHasFileType(char* zipName, char* ext) {
 */
 int zipFileExists(const char* zipName, const char* fileName)
 {
-    char name[256];
-    unzFile zip;
+    char buffer[512];
+    const char* name;
+    ZipArchive* archive;
 
-    if (fileName[0] == '*')
-    {
-        size_t zipName_len  = strlen(zipName);
-	size_t fileName_len = strlen(fileName);
-        strcpy(name, zipName);
-        name[zipName_len - 3] = fileName[fileName_len - 3];
-        name[zipName_len - 2] = fileName[fileName_len - 2];
-        name[zipName_len - 1] = fileName[fileName_len - 1];
-    }
-    else
-        strcpy(name, fileName);
-
-    if (!(zip = unzOpen(zipName)))
+    name = zipResolveName(zipName, fileName, buffer, sizeof(buffer));
+    if (name == NULL)
         return 0;
 
-#ifdef __APPLE__
-    // Most OS X installs are on a case-insensitive FS
-    if (unzLocateFile(zip, name, 2) == UNZ_END_OF_LIST_OF_FILE) {
-#else
-    if (unzLocateFile(zip, name, 1) == UNZ_END_OF_LIST_OF_FILE) {
-#endif
-        unzClose(zip);
+    archive = zipArchiveOpen(zipName);
+    if (!archive)
         return 0;
-    }
 
-    unzClose(zip);
-    return 1;
+    return zipArchiveFind(archive, name) != NULL;
 }
 
 /******************************************************************************
@@ -669,32 +1096,26 @@ int zipFileExists(const char* zipName, const char* fileName)
 *******************************************************************************
 */
 char* zipGetFileList(const char* zipName, const char* ext, int* count) {
-    char tempName[256];
     char extension[8];
-    unzFile zip;
-    unz_file_info info;
+    ZipArchive* archive;
     char* fileArray = NULL;
     int totalLen = 0;
-    int status;
+    int i;
 
     *count = 0;
 
-    zip = unzOpen(zipName);
-    if (!zip) {
+    archive = zipArchiveOpen(zipName);
+    if (!archive) {
         return 0;
     }
 
     strcpy(extension, ext);
     toLower(extension);
 
-    status = unzGoToFirstFile(zip);
-    unzGetCurrentFileInfo(zip,&info,tempName,256,NULL,0,NULL,0);
-
-    while (status == UNZ_OK) {
+    for (i = 0; i < archive->count; i++) {
+        const char* tempName = archive->entries[i].name;
         char tmp[256];
 
-        unzGetCurrentFileInfo(zip, &info, tempName, 256, NULL, 0, NULL, 0);
-
         strcpy(tmp, tempName);
 
         toLower(tmp);
@@ -707,12 +1128,8 @@ char* zipGetFileList(const char* zipName, const char* ext, int* count) {
 
             *count = *count + 1;
         }
-
-        status = unzGoToNextFile(zip);
     }
 
-    unzClose(zip);
-
     return fileArray;
 }
 
@@ -39,8 +39,25 @@ typedef void(*ZIP_EXTRACT_CB)(int, int);
 void memZipFileSystemCreate(int maxFiles);
 void memZipFileSystemDestroy();
 
+// Flattens a memory zip file into a buffer. Returns the size needed, the
+// buffer is only written if it is big enough.
+int memZipFileSerialize(const char* zipName, void* buffer, int bufferSize);
+// Replaces a memory zip file with the contents of a flattened one.
+int memZipFileDeserialize(const char* zipName, const void* buffer, int size);
+
 void zipCacheReadOnlyZip(const char* zipName);
 void* zipLoadFile(const char* zipName, const char* fileName, int* size);
+
+// Inflates a file in a zip on demand. The caller allocates a buffer of
+// *size bytes. zipStreamFill decompresses at least up to offset end into
+// the buffer and returns the number of valid bytes, or -1 if the data up
+// to end can't be inflated. zipStreamOpen returns
+// NULL if the file can't be streamed, zipLoadFile should be used then.
+typedef struct ZipStream ZipStream;
+ZipStream* zipStreamOpen(const char* zipName, const char* fileName, int* size);
+int zipStreamFill(ZipStream* stream, void* buffer, int end);
+void zipStreamClose(ZipStream* stream);
+
 int zipSaveFile(const char* zipName, const char* fileName, int append, void* buffer, int size);
 int zipFileExists(const char* zipName, const char* fileName);
 char* zipGetFileList(const char* zipName, const char* ext, int* count);
@@ -49,7 +66,7 @@ int zipExtractCurrentfile(unzFile uf, int overwrite, const char* password);
 int zipExtract(unzFile uf, int overwrite, const char* password, ZIP_EXTRACT_CB progress_callback);
 void* zipCompress(void* buffer, int size, unsigned long* retSize);
 // Note: retSize in zipUncompress is input/output parameter and need to be set to unzipped buffer size
-void* zipUncompress(void* buffer, int size, unsigned long* retSize); 
+void* zipUncompress(void* buffer, int size, unsigned long* retSize); 
 
 #ifdef __cplusplus
 }
@@ -17,6 +17,7 @@
 #include "VDP.h"
 #include "Board.h"
 #include "SaveState.h"
+#include "PerfCounters.h"
 
 /*************************************************************
 ** Different compilers inline C functions differently.
@@ -984,6 +985,8 @@ void vdpCmdDestroy(VdpCmdState* vdpCmd)
 */
 static void vdpCmdSetCommand(VdpCmdState* vdpCmd, UInt32 systemTime)
 {
+    perfCounters.vdpCommands[vdpCmd->CM & 0x0f]++;
+
     vdpCmd->screenMode = vdpCmd->newScrMode;
 
     if (vdpCmd->screenMode < 0) {
@@ -33,6 +33,7 @@
 #include "SaveState.h"
 #include "DeviceManager.h"
 #include "DebugDeviceManager.h"
+#include "PerfCounters.h"
 #include "FrameBuffer.h"
 #include "ArchVideoIn.h"
 #include "Language.h"
@@ -988,6 +989,8 @@ static UInt8 readNoTimingCheck(VDP* vdp, UInt16 ioPort)
     if (vdp->vdpVersion == VDP_V9938 || vdp->vdpVersion == VDP_V9958)
         vdpCmdExecute(vdp->cmdEngine, boardSystemTime());
 
+    perfCounters.vramReads++;
+
     value            = vdp->vdpData;
     vdp->vdpData     = vdp->vramEnable ? *MAP_VRAM(vdp, (vdp->vdpRegs[14] << 14) | vdp->vramAddress) : 0xff;
     vdp->vramAddress = (vdp->vramAddress + 1) & 0x3fff;
@@ -1136,6 +1139,7 @@ static void write(VDP* vdp, UInt16 ioPort, UInt8 value)
         int index = MAP_VRAMINDEX(vdp, (vdp->vdpRegs[14] << 14) | vdp->vramAddress);
         if (!(index & ~vdp->vramAccMask)) {
             vdp->vram[index] = value;
+            perfCounters.vramWrites++;
 
             tryWatchpoint(DBGTYPE_VIDEO, index, value, vdp, peekVram);
 //        printf("W(0x%.4x): %.2x\n", (vdp->vdpRegs[14] << 14) | vdp->vramAddress, value);
@@ -188,13 +188,52 @@ static UInt8 readMem(R800* r800, UInt16 address) {
     return r800->readMemory(r800->ref, address);
 }
 
+#ifdef ENABLE_EXEC_TRACE
+static void traceInstruction(R800* r800) {
+    R800TraceEntry* entry = r800->traceBuffer + r800->traceIndex;
+
+    entry->time    = r800->systemTime;
+    entry->pc      = r800->regs.PC.W;
+    entry->context = r800->traceContext != NULL ? *r800->traceContext : 0;
+    entry->length  = 0;
+
+    if (r800->traceRegs != NULL) {
+        R800TraceRegs* regs = r800->traceRegs + r800->traceIndex;
+        regs->AF = r800->regs.AF.W;
+        regs->BC = r800->regs.BC.W;
+        regs->DE = r800->regs.DE.W;
+        regs->HL = r800->regs.HL.W;
+        regs->IX = r800->regs.IX.W;
+        regs->IY = r800->regs.IY.W;
+        regs->SP = r800->regs.SP.W;
+    }
+
+    r800->traceEntry = entry;
+    r800->traceIndex = (r800->traceIndex + 1) & r800->traceMask;
+    if (r800->traceCount <= r800->traceMask) {
+        r800->traceCount++;
+    }
+}
+#endif
+
 static UInt8 readOpcode(R800* r800, UInt16 address) {
+    UInt8 value;
+
     delayMemOp(r800);
     if ((address >> 8) ^ r800->cachePage) {
         r800->cachePage = address >> 8;
         delayMemPage(r800);
     }
-    return r800->readMemory(r800->ref, address);
+    value = r800->readMemory(r800->ref, address);
+
+#ifdef ENABLE_EXEC_TRACE
+    // The opcode bytes are stored as they are fetched so the trace
+    // doesn't need to read memory again
+    if (r800->traceEntry != NULL && r800->traceEntry->length < 4) {
+        r800->traceEntry->opcode[r800->traceEntry->length++] = value;
+    }
+#endif
+    return value;
 }
 
 static void writeMem(R800* r800, UInt16 address, UInt8 value) {
@@ -5872,6 +5911,7 @@ R800* r800Create(UInt32 cpuFlags,
 }
 
 void r800Destroy(R800* r800) {
+    r800TraceEnable(r800, 0, 0);
     free(r800);
 }
 
@@ -6038,6 +6078,75 @@ SystemTime r800GetTimeTrace(R800* r800, int offset) {
 #endif
 }
 
+void r800TraceEnable(R800* r800, UInt32 entries, int registers)
+{
+#ifdef ENABLE_EXEC_TRACE
+    UInt32 size = 1;
+
+    free(r800->traceBuffer);
+    free(r800->traceRegs);
+    r800->traceBuffer = NULL;
+    r800->traceRegs   = NULL;
+    r800->traceEntry  = NULL;
+    r800->traceMask   = 0;
+    r800->traceIndex  = 0;
+    r800->traceCount  = 0;
+
+    if (entries == 0) {
+        return;
+    }
+
+    while (size < entries && size < 0x40000000) {
+        size <<= 1;
+    }
+
+    r800->traceBuffer = calloc(size, sizeof(R800TraceEntry));
+    if (registers) {
+        r800->traceRegs = calloc(size, sizeof(R800TraceRegs));
+    }
+
+    if (r800->traceBuffer == NULL || (registers && r800->traceRegs == NULL)) {
+        r800TraceEnable(r800, 0, 0);
+        return;
+    }
+
+    r800->traceMask = size - 1;
+#endif
+}
+
+void r800SetTraceContext(R800* r800, const UInt16* context)
+{
+#ifdef ENABLE_EXEC_TRACE
+    r800->traceContext = context;
+#endif
+}
+
+UInt32 r800TraceGetCount(R800* r800)
+{
+#ifdef ENABLE_EXEC_TRACE
+    return r800->traceCount;
+#else
+    return 0;
+#endif
+}
+
+const R800TraceEntry* r800TraceGetEntry(R800* r800, UInt32 offset, const R800TraceRegs** regs)
+{
+#ifdef ENABLE_EXEC_TRACE
+    UInt32 index = (r800->traceIndex - r800->traceCount + offset) & r800->traceMask;
+
+    if (regs != NULL) {
+        *regs = r800->traceRegs != NULL ? r800->traceRegs + index : NULL;
+    }
+    return r800->traceBuffer + index;
+#else
+    if (regs != NULL) {
+        *regs = NULL;
+    }
+    return NULL;
+#endif
+}
+
 void r800Execute(R800* r800) {
     static SystemTime lastRefreshTime = 0;
     while (!r800->terminate) {
@@ -6080,6 +6189,11 @@ void r800Execute(R800* r800) {
         }
 #endif
 
+#ifdef ENABLE_EXEC_TRACE
+        if (r800->traceBuffer != NULL) {
+            traceInstruction(r800);
+        }
+#endif
         executeInstruction(r800, readOpcode(r800, r800->regs.PC.W++));
 
         if (r800->regs.halt)
@@ -6180,6 +6294,11 @@ void r800ExecuteUntil(R800* r800, UInt32 endTime) {
         }
 #endif
 
+#ifdef ENABLE_EXEC_TRACE
+        if (r800->traceBuffer != NULL) {
+            traceInstruction(r800);
+        }
+#endif
         executeInstruction(r800, readOpcode(r800, r800->regs.PC.W++));
 
         if (!r800->regs.halt) { 
@@ -6275,6 +6394,11 @@ void r800ExecuteInstruction(R800* r800) {
     }
 #endif
 
+#ifdef ENABLE_EXEC_TRACE
+    if (r800->traceBuffer != NULL) {
+        traceInstruction(r800);
+    }
+#endif
     executeInstruction(r800, readOpcode(r800, r800->regs.PC.W++));
 
     if (!r800->regs.halt) { 
@@ -91,6 +91,7 @@
 #define ENABLE_WATCHPOINTS
 #define ENABLE_ASMSX_DEBUG_COMMANDS
 #define ENABLE_TRAP_CALLBACK
+#define ENABLE_EXEC_TRACE
 #define TIME_TRACE_SIZE 1024
 #endif
 
@@ -214,6 +215,42 @@ typedef void  (*R800TrapCb)(void*, UInt8);
 typedef void  (*R800TimerCb)(void*);
 
 
+/*****************************************************
+** R800TraceEntry
+**
+** Entry in the execution trace. One entry is written
+** for each executed instruction.
+******************************************************
+*/
+typedef struct {
+    SystemTime    time;             /* System time before execution    */
+    UInt16        pc;               /* Address of the instruction      */
+    UInt16        context;          /* Owner defined, e.g. slot mapping*/
+    UInt8         opcode[4];        /* Instruction bytes as fetched    */
+    UInt8         length;           /* Number of valid opcode bytes    */
+    UInt8         reserved[3];
+} R800TraceEntry;
+
+
+/*****************************************************
+** R800TraceRegs
+**
+** Optional register snapshot taken before each traced
+** instruction.
+******************************************************
+*/
+typedef struct {
+    UInt16        AF;
+    UInt16        BC;
+    UInt16        DE;
+    UInt16        HL;
+    UInt16        IX;
+    UInt16        IY;
+    UInt16        SP;
+    UInt16        reserved;
+} R800TraceRegs;
+
+
 /*****************************************************
 ** Status flags.
 **
@@ -292,6 +329,16 @@ typedef struct
     UInt32        timeTraceIndex;
     UInt16        lastPC;
 #endif
+
+#ifdef ENABLE_EXEC_TRACE
+    R800TraceEntry* traceBuffer;    /* Execution trace ring or NULL    */
+    R800TraceRegs*  traceRegs;      /* Register snapshots or NULL      */
+    R800TraceEntry* traceEntry;     /* Entry of current instruction    */
+    UInt32        traceMask;        /* Ring size - 1                   */
+    UInt32        traceIndex;       /* Next entry in the ring          */
+    UInt32        traceCount;       /* Nr of valid entries             */
+    const UInt16* traceContext;     /* Value stored with each entry    */
+#endif
 } R800;
 
 
@@ -493,6 +540,58 @@ void r800ClearBreakpoint(R800* r800, UInt16 address);
 
 SystemTime r800GetTimeTrace(R800* r800, int offset);
 
+/************************************************************************
+** r800TraceEnable
+**
+** Starts recording the executed instructions in a ring buffer. The
+** buffer is allocated once and holds the last instructions executed.
+** Tracing costs one entry write per instruction while enabled.
+**
+** Arguments:
+**      r800        - Pointer to an R800 object
+**      entries     - Size of the ring, rounded up to a power of two.
+**                    Tracing is disabled if zero.
+**      registers   - Non zero to also store the registers before each
+**                    instruction
+*************************************************************************
+*/
+void r800TraceEnable(R800* r800, UInt32 entries, int registers);
+
+/************************************************************************
+** r800SetTraceContext
+**
+** Sets a value that is stored with each trace entry, e.g. the current
+** slot mapping. The value is read when an instruction is traced.
+**
+** Arguments:
+**      r800        - Pointer to an R800 object
+**      context     - Pointer to the value or NULL
+*************************************************************************
+*/
+void r800SetTraceContext(R800* r800, const UInt16* context);
+
+/************************************************************************
+** r800TraceGetCount
+**
+** Returns the number of entries available in the trace.
+*************************************************************************
+*/
+UInt32 r800TraceGetCount(R800* r800);
+
+/************************************************************************
+** r800TraceGetEntry
+**
+** Returns a trace entry. Offset 0 is the oldest entry available.
+**
+** Arguments:
+**      r800        - Pointer to an R800 object
+**      offset      - Entry offset, less than r800TraceGetCount()
+**      regs        - Set to the register snapshot of the entry or NULL
+**                    if registers aren't traced. May be NULL.
+*************************************************************************
+*/
+const R800TraceEntry* r800TraceGetEntry(R800* r800, UInt32 offset, const R800TraceRegs** regs);
+
 /************************************************************************
 ** r800GetSystemTime
 **
@@ -3,6 +3,7 @@
 **      R800Dasm.c
 **
 ** The r800ExecuteTrace extend the R800 emulation with CPU trace output.
+** r800DumpTrace writes the execution trace ring of the R800 as text.
 ** The r800Dasm function and mnemonic tables are based of code from openMSX 
 ** and is licensed under GPL. 
 ******************************************************************************
@@ -197,7 +198,28 @@ static const char* mnemonicMain[256] =
 #define ABS(val)  (((val) & 128) ? 256 - (val) : val)
 
 
-int r800Dasm(R800* r800, UInt16 PC, char* dest)
+// Instructions are read either from memory or from the opcode bytes
+// stored in the execution trace
+typedef struct {
+    R800*        r800;
+    UInt16       start;
+    const UInt8* bytes;
+    int          length;
+} DasmSource;
+
+static UInt8 dasmRead(DasmSource* src, int pc)
+{
+    int offset;
+
+    if (src->bytes == NULL) {
+        return src->r800->readMemory(src->r800->ref, (UInt16)pc);
+    }
+
+    offset = (pc - src->start) & 0xffff;
+    return offset < src->length ? src->bytes[offset] : 0;
+}
+
+static int dasm(DasmSource* src, UInt16 PC, char* dest)
 {
 	const char* r = "INTERNAL PROGRAM ERROR";
 	char offset = 0;
@@ -213,25 +235,25 @@ int r800Dasm(R800* r800, UInt16 PC, char* dest)
 
 	dest[0] = '\0';
 
-    val0 = r800->readMemory(r800->ref, pc++);
+    val0 = dasmRead(src, pc++);
 
 	switch (val0) {
 	case 0xcb:
-        val1 = r800->readMemory(r800->ref, pc++);
+        val1 = dasmRead(src, pc++);
 		S = mnemonicCb[val1];
 		break;
 	case 0xed:
-        val1 = r800->readMemory(r800->ref, pc++);
+        val1 = dasmRead(src, pc++);
 		S = mnemonicEd[val1];
 		break;
 	case 0xdd:
 		r = "ix";
-        val1 = r800->readMemory(r800->ref, pc++);
+        val1 = dasmRead(src, pc++);
 		switch (val1) {
 		case 0xcb:
-            val2 = r800->readMemory(r800->ref, pc++);
+            val2 = dasmRead(src, pc++);
 			offset = val2;
-			S = mnemonicXxCb[r800->readMemory(r800->ref, pc++)];
+			S = mnemonicXxCb[dasmRead(src, pc++)];
 			break;
 		default:
 			S = mnemonicXx[val1];
@@ -240,12 +262,12 @@ int r800Dasm(R800* r800, UInt16 PC, char* dest)
 		break;
 	case 0xfd:
 		r = "iy";
-        val1 = r800->readMemory(r800->ref, pc++);
+        val1 = dasmRead(src, pc++);
 		switch (val1) {
 		case 0xcb:
-            val2 = r800->readMemory(r800->ref, pc++);
+            val2 = dasmRead(src, pc++);
 			offset = val2;
-			S = mnemonicXxCb[r800->readMemory(r800->ref, pc++)];
+			S = mnemonicXxCb[dasmRead(src, pc++)];
 			break;
 		default:
 			S = mnemonicXx[val1];
@@ -260,20 +282,20 @@ int r800Dasm(R800* r800, UInt16 PC, char* dest)
 	for (j = 0; S[j]; j++) {
 		switch (S[j]) {
 		case 'B':
-			sprintf(buf, "#%02x", r800->readMemory(r800->ref, pc++));
+			sprintf(buf, "#%02x", dasmRead(src, pc++));
 			strcat(dest, buf);
 			break;
 		case 'R':
-			sprintf (buf, "#%04x", (PC + 2 + (Int8)r800->readMemory(r800->ref, pc++)) & 0xFFFF);
+			sprintf (buf, "#%04x", (PC + 2 + (Int8)dasmRead(src, pc++)) & 0xFFFF);
 			strcat(dest, buf);
 			break;
 		case 'W':
-            val = r800->readMemory(r800->ref, pc++);
-			sprintf(buf, "#%04x", val + r800->readMemory(r800->ref, pc++) * 256);
+            val = dasmRead(src, pc++);
+			sprintf(buf, "#%04x", val + dasmRead(src, pc++) * 256);
 			strcat(dest, buf);
 			break;
 		case 'X':
-            val = r800->readMemory(r800->ref, pc++);
+            val = dasmRead(src, pc++);
 			sprintf(buf, "(%s%c#%02x)", r, SIGN(val), ABS(val));
 			strcat(dest, buf);
 			break;
@@ -330,6 +352,76 @@ int r800Dasm(R800* r800, UInt16 PC, char* dest)
 	return pc - PC;
 }
 
+int r800Dasm(R800* r800, UInt16 PC, char* dest)
+{
+    DasmSource src;
+
+    src.r800   = r800;
+    src.start  = PC;
+    src.bytes  = NULL;
+    src.length = 0;
+
+    return dasm(&src, PC, dest);
+}
+
+int r800DasmBytes(UInt16 PC, const UInt8* bytes, int length, char* dest)
+{
+    DasmSource src;
+
+    src.r800   = NULL;
+    src.start  = PC;
+    src.bytes  = bytes;
+    src.length = length;
+
+    return dasm(&src, PC, dest);
+}
+
+int r800DumpTrace(R800* r800, const char* filename, UInt32 count)
+{
+    char mnemonic[64];
+    UInt32 available = r800TraceGetCount(r800);
+    UInt32 i;
+    FILE* file;
+
+    if (available == 0) {
+        return 0;
+    }
+
+    file = fopen(filename, "w");
+    if (file == NULL) {
+        return 0;
+    }
+
+    if (count == 0 || count > available) {
+        count = available;
+    }
+
+    for (i = available - count; i < available; i++) {
+        const R800TraceRegs* regs;
+        const R800TraceEntry* entry = r800TraceGetEntry(r800, i, &regs);
+
+        r800DasmBytes(entry->pc, entry->opcode, entry->length, mnemonic);
+
+        fprintf(file, "%.08x %.04x %.04x : %s", entry->time, entry->context, entry->pc, mnemonic);
+        if (regs != NULL) {
+            fprintf(file, " AF=%.04x"
+                          " BC=%.04x"
+                          " DE=%.04x"
+                          " HL=%.04x"
+                          " IX=%.04x"
+                          " IY=%.04x"
+                          " SP=%.04x",
+                          regs->AF, regs->BC, regs->DE, regs->HL,
+                          regs->IX, regs->IY, regs->SP);
+        }
+        fprintf(file, "\n");
+    }
+
+    fclose(file);
+
+    return 1;
+}
+
 int r800OpenTrace(const char* filename)
 {
     r800CloseTrace();
@@ -35,5 +35,12 @@ int r800OpenTrace(const char* filename);
 void r800CloseTrace();
 
 int r800Dasm(R800* r800, UInt16 PC, char* dest);
+int r800DasmBytes(UInt16 PC, const UInt8* bytes, int length, char* dest);
+
+// Writes the last count entries of the execution trace to a text file,
+// all entries if count is zero. Each line holds the system time, the
+// trace context, the address and the instruction, followed by the
+// registers if they are traced.
+int r800DumpTrace(R800* r800, const char* filename, UInt32 count);
 
 #endif
@@ -30,6 +30,11 @@
 #include "JoystickPort.h"
 #include "InputEvent.h"
 #include "R800.h"
+#include "Disk.h"
+#include "FileWriter.h"
+#include "PerfCounters.h"
+#include "FrameStats.h"
+#include "ArchTimer.h"
 #include "Src/Utils/SaveState.h"
 
 #include "ziphelper.c"
@@ -61,11 +66,26 @@ static char msx_type[256];
 static char msx_cartmapper[256];
 static bool mapper_auto;
 bool is_coleco, is_sega, is_spectra, is_auto, auto_rewind_cas;
+static unsigned cpu_trace_entries;
+static unsigned hotpath_stats_interval;
+static unsigned frame_stats_interval;
+static UInt32 frame_stats_samples;
 static unsigned msx_vdp_synctype;
 static bool msx_ym2413_enable;
 static bool msx_scc_enable;
 static bool msx_moonsound_enable;
 static bool msx_yamaha_sfg_enable;
+#if defined(SF2000)
+static MixerResampleMode msx_resample_mode = MIXER_RESAMPLE_LINEAR;
+#else
+static MixerResampleMode msx_resample_mode = MIXER_RESAMPLE_SINC;
+#endif
+static unsigned msx_audio_rate = AUDIO_SAMPLERATE;
+static int msx_audio_threads = 0;
+static unsigned frameskip_type = 0;
+static unsigned frameskip_counter = 0;
+static bool audio_buffer_underrun = false;
+static bool skip_frame = false;
 static bool use_overscan = true;
 int msx2_dif = 0;
 
@@ -328,6 +348,7 @@ static bool read_m3u(const char *file)
 }
 
 extern BoardInfo boardInfo;
+extern UInt32 archSoundGetWrittenFrames(void);
 
 #define MAX_PADS 2
 static unsigned input_devices[MAX_PADS];
@@ -528,7 +549,7 @@ void retro_get_system_av_info(struct retro_system_av_info *info)
    info->geometry.max_height = FB_MAX_LINES ;
    info->geometry.aspect_ratio = 0;
    info->timing.fps = (retro_get_region() == RETRO_REGION_NTSC) ? 60.0 : 50.0;
-   info->timing.sample_rate = 44100.0;
+   info->timing.sample_rate = mixer ? mixerGetSampleRate(mixer) : AUDIO_SAMPLERATE;
 }
 
 void init_input_descriptors(unsigned device){
@@ -603,6 +624,9 @@ void retro_init(void)
 
 void retro_deinit(void)
 {
+   diskFlush();
+   fileWriterShutdown();
+
 #ifdef LOG_PERFORMANCE
    perf_cb.perf_log();
 #endif
@@ -689,6 +713,41 @@ static void extract_directory(char *buf, const char *path, size_t size)
       buf[0] = '\0';
 }
 
+#define FRAMESKIP_MAX 3
+
+static void audio_buffer_status_cb(bool active, unsigned occupancy, bool underrun_likely)
+{
+   audio_buffer_underrun = active && underrun_likely;
+}
+
+static void update_audio_buffer_status(void)
+{
+   struct retro_audio_buffer_status_callback buf_status_cb;
+   bool can_dupe = false;
+   unsigned latency = 0;
+
+   buf_status_cb.callback = audio_buffer_status_cb;
+
+   /* Skipped frames are presented as dupes */
+   environ_cb(RETRO_ENVIRONMENT_GET_CAN_DUPE, &can_dupe);
+
+   if (frameskip_type && can_dupe &&
+       environ_cb(RETRO_ENVIRONMENT_SET_AUDIO_BUFFER_STATUS_CALLBACK, &buf_status_cb))
+   {
+      /* Leave room for a few skipped frames in the frontend buffer */
+      latency = (FRAMESKIP_MAX + 3) * 1000 / (retro_get_region() == RETRO_REGION_NTSC ? 60 : 50);
+   }
+   else
+   {
+      environ_cb(RETRO_ENVIRONMENT_SET_AUDIO_BUFFER_STATUS_CALLBACK, NULL);
+      frameskip_type = 0;
+   }
+
+   audio_buffer_underrun = false;
+   frameskip_counter     = 0;
+   environ_cb(RETRO_ENVIRONMENT_SET_MINIMUM_AUDIO_LATENCY, &latency);
+}
+
 static void check_variables(void)
 {
    struct retro_system_av_info av_info;
@@ -836,6 +895,64 @@ static void check_variables(void)
    else
       msx_yamaha_sfg_enable = true;
 
+   var.key = "bluemsx_audio_resampler";
+   var.value = NULL;
+
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+   {
+      MixerResampleMode mode = MIXER_RESAMPLE_SINC;
+
+      if (!strcmp(var.value, "Linear"))
+         mode = MIXER_RESAMPLE_LINEAR;
+      else if (!strcmp(var.value, "disabled"))
+         mode = MIXER_RESAMPLE_NONE;
+
+      if (mode != msx_resample_mode)
+      {
+         msx_resample_mode = mode;
+         if (mixer)
+            mixerSetResampleMode(mixer, msx_resample_mode);
+      }
+   }
+
+   var.key = "bluemsx_audio_rate";
+   var.value = NULL;
+
+   if (!mixer && environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+      msx_audio_rate = atoi(var.value);
+
+   var.key = "bluemsx_audio_threads";
+   var.value = NULL;
+
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+   {
+      int threads = 0;
+
+      if (strcmp(var.value, "disabled"))
+         threads = atoi(var.value);
+
+      if (threads != msx_audio_threads)
+      {
+         msx_audio_threads = threads;
+         if (mixer)
+            mixerSetThreadCount(mixer, msx_audio_threads);
+      }
+   }
+
+   var.key = "bluemsx_frameskip";
+   var.value = NULL;
+
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+   {
+      unsigned type = strcmp(var.value, "auto") ? 0 : 1;
+
+      if (type != frameskip_type)
+      {
+         frameskip_type = type;
+         update_audio_buffer_status();
+      }
+   }
+
    var.key = "bluemsx_cartmapper";
    var.value = NULL;
 
@@ -863,6 +980,39 @@ static void check_variables(void)
    else
       auto_rewind_cas = true;
 
+   var.key = "bluemsx_cpu_trace";
+   var.value = NULL;
+
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+      cpu_trace_entries = strtoul(var.value, NULL, 10);
+   else
+      cpu_trace_entries = 0;
+
+   var.key = "bluemsx_hotpath_stats";
+   var.value = NULL;
+
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+      hotpath_stats_interval = strtoul(var.value, NULL, 10);
+   else
+      hotpath_stats_interval = 0;
+
+   var.key = "bluemsx_frame_stats";
+   var.value = NULL;
+
+   {
+      unsigned interval = 0;
+
+      if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+         interval = strtoul(var.value, NULL, 10);
+
+      if (interval != frame_stats_interval)
+      {
+         frame_stats_interval = interval;
+         frame_stats_samples  = archSoundGetWrittenFrames();
+         frameStatsReset(interval);
+      }
+   }
+
    if (geometry_update)
    {
       retro_get_system_av_info(&av_info);
@@ -874,7 +1024,8 @@ bool retro_load_game(const struct retro_game_info *info)
 {
    const char *save_dir = NULL;
    int i, media_type;
-   char properties_dir[256], machines_dir[256], mediadb_dir[256];
+   char properties_dir[256], machines_dir[256], mediadb_dir[256], mediadb_cache[256], machines_cache[256];
+   char trace_file[256];
    const char *dir = NULL;
    enum retro_pixel_format fmt = RETRO_PIXEL_FORMAT_RGB565;
 
@@ -920,6 +1071,15 @@ bool retro_load_game(const struct retro_game_info *info)
 #if 0
    boardSetDirectory(buffer);
 #endif
+   snprintf(mediadb_cache, sizeof(mediadb_cache), "%s%c%s",
+         save_dir ? save_dir : properties_dir, SLASH, "bluemsx_mediadb.cache");
+   mediaDbSetCacheFile(mediadb_cache);
+   snprintf(machines_cache, sizeof(machines_cache), "%s%c%s",
+         save_dir ? save_dir : properties_dir, SLASH, "bluemsx_machines.cache");
+   machineSetCacheFile(machines_cache);
+   snprintf(trace_file, sizeof(trace_file), "%s%c%s",
+         save_dir ? save_dir : properties_dir, SLASH, "bluemsx_trace.txt");
+   boardSetCpuTrace(cpu_trace_entries, 1, trace_file);
    mediaDbLoad(mediadb_dir);
 #if 0
    mediaDbCreateRomdb();
@@ -962,6 +1122,10 @@ bool retro_load_game(const struct retro_game_info *info)
    properties->sound.chip.enableYamahaSFG = msx_yamaha_sfg_enable;
 
    mixer = mixerCreate();
+   mixerSetResampleMode(mixer, msx_resample_mode);
+   if (msx_resample_mode != MIXER_RESAMPLE_NONE)
+      mixerSetSampleRate(mixer, msx_audio_rate);
+   mixerSetThreadCount(mixer, msx_audio_threads);
 
    emulatorInit(properties, mixer);
    actionInit(video, properties, mixer);
@@ -1059,6 +1223,7 @@ bool retro_load_game(const struct retro_game_info *info)
 
    {
       Machine* machine = machineCreate(properties->emulation.machineName);
+      machineCacheFlush();
       if (!machine)
          return false;
       boardSetMachine(machine);
@@ -1074,6 +1239,7 @@ bool retro_load_game(const struct retro_game_info *info)
    boardSetVideoAutodetect(properties->video.detectActiveMonitor);
 
    emulatorStart(NULL);
+   perfCountersReset();
    return true;
 }
 
@@ -1091,11 +1257,50 @@ UInt8 archJoystickGetState(int joystickNo)
          (eventMap[EC_JOY1_BUTTON4] << 7));
 }
 
+static void log_stats_line(const char *line)
+{
+   log_cb(RETRO_LOG_INFO, "%s\n", line);
+}
+
+static void log_hotpath_stats(void)
+{
+   UInt32 frames;
+
+   perfCountersEndFrame();
+   perfCountersGetTotal(&frames);
+
+   if (hotpath_stats_interval && frames >= hotpath_stats_interval)
+   {
+      if (log_cb)
+         perfCountersReport(log_stats_line);
+      perfCountersReset();
+   }
+}
+
+static void log_frame_stats(const UInt32 *phase_time)
+{
+   UInt32 frames = archSoundGetWrittenFrames();
+   struct retro_system_av_info av_info;
+
+   frameStatsAdd(phase_time, frames - frame_stats_samples, audio_buffer_underrun);
+   frame_stats_samples = frames;
+
+   if (frameStatsGetCount() >= (int)frame_stats_interval)
+   {
+      retro_get_system_av_info(&av_info);
+      if (log_cb)
+         frameStatsReport(log_stats_line, av_info.timing.sample_rate / av_info.timing.fps);
+      frameStatsReset(frame_stats_interval);
+   }
+}
+
 void retro_run(void)
 {
    int i,j;
    bool updated = false;
    int16_t joypad_bits[MAX_PADS] = {0};
+   UInt32 phase_time[FRAME_PHASE_COUNT];
+   UInt32 time = 0;
    
    if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE_UPDATE, &updated) && updated)
       check_variables();
@@ -1268,16 +1473,52 @@ void retro_run(void)
    }
 #endif
 
+   /* Skip presenting frames while the frontend is about to run out of audio */
+   skip_frame = false;
+   if (frameskip_type && audio_buffer_underrun && frameskip_counter < FRAMESKIP_MAX)
+   {
+      skip_frame = true;
+      frameskip_counter++;
+   }
+   else
+      frameskip_counter = 0;
+
+   if (frame_stats_interval)
+      time = archGetSystemUpTime(1000000);
+
    ((R800*)boardInfo.cpuRef)->terminate = 0;
    boardInfo.run(boardInfo.cpuRef);   
+
+   if (frame_stats_interval)
+   {
+      phase_time[FRAME_PHASE_EMULATION] = archGetSystemUpTime(1000000) - time;
+      time += phase_time[FRAME_PHASE_EMULATION];
+   }
+
+   mixerFlush(mixer);
+
+   if (frame_stats_interval)
+   {
+      phase_time[FRAME_PHASE_MIXER] = archGetSystemUpTime(1000000) - time;
+      time += phase_time[FRAME_PHASE_MIXER];
+   }
+
+   log_hotpath_stats();
    RETRO_PERFORMANCE_STOP(core_retro_run);
 
-   if (!use_overscan)
+   if (skip_frame)
+      video_cb(NULL, image_buffer_current_width, image_buffer_height, image_buffer_current_width * sizeof(uint16_t));
+   else if (!use_overscan)
       video_cb(image_buffer + 8 + (image_buffer_current_width * sizeof(uint16_t) * (12 - (msx2_dif / 2))),
          image_buffer_current_width - 16, image_buffer_height - 48 + (msx2_dif * 2), image_buffer_current_width * sizeof(uint16_t));
    else
       video_cb(image_buffer, image_buffer_current_width, image_buffer_height, image_buffer_current_width * sizeof(uint16_t));
 
+   if (frame_stats_interval)
+   {
+      phase_time[FRAME_PHASE_VIDEO] = archGetSystemUpTime(1000000) - time;
+      log_frame_stats(phase_time);
+   }
 }
 
 /* framebuffer */
@@ -1289,6 +1530,8 @@ uint16_t* frameBufferGetLine(FrameBuffer* frameBuffer, int y)
 
 FrameBuffer* frameBufferGetDrawFrame(void)
 {
+   /* Skipped frames are still rendered, the VDP computes its sprite
+    * status flags while drawing lines */
    return (void*)image_buffer;
 }
 
@@ -1350,6 +1593,16 @@ bool retro_load_game_special(unsigned a, const struct retro_game_info *b, size_t
 
 void retro_unload_game(void)
 {
+   if (cpu_trace_entries)
+      boardDumpCpuTrace();
+
+   frameStatsDestroy();
+   frame_stats_interval = 0;
+
+   /* Write back cached disk sectors and wait for pending save data */
+   diskFlush();
+   fileWriterFlush();
+
    if (image_buffer)
       free(image_buffer);
    
@@ -1395,55 +1648,23 @@ void retro_cheat_set(unsigned a, bool b, const char * c){}
 
 bool retro_serialize(void *data, size_t size)
 {
-   int c;
-   MemZipFile * memZipFile;
-   size_t zip_size = 0, sz;
-   char * files;
-   MemFile * memFile;
+   int sz;
 
+   /* The memory zip file is kept between calls so its buffers are reused */
    boardSaveState("mem0",0);
-   memZipFile = memZipFileFind("mem0");
-   sz         = sizeof(memZipFile->count); 
-   memcpy(data, & memZipFile->count, sz); 
-   data       = (char*)data + sz;
+   sz = memZipFileSerialize("mem0", data, (int)size);
 
-   for (c = 0;c<memZipFile->count;c++)
-   {
-      memFile   = memZipFile->memFiles[c];
-      zip_size += sizeof(MemFile) + memFile->size;
-      sz        = sizeof(memFile->filename); 
-      memcpy(data, memFile->filename, sz); 
-      data      = (char*)data + sz;
-      sz        = sizeof(memFile->size);     
-      memcpy(data, &memFile->size, sz); 
-      data      = (char*)data + sz;
-      sz        = memFile->size;
-      memcpy(data, memFile->buffer, sz); 
-      data      = (char*)data + sz;
-   }
-
-   memZipFileDestroy(memZipFile);
-   return true;
+   return sz > 0 && sz <= (int)size;
 }
 
 bool retro_unserialize(const void *data, size_t size)
 {
-   int c;
-   int sz, count = * (int *) data;
-   char  * filename;
-   data = (char*)data + sizeof(int); 
-   for (c = 0; c < count; c++)
-   {
-      filename = (char *)data;
-      data     = (char*)data + sizeof(((MemFile*)0)->filename); 
-      sz       = * (int *)data;
-      data     = (char*)data + sizeof(int); 
-      zipSaveFile("mem0", filename, 1, (void*)data, sz );
-      data     = (char*)data + sz;
-   } 
+   if (!memZipFileDeserialize("mem0", data, (int)size))
+      return false;
+
    saveStateCreateForRead("mem0");
    boardInfo.loadState();
-   memZipFileDestroy(memZipFileFind("mem0"));
+   boardRestartTimers();
    return true;
 }
 
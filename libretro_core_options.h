@@ -128,6 +128,53 @@ struct retro_core_option_definition option_defs_us[] = {
       },
       "enabled"
    },
+   {
+      "bluemsx_audio_resampler",
+      "Audio Resampler",
+      "Sound chips render at their native rate and are converted to the output rate. 'Sinc' gives the best quality, 'Linear' is cheaper for slower devices. 'disabled' renders every chip directly at the output rate.",
+      {
+         { "Sinc",   NULL },
+         { "Linear",   NULL },
+         { "disabled",   NULL },
+         { NULL, NULL },
+      },
+      "Sinc"
+   },
+   {
+      "bluemsx_audio_rate",
+      "Audio Output Rate (Restart)",
+      "Sample rate reported to the frontend. Matching the frontend output rate avoids a second resampling pass. Ignored when the audio resampler is disabled.",
+      {
+         { "44100",   NULL },
+         { "48000",   NULL },
+         { NULL, NULL },
+      },
+      "44100"
+   },
+   {
+      "bluemsx_frameskip",
+      "Frameskip",
+      "Skips presenting up to 3 frames in a row when the frontend reports that its audio buffer is about to underrun, so the frontend saves the time to upload and display them. Keeps audio smooth on devices that cannot hold full speed. Requires frontend support for audio buffer status reporting.",
+      {
+         { "disabled",   NULL },
+         { "auto",   NULL },
+         { NULL, NULL },
+      },
+      "disabled"
+   },
+   {
+      "bluemsx_audio_threads",
+      "Audio Worker Threads",
+      "Renders the sound chips on worker threads in parallel with each other. Helps machines with several FM chips on multi core devices. Has no effect on platforms without thread support.",
+      {
+         { "disabled",   NULL },
+         { "1",   NULL },
+         { "2",   NULL },
+         { "3",   NULL },
+         { NULL, NULL },
+      },
+      "disabled"
+   },
    {
       "bluemsx_cartmapper",
       "Cart Mapper Type (Restart)",
@@ -181,6 +228,45 @@ struct retro_core_option_definition option_defs_us[] = {
       },
       "ON"
    },
+   {
+      "bluemsx_cpu_trace",
+      "CPU Trace Buffer (Restart)",
+      "Keeps the last executed instructions with their slot selection and registers in memory. The trace is written to bluemsx_trace.txt in the save directory when the content is closed.",
+      {
+         { "disabled", NULL },
+         { "65536",    NULL },
+         { "1048576",  NULL },
+         { "4194304",  NULL },
+         { NULL, NULL },
+      },
+      "disabled"
+   },
+   {
+      "bluemsx_hotpath_stats",
+      "Hot Path Statistics Log",
+      "Counts I/O port accesses, slot switches, mapper bank switches, VRAM accesses and VDP commands, and writes the per frame averages to the log at the selected interval in frames.",
+      {
+         { "disabled", NULL },
+         { "60",       NULL },
+         { "300",      NULL },
+         { "3000",     NULL },
+         { NULL, NULL },
+      },
+      "disabled"
+   },
+   {
+      "bluemsx_frame_stats",
+      "Frame Time Statistics Log",
+      "Measures the time spent in emulation, audio mixing and video output and the audio produced per frame, and writes the frame time percentiles and averages to the log at the selected interval in frames.",
+      {
+         { "disabled", NULL },
+         { "60",       NULL },
+         { "300",      NULL },
+         { "3000",     NULL },
+         { NULL, NULL },
+      },
+      "disabled"
+   },
    { NULL, NULL, NULL, {{0}}, NULL },
 };
 
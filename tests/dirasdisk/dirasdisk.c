@@ -0,0 +1,111 @@
+/*****************************************************************************
+** File: dirasdisk.c
+**
+** More info: http://www.bluemsx.com
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+**
+******************************************************************************
+*/
+#include "DirAsDisk.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Directory as disk reload test. A file in a directory is rewritten with
+// new contents of the same size, and its modification time is set to the
+// same second as before. Inserting the directory again must still pick
+// up the new contents instead of the image built the first time.
+//
+// Usage: dirasdisk [directory]
+
+#define OLD_CONTENTS "DIRASDISK TEST OLD CONTENTS"
+#define NEW_CONTENTS "DIRASDISK TEST NEW CONTENTS"
+#define FILE_TIME    1000000000
+
+static int writeFile(const char* filename, const char* contents, long nsec)
+{
+    struct timespec times[2];
+    FILE* f = fopen(filename, "wb");
+
+    if (f == NULL) {
+        return 0;
+    }
+    fwrite(contents, 1, strlen(contents), f);
+    fclose(f);
+
+    times[0].tv_sec  = FILE_TIME;
+    times[0].tv_nsec = nsec;
+    times[1]         = times[0];
+    return utimensat(AT_FDCWD, filename, times, 0) == 0;
+}
+
+static int contains(const UInt8* image, int size, const char* contents)
+{
+    int length = strlen(contents);
+    int i;
+
+    for (i = 0; i + length <= size; i++) {
+        if (memcmp(image + i, contents, length) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int loadDirectory(const char* directory, const char* contents, const char* step)
+{
+    int size;
+    UInt8* image = (UInt8*)dirLoadFile(DDT_MSX, directory, &size);
+    int found = image != NULL && contains(image, size, contents);
+
+    free(image);
+    if (!found) {
+        printf("dirasdisk: FAILED %s image doesn't hold '%s'\n", step, contents);
+    }
+    return found;
+}
+
+int main(int argc, char** argv)
+{
+    const char* directory = argc > 1 ? argv[1] : "tests/dirasdisk/work";
+    char filename[512];
+    int status = 1;
+
+    mkdir(directory, 0777);
+    sprintf(filename, "%s/TEST.TXT", directory);
+
+    if (!writeFile(filename, OLD_CONTENTS, 100000)) {
+        printf("dirasdisk: FAILED can't write %s\n", filename);
+        return 1;
+    }
+    if (loadDirectory(directory, OLD_CONTENTS, "first")) {
+        if (!writeFile(filename, NEW_CONTENTS, 200000)) {
+            printf("dirasdisk: FAILED can't rewrite %s\n", filename);
+        }
+        else if (loadDirectory(directory, NEW_CONTENTS, "reloaded")) {
+            printf("dirasdisk: passed\n");
+            status = 0;
+        }
+    }
+
+    remove(filename);
+    rmdir(directory);
+
+    return status;
+}
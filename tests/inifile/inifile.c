@@ -0,0 +1,229 @@
+/*****************************************************************************
+** File: inifile.c
+**
+** More info: http://www.bluemsx.com
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+**
+******************************************************************************
+*/
+#include "IniFileParser.h"
+#include "ArchGlob.h"
+#include "ArchTimer.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+// INI file lookup test. Small files are written to the work directory and
+// every lookup must return what a scan of the section for the first line
+// starting with the entry name returns.
+//
+// With -bench the config of every machine in the machines directory is
+// opened the given number of times, every entry of it is looked up, and
+// the total time is printed.
+//
+// Usage: inifile <work dir>
+//        inifile -bench <machines dir> [rounds]
+
+#define BENCH_ROUNDS 20
+#define MAX_SECTIONS 64
+#define MAX_NAME     64
+
+typedef struct {
+    const char* contents;
+    const char* section;
+    const char* entry;
+    const char* value;
+} IniTest;
+
+typedef struct {
+    char filename[512];
+    char sections[MAX_SECTIONS][MAX_NAME];
+    int  sectionCount;
+} BenchMachine;
+
+static const IniTest tests[] = {
+    // An earlier line starting with the entry wins over the exact key
+    { "[S]\nfoo2=a\nfoo=b\n",                  "S", "foo",  "a" },
+    { "[S]\nfoo2=a\nfoo=b\n",                  "S", "foo2", "a" },
+    // An earlier line without a value hides the key
+    { "[S]\nfoo\nfoo=1\n",                     "S", "foo",  "default" },
+    { "[S]\nfoo=1\nfoo2=2\n",                  "S", "foo",  "1" },
+    { "[S]\nfoo=1\nfoo2=2\n",                  "S", "foo2", "2" },
+    { "[S]\nfoo=1\nfoo2=2\n",                  "S", "fo",   "1" },
+    { "[S]\nbar=x\n=y\n",                      "S", "",     "x" },
+    // Only the first key and the first section of a name are found
+    { "[S]\na=1\na=2\n",                       "S", "a",    "1" },
+    { "[S]\na=1\n[T]\nb=2\n[S]\na=3\nc=4\n",   "S", "a",    "1" },
+    { "[S]\na=1\n[T]\nb=2\n[S]\na=3\nc=4\n",   "S", "c",    "default" },
+    // Lines of other sections don't hide a key
+    { "[T]\nfoo2=z\n[S]\nfoo=b\n",             "S", "foo",  "b" },
+    { "[S]\nfoo=b\n[T]\nfo=z\n",               "S", "foo",  "b" },
+    // The value follows the last '='
+    { "[S]\nkey=a=b\n",                        "S", "key",  "b" },
+    { "[S]\nkey=1\r\n",                        "S", "key",  "1" },
+    // Lines before the first section and unterminated lines are not read
+    { "a=1\n[S]\nb=2\n",                       "S", "a",    "default" },
+    { "[S]\na=1",                              "S", "a",    "default" },
+};
+
+static int runTest(const IniTest* test, const char* filename)
+{
+    char buffer[256];
+    IniFile* iniFile;
+    FILE* f = fopen(filename, "wb");
+
+    if (f == NULL) {
+        printf("inifile: FAILED can't write %s\n", filename);
+        return 0;
+    }
+    fwrite(test->contents, 1, strlen(test->contents), f);
+    fclose(f);
+
+    iniFile = iniFileOpen(filename);
+    iniFileGetString(iniFile, (char*)test->section, (char*)test->entry, "default", buffer, sizeof(buffer));
+    iniFileClose(iniFile);
+    free(iniFile);
+
+    if (strcmp(buffer, test->value) != 0) {
+        printf("inifile: FAILED [%s] '%s' is '%s', expected '%s'\n",
+               test->section, test->entry, buffer, test->value);
+        return 0;
+    }
+    return 1;
+}
+
+// Reads the section names of a machine config, they are looked up again
+// through the parser on every round
+static int readSections(BenchMachine* machine)
+{
+    char line[256];
+    FILE* f = fopen(machine->filename, "r");
+
+    if (f == NULL) {
+        return 0;
+    }
+    machine->sectionCount = 0;
+    while (fgets(line, sizeof(line), f) != NULL && machine->sectionCount < MAX_SECTIONS) {
+        char* end = strchr(line, ']');
+        if (line[0] == '[' && end != NULL && end - line - 1 < MAX_NAME) {
+            *end = 0;
+            strcpy(machine->sections[machine->sectionCount++], line + 1);
+        }
+    }
+    fclose(f);
+
+    return 1;
+}
+
+// Opens a machine config and looks up every entry of every section
+static int loadMachine(BenchMachine* machine)
+{
+    static char buffer[10000];
+    char value[256];
+    IniFile* iniFile = iniFileOpen(machine->filename);
+    int lookups = 0;
+    int i;
+
+    for (i = 0; i < machine->sectionCount; i++) {
+        char* entry;
+
+        iniFileGetSection(iniFile, machine->sections[i], buffer, sizeof(buffer));
+        for (entry = buffer; *entry; entry += strlen(entry) + 1) {
+            char* eq = strchr(entry, '=');
+            if (eq != NULL) {
+                *eq = 0;
+                iniFileGetString(iniFile, machine->sections[i], entry, "", value, sizeof(value));
+                *eq = '=';
+                lookups++;
+            }
+        }
+    }
+
+    iniFileClose(iniFile);
+    free(iniFile);
+
+    return lookups;
+}
+
+static int runBench(const char* machinesDir, int rounds)
+{
+    char pattern[512];
+    ArchGlob* glob;
+    BenchMachine* machines;
+    UInt32 startTime;
+    int machineCount = 0;
+    int lookups = 0;
+    int round;
+    int i;
+
+    sprintf(pattern, "%s/*", machinesDir);
+    glob = archGlob(pattern, ARCH_GLOB_DIRS);
+    if (glob == NULL) {
+        printf("inifile: FAILED no machines in %s\n", machinesDir);
+        return 1;
+    }
+
+    machines = (BenchMachine*)malloc(glob->count * sizeof(BenchMachine));
+    for (i = 0; i < glob->count; i++) {
+        sprintf(machines[machineCount].filename, "%s/config.ini", glob->pathVector[i]);
+        machineCount += readSections(&machines[machineCount]);
+    }
+    archGlobFree(glob);
+
+    startTime = archGetSystemUpTime(1000000);
+    for (round = 0; round < rounds; round++) {
+        for (i = 0; i < machineCount; i++) {
+            lookups += loadMachine(&machines[i]);
+        }
+    }
+
+    printf("inifile: %d machines loaded %d times, %d lookups in %.1f ms\n",
+           machineCount, rounds, lookups, (archGetSystemUpTime(1000000) - startTime) / 1000.0);
+
+    free(machines);
+
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    char filename[512];
+    int failed = 0;
+    int i;
+
+    if (argc > 2 && strcmp(argv[1], "-bench") == 0) {
+        return runBench(argv[2], argc > 3 ? atoi(argv[3]) : BENCH_ROUNDS);
+    }
+    if (argc != 2) {
+        fprintf(stderr, "usage: inifile <work dir>\n       inifile -bench <machines dir> [rounds]\n");
+        return 1;
+    }
+
+    sprintf(filename, "%s/test.ini", argv[1]);
+
+    for (i = 0; i < (int)(sizeof(tests) / sizeof(tests[0])); i++) {
+        failed += !runTest(&tests[i], filename);
+    }
+    remove(filename);
+
+    if (failed) {
+        return 1;
+    }
+
+    printf("inifile: %d lookups passed\n", i);
+
+    return 0;
+}
@@ -0,0 +1,515 @@
+/*****************************************************************************
+** File: replay.c
+**
+** More info: http://www.bluemsx.com
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+**
+******************************************************************************
+*/
+#include "libretro.h"
+#include "Board.h"
+#include "IniFileParser.h"
+#include "Crc32Calc.h"
+#include "ArchTimer.h"
+#include "RewindBuffer.h"
+#include "ziphelper.h"
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+// Replay regression test. The core is linked in and driven headless through
+// the libretro API. Each test is an ini file naming a machine, a test ROM
+// and a capture file with the recorded inputs. The capture is played back
+// with boardCapturePlay(), so the inputs are fed through boardCaptureUInt8()
+// exactly as they were recorded.
+//
+// Every Nth video frame and the whole audio stream are hashed with CRC32
+// and compared with the golden hashes in the ini file.
+//
+// Usage: replay [-record] [-rewind] [-v] <test.ini> <system dir> <work dir>
+//
+// With -record the inputs are generated by a fixed script and stored in
+// the capture file, and the hashes of the recording are printed. Paste
+// them into the ini file as the new golden hashes.
+//
+// With -rewind the run also benchmarks the rewind buffer. A snapshot is
+// taken the same way the board does it every REWIND_PERIOD frames and
+// pushed into a rewind buffer. The cost of a snapshot and the ring memory
+// per second of rewind are printed, then every snapshot is popped again
+// and checked against the crc it had when it was pushed.
+
+// Recording runs past the end of the test so the replayed frames never
+// reach the end of the capture
+#define RECORD_EXTRA_FRAMES 30
+
+// About the 50 ms snapshot period of the emulator
+#define REWIND_PERIOD      3
+#define REWIND_RING_SIZE   (8 * 1024 * 1024)
+#define REWIND_STATE_SIZE  (1 << 21)
+
+typedef struct {
+    char   machine[64];
+    char   rom[512];
+    UInt32 romCrc;
+    char   capture[512];
+    int    frames;
+    int    interval;
+    UInt32 video;
+    UInt32 audio;
+} ReplayTest;
+
+static const char* systemDir;
+static const char* workDir;
+static const char* machineName;
+static int verbose;
+static int recording;
+static int rewindBench;
+
+static int    frame;
+static int    hashFrames;
+static int    hashInterval;
+static UInt32 videoCrc;
+static UInt32 audioCrc;
+static int    videoFrames;
+static UInt32 audioSamples;
+
+static void logPrint(enum retro_log_level level, const char* fmt, ...)
+{
+    va_list args;
+
+    if (level < RETRO_LOG_WARN && !verbose) {
+        return;
+    }
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+}
+
+static bool environment(unsigned cmd, void* data)
+{
+    switch (cmd) {
+    case RETRO_ENVIRONMENT_GET_SYSTEM_DIRECTORY:
+        *(const char**)data = systemDir;
+        return true;
+    case RETRO_ENVIRONMENT_GET_SAVE_DIRECTORY:
+        *(const char**)data = workDir;
+        return true;
+    case RETRO_ENVIRONMENT_GET_LOG_INTERFACE:
+        ((struct retro_log_callback*)data)->log = logPrint;
+        return true;
+    case RETRO_ENVIRONMENT_SET_PIXEL_FORMAT:
+    case RETRO_ENVIRONMENT_GET_INPUT_BITMASKS:
+        return true;
+    case RETRO_ENVIRONMENT_GET_VARIABLE_UPDATE:
+        *(bool*)data = false;
+        return true;
+    case RETRO_ENVIRONMENT_GET_VARIABLE:
+        {
+            struct retro_variable* var = (struct retro_variable*)data;
+            if (strcmp(var->key, "bluemsx_msxtype") == 0) {
+                var->value = machineName;
+                return true;
+            }
+        }
+        return false;
+    default:
+        return false;
+    }
+}
+
+static void videoRefresh(const void* data, unsigned width, unsigned height, size_t pitch)
+{
+    unsigned y;
+
+    if (data == NULL || frame >= hashFrames || frame % hashInterval != 0) {
+        return;
+    }
+
+    for (y = 0; y < height; y++) {
+        videoCrc = calcAddCrc32((const UInt8*)data + y * pitch, width * sizeof(UInt16), videoCrc);
+    }
+    videoFrames++;
+
+    if (verbose) {
+        printf("frame %d: video=%.8x audio=%.8x\n", frame, videoCrc, audioCrc);
+    }
+}
+
+static size_t audioSampleBatch(const int16_t* data, size_t frames)
+{
+    if (frame < hashFrames) {
+        audioCrc = calcAddCrc32(data, (int)(frames * 2 * sizeof(int16_t)), audioCrc);
+        audioSamples += (UInt32)frames;
+    }
+    return frames;
+}
+
+static void inputPoll(void)
+{
+}
+
+// Holds a direction for 16 frames at a time and fires on every third one
+static int scriptedJoypad(int frameNo)
+{
+    static const int directions[] = {
+        0,
+        1 << RETRO_DEVICE_ID_JOYPAD_RIGHT,
+        1 << RETRO_DEVICE_ID_JOYPAD_DOWN,
+        (1 << RETRO_DEVICE_ID_JOYPAD_DOWN) | (1 << RETRO_DEVICE_ID_JOYPAD_LEFT),
+        1 << RETRO_DEVICE_ID_JOYPAD_LEFT,
+        1 << RETRO_DEVICE_ID_JOYPAD_UP,
+        (1 << RETRO_DEVICE_ID_JOYPAD_UP) | (1 << RETRO_DEVICE_ID_JOYPAD_RIGHT),
+    };
+    UInt32 seed = (UInt32)(frameNo / 16) * 1103515245 + 12345;
+    int mask = directions[(seed >> 16) % (sizeof(directions) / sizeof(directions[0]))];
+
+    if ((frameNo / 16) % 3 == 0) {
+        mask |= 1 << RETRO_DEVICE_ID_JOYPAD_A;
+    }
+    return mask;
+}
+
+static int16_t inputState(unsigned port, unsigned device, unsigned index, unsigned id)
+{
+    int mask;
+
+    if (!recording || port != 0 || device != RETRO_DEVICE_JOYPAD) {
+        return 0;
+    }
+
+    mask = scriptedJoypad(frame);
+    if (id == RETRO_DEVICE_ID_JOYPAD_MASK) {
+        return (int16_t)mask;
+    }
+    return (mask >> id) & 1;
+}
+
+static void makePath(char* dest, const char* dir, const char* fileName)
+{
+    if (dir[0] == 0 || fileName[0] == '/') {
+        strcpy(dest, fileName);
+    }
+    else {
+        sprintf(dest, "%s/%s", dir, fileName);
+    }
+}
+
+static int loadTest(ReplayTest* test, const char* fileName)
+{
+    char dir[512];
+    char value[512];
+    char* slash;
+    IniFile* ini;
+
+    strcpy(dir, fileName);
+    slash = strrchr(dir, '/');
+    if (slash != NULL) {
+        *slash = 0;
+    }
+    else {
+        dir[0] = 0;
+    }
+
+    ini = iniFileOpen(fileName);
+    if (ini == NULL) {
+        return 0;
+    }
+
+    iniFileGetString(ini, "Replay", "machine", "", test->machine, sizeof(test->machine));
+    iniFileGetString(ini, "Replay", "rom", "", value, sizeof(value));
+    makePath(test->rom, dir, value);
+    iniFileGetString(ini, "Replay", "capture", "", value, sizeof(value));
+    makePath(test->capture, dir, value);
+    iniFileGetString(ini, "Replay", "rom crc", "0", value, sizeof(value));
+    test->romCrc = strtoul(value, NULL, 16);
+    iniFileGetString(ini, "Replay", "video", "0", value, sizeof(value));
+    test->video = strtoul(value, NULL, 16);
+    iniFileGetString(ini, "Replay", "audio", "0", value, sizeof(value));
+    test->audio = strtoul(value, NULL, 16);
+    test->frames   = iniFileGetInt(ini, "Replay", "frames", 0);
+    test->interval = iniFileGetInt(ini, "Replay", "interval", 1);
+
+    iniFileClose(ini);
+
+    return test->machine[0] != 0 && test->rom[0] != 0 && test->capture[0] != 0 &&
+           test->frames > 0 && test->interval > 0;
+}
+
+static UInt8* loadFile(const char* fileName, int* size)
+{
+    UInt8* buffer;
+    FILE* file = fopen(fileName, "rb");
+
+    if (file == NULL) {
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    *size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    buffer = malloc(*size > 0 ? *size : 1);
+    if (fread(buffer, 1, *size, file) != (size_t)*size) {
+        free(buffer);
+        buffer = NULL;
+    }
+    fclose(file);
+
+    return buffer;
+}
+
+static int copyFile(const char* dest, const char* src)
+{
+    int size;
+    int ok;
+    UInt8* buffer = loadFile(src, &size);
+    FILE* file;
+
+    if (buffer == NULL) {
+        return 0;
+    }
+    file = fopen(dest, "wb");
+    ok = file != NULL && fwrite(buffer, 1, size, file) == (size_t)size;
+    if (file != NULL && fclose(file) != 0) {
+        ok = 0;
+    }
+    free(buffer);
+
+    return ok;
+}
+
+typedef struct {
+    RewindBuffer* buffer;
+    UInt8*  state;
+    UInt32* crcs;
+    int     count;
+    UInt32  saveTime;
+    UInt32  pushTime;
+    double  stateBytes;
+} RewindBench;
+
+static void rewindBenchSnapshot(RewindBench* bench)
+{
+    UInt32 startTime = archGetSystemUpTime(1000000);
+    UInt32 saveTime;
+    int size;
+
+    boardSaveState("mem0", 0);
+    size = memZipFileSerialize("mem0", bench->state, REWIND_STATE_SIZE);
+    saveTime = archGetSystemUpTime(1000000);
+    if (size <= 0 || size > REWIND_STATE_SIZE) {
+        return;
+    }
+
+    rewindBufferPush(bench->buffer, bench->state, size);
+
+    bench->pushTime += archGetSystemUpTime(1000000) - saveTime;
+    bench->saveTime += saveTime - startTime;
+    bench->stateBytes += size;
+    bench->crcs[bench->count++] = calcCrc32(bench->state, size);
+}
+
+static int rewindBenchReport(RewindBench* bench, const char* testName)
+{
+    double seconds = bench->count * REWIND_PERIOD / 60.0;
+    int usage = rewindBufferGetUsage(bench->buffer);
+    int held  = rewindBufferGetCount(bench->buffer);
+    UInt32 popTime = archGetSystemUpTime(1000000);
+    int popped = 0;
+
+    if (bench->count == 0) {
+        return 1;
+    }
+
+    printf("%s: rewind %d snapshots of %.0f bytes, save %.3f ms, push %.3f ms\n",
+           testName, bench->count, bench->stateBytes / bench->count,
+           bench->saveTime / 1000.0 / bench->count, bench->pushTime / 1000.0 / bench->count);
+
+    while (rewindBufferGetCount(bench->buffer) > 0) {
+        int size;
+        const void* state = rewindBufferPop(bench->buffer, &size);
+
+        if (calcCrc32(state, size) != bench->crcs[bench->count - 1 - popped]) {
+            printf("%s: FAILED rewind snapshot %d differs\n", testName, bench->count - 1 - popped);
+            return 0;
+        }
+        popped++;
+    }
+    popTime = archGetSystemUpTime(1000000) - popTime;
+
+    printf("%s: rewind ring %d KB for %d snapshots, %.1f KB per second, pop %.3f ms\n",
+           testName, usage / 1024, held, usage / 1024.0 / (held * REWIND_PERIOD / 60.0),
+           popTime / 1000.0 / popped);
+    printf("%s: rewind %.1f s would take %.1f MB as full snapshots\n",
+           testName, seconds, bench->stateBytes / (1024 * 1024));
+
+    return 1;
+}
+
+int main(int argc, char** argv)
+{
+    RewindBench bench;
+    struct retro_game_info info;
+    ReplayTest test;
+    char capture[512];
+    const char* testName;
+    UInt32 startTime;
+    UInt32 elapsed;
+    UInt8* rom;
+    int romSize;
+    int frames;
+    int argi = 1;
+
+    while (argi < argc && argv[argi][0] == '-') {
+        if (strcmp(argv[argi], "-record") == 0) {
+            recording = 1;
+        }
+        else if (strcmp(argv[argi], "-rewind") == 0) {
+            rewindBench = 1;
+        }
+        else if (strcmp(argv[argi], "-v") == 0) {
+            verbose = 1;
+        }
+        argi++;
+    }
+    if (argc - argi != 3) {
+        fprintf(stderr, "usage: replay [-record] [-rewind] [-v] <test.ini> <system dir> <work dir>\n");
+        return 2;
+    }
+
+    testName  = argv[argi];
+    systemDir = argv[argi + 1];
+    workDir   = argv[argi + 2];
+
+    memset(&test, 0, sizeof(test));
+    if (!loadTest(&test, testName)) {
+        fprintf(stderr, "%s: invalid test file\n", testName);
+        return 2;
+    }
+
+    rom = loadFile(test.rom, &romSize);
+    if (rom == NULL) {
+        fprintf(stderr, "%s: can't read %s\n", testName, test.rom);
+        return 2;
+    }
+    if (calcCrc32(rom, romSize) != test.romCrc) {
+        fprintf(stderr, "%s: %s has crc %.8x, expected %.8x\n",
+                testName, test.rom, calcCrc32(rom, romSize), test.romCrc);
+        free(rom);
+        return 2;
+    }
+    free(rom);
+
+    // The capture is played from the work directory, since playback
+    // writes temporary keyframe files next to it
+    makePath(capture, workDir, "replay.cap");
+    if (!recording && !copyFile(capture, test.capture)) {
+        fprintf(stderr, "%s: can't copy %s\n", testName, test.capture);
+        return 2;
+    }
+
+    machineName  = test.machine;
+    hashFrames   = test.frames;
+    hashInterval = test.interval;
+    videoCrc     = 0;
+    audioCrc     = 0;
+
+    retro_set_environment(environment);
+    retro_init();
+    retro_set_video_refresh(videoRefresh);
+    retro_set_audio_sample_batch(audioSampleBatch);
+    retro_set_input_poll(inputPoll);
+    retro_set_input_state(inputState);
+
+    memset(&info, 0, sizeof(info));
+    info.path = test.rom;
+    if (!retro_load_game(&info)) {
+        fprintf(stderr, "%s: can't start %s\n", testName, test.machine);
+        retro_deinit();
+        return 2;
+    }
+
+    if (recording) {
+        boardCaptureStart(capture);
+    }
+    else if (!boardCapturePlay(capture)) {
+        fprintf(stderr, "%s: can't play %s\n", testName, test.capture);
+        retro_unload_game();
+        retro_deinit();
+        return 2;
+    }
+
+    frames = test.frames + (recording ? RECORD_EXTRA_FRAMES : 0);
+
+    memset(&bench, 0, sizeof(bench));
+    if (rewindBench) {
+        bench.buffer = rewindBufferCreate(REWIND_RING_SIZE, frames / REWIND_PERIOD + 1);
+        bench.state  = malloc(REWIND_STATE_SIZE);
+        bench.crcs   = malloc((frames / REWIND_PERIOD + 1) * sizeof(UInt32));
+    }
+
+    startTime = archGetSystemUpTime(1000);
+    for (frame = 0; frame < frames; frame++) {
+        retro_run();
+        if (rewindBench && frame % REWIND_PERIOD == 0) {
+            rewindBenchSnapshot(&bench);
+        }
+    }
+    elapsed = archGetSystemUpTime(1000) - startTime;
+
+    if (recording) {
+        boardCaptureStop();
+    }
+
+    if (rewindBench) {
+        int ok = rewindBenchReport(&bench, testName);
+
+        rewindBufferDestroy(bench.buffer);
+        free(bench.state);
+        free(bench.crcs);
+        if (!ok) {
+            retro_unload_game();
+            retro_deinit();
+            return 1;
+        }
+    }
+
+    retro_unload_game();
+    retro_deinit();
+
+    if (recording) {
+        if (!copyFile(test.capture, capture)) {
+            fprintf(stderr, "%s: can't write %s\n", testName, test.capture);
+            return 2;
+        }
+        printf("%s: recorded %d frames\nvideo=%.8x\naudio=%.8x\n",
+               testName, test.frames, videoCrc, audioCrc);
+        return 0;
+    }
+
+    printf("%s: %d frames, %d hashed, %u audio samples, %.1f fps\n",
+           testName, test.frames, videoFrames, audioSamples,
+           elapsed > 0 ? 1000.0 * frames / elapsed : 0.0);
+
+    if (videoCrc != test.video || audioCrc != test.audio) {
+        printf("%s: FAILED video=%.8x (expected %.8x) audio=%.8x (expected %.8x)\n",
+               testName, videoCrc, test.video, audioCrc, test.audio);
+        return 1;
+    }
+
+    printf("%s: passed\n", testName);
+    return 0;
+}
@@ -0,0 +1,314 @@
+#!/usr/bin/env python3
+#
+# Builds the test ROMs used by the replay regression suite.
+#
+# The same small program is generated for each board type. It polls the
+# VDP for the vertical blank, reads joystick 1, moves a sprite with it,
+# rewrites a row of the name table and plays a tone that follows the
+# sprite. Everything it does depends on the recorded inputs, so a replay
+# that drifts shows up in both the video and the audio hashes.
+#
+# The ROMs are written for this suite and are distributed under the same
+# license as the emulator.
+#
+# Usage: mkroms.py [output directory]
+
+import os
+import sys
+
+
+class Asm:
+    def __init__(self, org):
+        self.org = org
+        self.code = bytearray()
+        self.labels = {}
+        self.fixups = []
+
+    def pc(self):
+        return self.org + len(self.code)
+
+    def label(self, name):
+        self.labels[name] = self.pc()
+
+    def db(self, *values):
+        for v in values:
+            self.code.append(v & 0xff)
+
+    def dw(self, value):
+        self.db(value, value >> 8)
+
+    def abs16(self, opcode, name):
+        self.db(opcode)
+        self.fixups.append((len(self.code), name, False))
+        self.dw(0)
+
+    def rel8(self, opcode, name):
+        self.db(opcode)
+        self.fixups.append((len(self.code), name, True))
+        self.db(0)
+
+    def jp(self, name):     self.abs16(0xc3, name)
+    def call(self, name):   self.abs16(0xcd, name)
+    def jr(self, name):     self.rel8(0x18, name)
+    def jrz(self, name):    self.rel8(0x28, name)
+    def jrnz(self, name):   self.rel8(0x20, name)
+    def djnz(self, name):   self.rel8(0x10, name)
+
+    def out(self, port, value=None):
+        if value is not None:
+            self.db(0x3e, value)        # ld a,value
+        self.db(0xd3, port)             # out (port),a
+
+    def vdp_addr(self, ctrl, address):
+        self.out(ctrl, address & 0xff)
+        self.out(ctrl, (address >> 8) | 0x40)
+
+    def link(self, size):
+        for offset, name, relative in self.fixups:
+            target = self.labels[name]
+            if relative:
+                delta = target - (self.org + offset + 1)
+                assert -128 <= delta < 128, name
+                self.code[offset] = delta & 0xff
+            else:
+                self.code[offset] = target & 0xff
+                self.code[offset + 1] = target >> 8
+        assert len(self.code) <= size
+        return bytes(self.code) + b'\xff' * (size - len(self.code))
+
+
+# Normalized joystick bits in the program
+JOY_UP, JOY_DOWN, JOY_LEFT, JOY_RIGHT, JOY_FIRE = 0, 1, 2, 3, 4
+
+
+def joy_normalize(a, mapping):
+    # Converts the active low value in A to the normalized bits in A
+    a.db(0x2f)                          # cpl
+    a.db(0x06, 0x00)                    # ld b,0
+    for src, dst in mapping:
+        a.db(0xcb, 0x47 + 8 * src)      # bit src,a
+        a.db(0x28, 0x02)                # jr z,+2
+        a.db(0xcb, 0xc0 + 8 * dst)      # set dst,b
+    a.db(0x78)                          # ld a,b
+
+
+def read_joy_msx(a):
+    a.out(0xa0, 15)
+    a.out(0xa1, 0x0f)                   # joystick port 1
+    a.out(0xa0, 14)
+    a.db(0xdb, 0xa2)                    # in a,(0a2h)
+    joy_normalize(a, [(0, JOY_UP), (1, JOY_DOWN), (2, JOY_LEFT), (3, JOY_RIGHT), (4, JOY_FIRE)])
+
+
+def read_joy_svi(a):
+    a.out(0x88, 14)
+    a.db(0xdb, 0x90)                    # in a,(90h)
+    joy_normalize(a, [(0, JOY_UP), (1, JOY_DOWN), (2, JOY_LEFT), (3, JOY_RIGHT)])
+    a.db(0x47)                          # ld b,a
+    a.db(0xdb, 0x98)                    # in a,(98h), trigger in bit 4
+    a.db(0xcb, 0x67)                    # bit 4,a
+    a.db(0x20, 0x02)                    # jr nz,+2
+    a.db(0xcb, 0xc0 + 8 * JOY_FIRE)     # set fire,b
+    a.db(0x78)                          # ld a,b
+
+
+def read_joy_coleco(a):
+    a.out(0xc0)                         # joystick mode
+    a.db(0xdb, 0xfc)                    # in a,(0fch)
+    joy_normalize(a, [(0, JOY_UP), (2, JOY_DOWN), (3, JOY_LEFT), (1, JOY_RIGHT), (6, JOY_FIRE)])
+
+
+def read_joy_sg1000(a):
+    a.db(0xdb, 0xdc)                    # in a,(0dch)
+    joy_normalize(a, [(0, JOY_UP), (1, JOY_DOWN), (2, JOY_LEFT), (3, JOY_RIGHT), (4, JOY_FIRE)])
+
+
+def sound_ay(addr, data):
+    def emit(a):
+        # Tone A follows the sprite, louder while fire is held
+        a.out(addr, 7)
+        a.out(data, 0xb8)
+        a.out(addr, 0)
+        a.db(0x3a); a.dw(VAR_X)         # ld a,(x)
+        a.out(data)
+        a.out(addr, 1)
+        a.db(0x3a); a.dw(VAR_Y)         # ld a,(y)
+        a.db(0x0f, 0x0f, 0x0f, 0x0f)    # rrca x4
+        a.db(0xe6, 0x0f)                # and 0fh
+        a.out(data)
+        a.out(addr, 8)
+        a.db(0x3a); a.dw(VAR_JOY)       # ld a,(joy)
+        a.db(0xe6, 1 << JOY_FIRE)       # and fire
+        a.db(0xc6, 0x0a)                # add a,10
+        a.out(data)
+    return emit
+
+
+def sound_sn(port):
+    def emit(a):
+        a.db(0x3a); a.dw(VAR_X)         # ld a,(x)
+        a.db(0x47)                      # ld b,a
+        a.db(0xe6, 0x0f)                # and 0fh
+        a.db(0xf6, 0x80)                # or 80h, tone 0 low bits
+        a.out(port)
+        a.db(0x78)                      # ld a,b
+        a.db(0x0f, 0x0f, 0x0f, 0x0f)    # rrca x4
+        a.db(0xe6, 0x0f)                # and 0fh
+        a.db(0xf6, 0x10)                # or 10h
+        a.out(port)
+        a.db(0x3a); a.dw(VAR_JOY)       # ld a,(joy)
+        a.db(0xe6, 1 << JOY_FIRE)       # and fire
+        a.db(0x0f, 0x0f, 0x0f)          # rrca x3, attenuation 2 or 0
+        a.db(0xee, 0x92)                # xor 92h, tone 0 volume
+        a.out(port)
+    return emit
+
+
+VAR_JOY = 0
+VAR_X = 0
+VAR_Y = 0
+VAR_FRAME = 0
+
+
+def program(a, ram, stack, data, ctrl, status, read_joy, sound):
+    global VAR_JOY, VAR_X, VAR_Y, VAR_FRAME
+    VAR_FRAME = ram
+    VAR_JOY = ram + 1
+    VAR_X = ram + 2
+    VAR_Y = ram + 3
+
+    a.db(0xf3)                          # di
+    a.db(0x31); a.dw(stack)             # ld sp,stack
+
+    # Graphics I, 16kB, display on, no interrupts
+    for reg, value in enumerate([0x00, 0xc2, 0x06, 0x80, 0x00, 0x36, 0x07, 0xf4]):
+        a.out(ctrl, value)
+        a.out(ctrl, 0x80 | reg)
+
+    # Fill all of VRAM with a pattern derived from the address
+    a.vdp_addr(ctrl, 0x0000)
+    a.db(0x21); a.dw(0x0000)            # ld hl,0
+    a.label('fill')
+    a.db(0x7d)                          # ld a,l
+    a.db(0xac)                          # xor h
+    a.db(0x07)                          # rlca
+    a.db(0xad)                          # xor l
+    a.out(data)
+    a.db(0x23)                          # inc hl
+    a.db(0x7c)                          # ld a,h
+    a.db(0xfe, 0x40)                    # cp 40h
+    a.jrnz('fill')
+
+    # One sprite, terminated by the next entry
+    a.vdp_addr(ctrl, 0x1b04)
+    a.out(data, 0xd0)
+
+    a.db(0x21); a.dw(0x6080)            # ld hl,6080h
+    a.db(0x22); a.dw(VAR_X)             # ld (x),hl
+    a.db(0xaf)                          # xor a
+    a.db(0x32); a.dw(VAR_FRAME)         # ld (frame),a
+
+    a.label('main')
+    a.label('wait')
+    a.db(0xdb, status)                  # in a,(status)
+    a.db(0xe6, 0x80)                    # and 80h
+    a.jrz('wait')
+
+    read_joy(a)
+    a.db(0x32); a.dw(VAR_JOY)           # ld (joy),a
+    a.db(0x4f)                          # ld c,a
+    a.db(0x2a); a.dw(VAR_X)             # ld hl,(x), l=x h=y
+    for bit, op in [(JOY_UP, 0x25), (JOY_DOWN, 0x24), (JOY_LEFT, 0x2d), (JOY_RIGHT, 0x2c)]:
+        a.db(0xcb, 0x41 + 8 * bit)      # bit n,c
+        a.db(0x28, 0x01)                # jr z,+1
+        a.db(op)                        # inc/dec h/l
+    a.db(0x22); a.dw(VAR_X)             # ld (x),hl
+
+    # Sprite 0 at the position, pattern and color from the frame counter
+    a.vdp_addr(ctrl, 0x1b00)
+    a.db(0x7c)                          # ld a,h
+    a.out(data)
+    a.db(0x7d)                          # ld a,l
+    a.out(data)
+    a.db(0x3a); a.dw(VAR_FRAME)         # ld a,(frame)
+    a.out(data)
+    a.db(0xe6, 0x0f)                    # and 0fh
+    a.db(0xf6, 0x01)                    # or 1
+    a.out(data)
+
+    # Rewrite row (frame & 15) of the name table
+    a.db(0x3a); a.dw(VAR_FRAME)         # ld a,(frame)
+    a.db(0xe6, 0x0f)                    # and 0fh
+    a.db(0x6f)                          # ld l,a
+    a.db(0x26, 0x00)                    # ld h,0
+    for _ in range(5):
+        a.db(0x29)                      # add hl,hl
+    a.db(0x7d)                          # ld a,l
+    a.out(ctrl)
+    a.db(0x7c)                          # ld a,h
+    a.db(0xf6, 0x58)                    # or 58h, 1800h + write
+    a.out(ctrl)
+    a.db(0x3a); a.dw(VAR_FRAME)         # ld a,(frame)
+    a.db(0x81)                          # add a,c
+    a.db(0x06, 0x20)                    # ld b,32
+    a.label('row')
+    a.out(data)
+    a.db(0x3c)                          # inc a
+    a.djnz('row')
+
+    sound(a)
+
+    a.db(0x21); a.dw(VAR_FRAME)         # ld hl,frame
+    a.db(0x34)                          # inc (hl)
+    a.jp('main')
+
+
+def build_msx():
+    a = Asm(0x4000)
+    a.db(ord('A'), ord('B'))
+    a.dw(0x4010)
+    a.db(*([0] * 12))
+    program(a, 0xe000, 0xf000, 0x98, 0x99, 0x99, read_joy_msx, sound_ay(0xa0, 0xa1))
+    return a.link(0x4000)
+
+
+def build_svi():
+    a = Asm(0x0000)
+    program(a, 0xe000, 0xf000, 0x80, 0x81, 0x85, read_joy_svi, sound_ay(0x88, 0x8c))
+    return a.link(0x8000)
+
+
+def build_coleco():
+    a = Asm(0x8000)
+    a.db(0x55, 0xaa)                    # start without the title screen
+    a.dw(0); a.dw(0); a.dw(0); a.dw(0)
+    a.dw(0x8024)
+    for _ in range(7):                  # rst 08h-38h
+        a.db(0xc9, 0x00, 0x00)
+    a.db(0xed, 0x45, 0x00)              # nmi: retn
+    program(a, 0x7000, 0x7400, 0xbe, 0xbf, 0xbf, read_joy_coleco, sound_sn(0xff))
+    return a.link(0x2000)
+
+
+def build_sg1000():
+    a = Asm(0x0000)
+    a.jp('start')
+    a.code += b'\xff' * (0x66 - len(a.code))
+    a.db(0xed, 0x45)                    # nmi: retn
+    a.label('start')
+    program(a, 0xc000, 0xc400, 0xbe, 0xbf, 0xbf, read_joy_sg1000, sound_sn(0x7f))
+    return a.link(0x2000)
+
+
+def main():
+    outdir = sys.argv[1] if len(sys.argv) > 1 else os.path.dirname(os.path.abspath(__file__))
+    for name, build in [('replay_msx.rom', build_msx),
+                        ('replay_svi.rom', build_svi),
+                        ('replay_coleco.col', build_coleco),
+                        ('replay_sg1000.sg', build_sg1000)]:
+        with open(os.path.join(outdir, name), 'wb') as f:
+            f.write(build())
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,138 @@
+/*****************************************************************************
+** File: rewind.c
+**
+** More info: http://www.bluemsx.com
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+**
+******************************************************************************
+*/
+#include "RewindBuffer.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+// Rewind buffer round trip test. Random snapshots are pushed and popped
+// in random order while a copy of every snapshot still in the buffer is
+// kept on the side. Each popped snapshot must equal the copy, and the
+// buffer may only drop the oldest ones. The ring is small compared to
+// the snapshots, so it wraps many times during a run.
+//
+// Usage: rewind [iterations]
+
+#define RING_SIZE    4096
+#define MAX_STATES   24
+#define MAX_SIZE     1500
+#define ITERATIONS   200000
+
+typedef struct {
+    UInt8* data;
+    int    size;
+} Snapshot;
+
+static UInt32 seed = 12345;
+
+static UInt32 random32(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+// Makes the next snapshot from the previous one. Most bytes stay the
+// same, with a few random changes and an occasional change of size.
+static void nextSnapshot(Snapshot* snapshot, const Snapshot* previous)
+{
+    int changes;
+    int i;
+
+    snapshot->size = previous->size;
+    if (snapshot->size == 0 || random32() % 8 == 0) {
+        snapshot->size = 1 + random32() % MAX_SIZE;
+    }
+    snapshot->data = malloc(snapshot->size);
+
+    for (i = 0; i < snapshot->size; i++) {
+        snapshot->data[i] = i < previous->size ? previous->data[i] : (UInt8)random32();
+    }
+
+    changes = random32() % 4 == 0 ? snapshot->size : random32() % 32;
+    while (changes--) {
+        snapshot->data[random32() % snapshot->size] = (UInt8)random32();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Snapshot history[MAX_STATES + 1];
+    Snapshot empty = { NULL, 0 };
+    RewindBuffer* rb = rewindBufferCreate(RING_SIZE, MAX_STATES);
+    int iterations = argc > 1 ? atoi(argv[1]) : ITERATIONS;
+    int count = 0;
+    int pushes = 0;
+    int pops = 0;
+    int i;
+
+    for (i = 0; i < iterations; i++) {
+        int size;
+        const UInt8* data;
+
+        if (count == 0 || random32() % 3 != 0) {
+            Snapshot snapshot;
+
+            nextSnapshot(&snapshot, count > 0 ? &history[count - 1] : &empty);
+            rewindBufferPush(rb, snapshot.data, snapshot.size);
+            history[count++] = snapshot;
+            pushes++;
+
+            // Only the oldest snapshots may be dropped
+            if (rewindBufferGetCount(rb) > count || rewindBufferGetCount(rb) < 1) {
+                printf("rewind: FAILED count %d after push %d\n", rewindBufferGetCount(rb), pushes);
+                return 1;
+            }
+            while (count > rewindBufferGetCount(rb)) {
+                free(history[0].data);
+                memmove(history, history + 1, --count * sizeof(Snapshot));
+            }
+            continue;
+        }
+
+        data = rewindBufferPop(rb, &size);
+        count--;
+        pops++;
+
+        if (data == NULL || size != history[count].size ||
+            memcmp(data, history[count].data, size) != 0)
+        {
+            printf("rewind: FAILED snapshot mismatch at pop %d\n", pops);
+            return 1;
+        }
+        free(history[count].data);
+
+        if (rewindBufferGetCount(rb) != count) {
+            printf("rewind: FAILED count %d after pop %d, expected %d\n",
+                   rewindBufferGetCount(rb), pops, count);
+            return 1;
+        }
+    }
+
+    printf("rewind: %d pushes, %d pops, passed\n", pushes, pops);
+
+    while (count > 0) {
+        free(history[--count].data);
+    }
+    rewindBufferDestroy(rb);
+
+    return 0;
+}